@@ -0,0 +1,115 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_APPEND_LOG_HPP__
+#define JHC_APPEND_LOG_HPP__
+#include "jhc/config.hpp"
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "jhc/macros.hpp"
+#include "jhc/file.hpp"
+
+namespace jhc {
+// Durable append-only log of records.
+//
+// Each record is a frame: its size (32 bits, little-endian), the CRC32 of the size field and the payload
+// (32 bits, little-endian), then the payload.
+// Concurrent append() calls are committed in groups: while one batch is written and synced, the next
+// records are collected, then written with one write and made durable with one fdatasync. Throughput
+// grows with the number of appenders instead of being bound to one sync per record.
+//
+// open() scans the log and cuts what follows the last valid frame, e.g. a batch torn by a crash.
+//
+class AppendLog {
+   public:
+    JHC_DISALLOW_COPY_MOVE(AppendLog);
+
+    enum { kHeaderSize = 8 };
+    static const uint32_t kMaxRecordSize = 64 * 1024 * 1024;
+
+    // Called for each record by replay(). Return false to stop.
+    //
+    typedef std::function<bool(const void* data, size_t size, int64_t offset)> Visitor;
+
+    AppendLog();
+
+    ~AppendLog();
+
+    // Opens or creates the log and recovers it.
+    //
+    bool open(const fs::path& path);
+
+    bool close();
+
+    bool isOpen() const;
+
+    // Appends a record and returns once it is on the disk. Thread-safe.
+    // Return the offset of its frame, -1 when failed (the log is not open, the record is too large
+    // or a write or sync failed, after which all appends fail).
+    //
+    int64_t append(const void* data, size_t size);
+
+    // Calls visitor for each durable record, in order. close() and open() wait for it to return,
+    // so visitor must not call them.
+    // Return false on a read error.
+    //
+    bool replay(const Visitor& visitor);
+
+    // Number of durable records and size of the durable part of the log.
+    //
+    uint64_t recordCount() const;
+    int64_t size() const;
+
+    // Number of group commits since open().
+    //
+    uint64_t commitCount() const;
+
+    // Scans the frames of an open file from its beginning, calls visitor (when not null) for each valid one.
+    // end receives the offset following the last valid frame, count the number of valid frames.
+    // Return false on a read error.
+    //
+    static bool Scan(File& file, int64_t fileSize, const Visitor* visitor, int64_t& end, uint64_t& count);
+
+   protected:
+    std::unique_ptr<File> file_;
+    mutable std::mutex mutex_;
+    std::condition_variable committed_;
+    std::vector<unsigned char> batch_;    // frames of the batch collecting records
+    std::vector<unsigned char> writing_;  // frames of the batch being committed, owned by its leader
+    uint64_t batchRecords_ = 0;
+    uint64_t batchId_ = 1;                  // id of the batch collecting records
+    uint64_t committedId_ = 0;              // id of the last batch committed
+    uint64_t failedId_ = UINT64_MAX;        // id of the first batch that could not be committed
+    bool committing_ = false;
+    size_t replaying_ = 0;    // replay() calls running, close() waits for them
+    int64_t end_ = 0;         // end of the batches taken by a leader
+    int64_t durableEnd_ = 0;  // end of the committed batches
+    uint64_t records_ = 0;
+    uint64_t commits_ = 0;
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/append_log.cc"
+#endif
+#endif  // !JHC_APPEND_LOG_HPP__
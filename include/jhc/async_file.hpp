@@ -0,0 +1,185 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_ASYNC_FILE_HPP__
+#define JHC_ASYNC_FILE_HPP__
+#include "jhc/config.hpp"
+#include "jhc/arch.hpp"
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "jhc/macros.hpp"
+#include "jhc/file.hpp"
+#include "jhc/thread_pool.hpp"
+
+namespace jhc {
+// Asynchronous positional reads, writes and syncs on open jhc::File objects.
+// On Linux the operations go to the kernel through io_uring (raw system calls, no liburing), elsewhere,
+// or when io_uring is not available, to a pool of threads doing blocking readAt/writeAt.
+//
+// Operations are queued first and handed over together by submit(), so a batch costs one system call.
+// At most queueDepth operations are queued or in flight: queueing more submits the queue and blocks until
+// one completes.
+// The File and the buffer must stay valid until the operation completes.
+//
+// Completion callbacks run on an internal thread and must not block. The slot of the operation is free when
+// its callback runs, so a callback can queue and submit one further operation (e.g. the next chunk of a file
+// to keep the queue full), but it must not call wait(). Queueing from a callback does not wait for a slot:
+// it fails when another thread took the free slot first.
+//
+class AsyncFileEngine {
+   public:
+    JHC_DISALLOW_COPY_MOVE(AsyncFileEngine);
+
+    enum class Backend {
+        Auto,     // io_uring when available, else Threads
+        IoUring,  // Linux 5.6 and later
+        Threads,
+    };
+
+    // Result of an operation: the number of bytes transferred, or a negative error code (-errno)
+    // when nothing could be transferred. Reads stop early only at the end of the file.
+    //
+    typedef std::function<void(int64_t result)> Callback;
+
+    // threads: number of worker threads of the Threads backend.
+    // The requested backend is not guaranteed, see backend().
+    //
+    AsyncFileEngine(size_t queueDepth = 64, Backend backend = Backend::Auto, size_t threads = 4);
+
+    // Submits what is queued and waits for everything in flight.
+    //
+    ~AsyncFileEngine();
+
+    // The backend actually used: IoUring or Threads.
+    //
+    Backend backend() const;
+
+    size_t queueDepth() const;
+
+    // Queues an operation. Returns false, without calling the callback, when the file is not open,
+    // or when called from a completion callback while the queue is full.
+    //
+    bool read(File& file, void* buffer, size_t size, int64_t offset, Callback callback);
+    bool write(File& file, const void* buffer, size_t size, int64_t offset, Callback callback);
+
+    // Flushes the file data to the disk (fdatasync).
+    //
+    bool sync(File& file, Callback callback);
+
+    // Same as above, the result is delivered through a future instead of a callback.
+    // The future is ready with -EBADF when the file is not open, with -EAGAIN when the queue is full in a callback.
+    //
+    std::future<int64_t> read(File& file, void* buffer, size_t size, int64_t offset);
+    std::future<int64_t> write(File& file, const void* buffer, size_t size, int64_t offset);
+    std::future<int64_t> sync(File& file);
+
+    // Hands all queued operations over to the kernel (or to the worker threads).
+    // Return the number of operations submitted. Operations the kernel refuses complete with its error,
+    // their callbacks run on the calling thread before submit() returns.
+    //
+    size_t submit();
+
+    // Submits and waits until no operation is queued or in flight.
+    //
+    void wait();
+
+    // Number of operations queued or in flight.
+    //
+    size_t pending() const;
+
+   protected:
+    enum class Opcode { Read, Write, Sync };
+
+    struct Operation {
+        Opcode opcode;
+        File* file;
+        void* buffer;
+        size_t size;
+        int64_t offset;
+        size_t done;  // bytes transferred so far
+        Callback callback;
+    };
+
+    // Return 0, or -EBADF / -EAGAIN when the operation is not queued.
+    int queue(Opcode opcode, File& file, void* buffer, size_t size, int64_t offset, Callback callback);
+    std::future<int64_t> queueFuture(Opcode opcode, File& file, void* buffer, size_t size, int64_t offset);
+
+    // Must hold mutex_.
+    void pushLocked(size_t slot);
+    size_t submitLocked();
+
+    // io_uring: records the result of one transfer, queues the rest of a partial one or completes the operation.
+    void onResult(size_t slot, int64_t result);
+
+    // Threads: performs the whole operation on the calling thread.
+    void runOperation(size_t slot);
+
+    // Frees the slot and calls its callback.
+    void complete(size_t slot, int64_t result);
+
+    // Completes the operations in failed_. Must not hold mutex_.
+    void completeFailed();
+
+#ifdef JHC_LINUX
+    bool setupRing();
+    void closeRing();
+    void reapLoop();
+
+    int ringFd_ = -1;
+    void* sqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    void* cqRing_ = nullptr;
+    size_t cqRingSize_ = 0;
+    void* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    void* cqes_ = nullptr;
+    std::thread reaper_;
+#endif
+    Backend backend_ = Backend::Threads;
+    const size_t queueDepth_;
+    std::vector<Operation> slots_;
+    std::vector<size_t> freeSlots_;
+    std::vector<size_t> queued_;  // Threads backend: slots waiting for submit()
+    size_t unsubmitted_ = 0;  // io_uring: entries of the submission queue not given to the kernel yet
+    size_t completing_ = 0;   // callbacks running
+    std::vector<std::pair<size_t, int64_t>> failed_;  // io_uring: slots refused by the kernel, and their result
+    mutable std::mutex mutex_;
+    std::condition_variable slotFreed_;  // also signaled when a callback returns
+    std::unique_ptr<ThreadPool> pool_;
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/async_file.cc"
+#endif
+#endif  // !JHC_ASYNC_FILE_HPP__
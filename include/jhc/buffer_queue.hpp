@@ -22,10 +22,17 @@
 #pragma once
 
 #include "jhc/config.hpp"
+#include "jhc/arch.hpp"
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <string>
+#include <vector>
 #include <string.h>
 #include <stdlib.h>
+#ifndef JHC_WIN
+#include <sys/uio.h>
+#endif
 #include "jhc/macros.hpp"
 
 namespace jhc {
@@ -33,25 +40,50 @@ typedef struct QueueElem {
     void* dataStartAddress;  // start address of the data that we allocated.
     void* dataReadAddress;   // address of the data in buffer. Next time, we get data from this address.
     size_t size;             // the size of the data.
+    int slabClass;           // size class of the slab block holding element and data, -1 if they were malloc'd.
     struct QueueElem* prev;
     struct QueueElem* next;
 } QUEUE_ELEMENT;
 
+// A piece of queued data, exposed in place.
+typedef struct BufferSegment {
+    const void* data;
+    size_t size;
+} BUFFER_SEGMENT;
+
 class BufferQueue {
    public:
+    struct SlabStatistics {
+        size_t hits;       // element blocks reused from a free list.
+        size_t misses;     // element blocks carved from fresh slab space, or malloc'd because they are too big.
+        size_t slabCount;  // slabs allocated so far, they are only freed by the destructor.
+        size_t slabBytes;  // total bytes of all the slabs.
+    };
+
     JHC_DISALLOW_COPY_MOVE(BufferQueue);
-    explicit BufferQueue(const std::string& name = "");
+
+    // slabSize: when not 0, element headers and payloads up to kMaxSlabBlockSize bytes are packed together into
+    // slabs of this size, and the blocks of popped elements are recycled instead of being returned to the system allocator.
+    // When 0, every element is malloc'd and freed separately.
+    //
+    explicit BufferQueue(const std::string& name = "", size_t slabSize = 0);
     ~BufferQueue();
 
     std::string getQueueName() const;
 
+    bool isSlabEnabled() const;
+
+    SlabStatistics getSlabStatistics();
+
     // Push element to queue's front.
     // The queue will allocate buffer to save pData, so caller can free pData after call.
+    // Return false if the queue has been closed.
     //
     bool pushElementToFront(void* pData, size_t nDataSize);
 
     // Push element to queue's last.
     // The queue will allocate buffer to save pData, so caller can free pData after call.
+    // Return false if the queue has been closed.
     //
     bool pushElementToLast(void* pData, size_t nDataSize);
 
@@ -67,6 +99,35 @@ class BufferQueue {
     //
     size_t popElementFromLast(void* pBuffer, size_t nBufferSize);
 
+    // Wait until the queue has data, or is closed, or timeout expires.
+    // Return: true if there is data to pop.
+    //
+    bool waitForData(const std::chrono::milliseconds& timeout);
+
+    // Same as popElementFromFront, but wait up to timeout for an element.
+    // Return: actual size of copy into pBuffer, 0 when timeout expires or the queue is closed and empty.
+    //
+    size_t popElementFromFront(void* pBuffer, size_t nBufferSize, const std::chrono::milliseconds& timeout);
+
+    // Pop up to nMaxElements elements from the front under one lock, and copy their data one after another to pBuffer.
+    // The size of each element is saved to pElementSizes, which must have room for nMaxElements values.
+    // Stop at the first element that doesn't fit the rest of pBuffer, except that the first element is
+    // truncated to nBufferSize like popElementFromFront does.
+    // Return: the number of elements popped.
+    //
+    size_t popElementsFromFront(void* pBuffer, size_t nBufferSize, size_t* pElementSizes, size_t nMaxElements);
+
+    // Same as above, but wait up to timeout for the first element.
+    //
+    size_t popElementsFromFront(void* pBuffer, size_t nBufferSize, size_t* pElementSizes, size_t nMaxElements, const std::chrono::milliseconds& timeout);
+
+    // Close the queue: later pushes fail and every waiting consumer wakes up.
+    // Data that is already in the queue can still be popped.
+    //
+    void close();
+
+    bool isClosed();
+
     // Copy data of the first element to pBuffer.
     // Caller need allocate/free pBuffer's memory.
     // Return: actual size of copy into pBuffer.
@@ -103,13 +164,54 @@ class BufferQueue {
 
     size_t toOneBufferWithNullEnding(char** ppBuf);
 
+    // Zero-copy read.
+    // Fill pSegments with the queued data from the front, in place, at most nMaxSegments segments and nMaxBytes bytes.
+    // The segments stay valid until the data is consumed, popped or cleared, so only one consumer should use them,
+    // producers may keep pushing to the last.
+    // Return: the number of segments filled.
+    //
+    size_t getSegments(BUFFER_SEGMENT* pSegments, size_t nMaxSegments, size_t nMaxBytes = (size_t)-1);
+
+#ifndef JHC_WIN
+    // Same as above, but fill iovec that can be passed to writev/sendmsg directly.
+    //
+    size_t getSegments(struct iovec* pIov, size_t nMaxIov, size_t nMaxBytes = (size_t)-1);
+#endif
+
+    // Release nBytes from the front without copying them, typically after they have been written out through getSegments.
+    // Return: the number of bytes released, smaller than nBytes when the queue has less data.
+    //
+    size_t consume(size_t nBytes);
+
+    static const size_t kMaxSlabBlockSize = 4096;
+
    private:
+    static const int kSlabClassNum = 7;  // 64, 128, ... 4096 bytes.
+
+    bool waitForData(std::unique_lock<std::recursive_mutex>& lock, const std::chrono::milliseconds& timeout);
+
+    bool fitsSlab(size_t nDataSize) const;
+    QUEUE_ELEMENT* allocSlabElement(size_t nDataSize);
+    static QUEUE_ELEMENT* mallocElement(const void* pData, size_t nDataSize);
+    QUEUE_ELEMENT* allocElement(QUEUE_ELEMENT* malloced, const void* pData, size_t nDataSize);
+    void freeElement(QUEUE_ELEMENT* elem);
+
     QUEUE_ELEMENT* first_element_;
     QUEUE_ELEMENT* last_element_;
     size_t element_num_;
     size_t total_data_size_;
     std::string queue_name_;
     std::recursive_mutex queue_mutex_;
+    std::condition_variable_any data_cond_;
+    size_t waiter_num_;  // only notify data_cond_ when someone waits.
+    bool closed_;
+
+    size_t slab_size_;
+    std::vector<void*> slabs_;
+    char* slab_cursor_;  // unused space of the newest slab.
+    size_t slab_left_;
+    QUEUE_ELEMENT* free_blocks_[kSlabClassNum];
+    SlabStatistics slab_stats_;
 };
 }  // namespace jhc
 
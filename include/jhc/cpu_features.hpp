@@ -0,0 +1,62 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef JHC_CPU_FEATURES_HPP__
+#define JHC_CPU_FEATURES_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include "jhc/arch.hpp"
+
+// Marks a function that is compiled for an instruction set extension, without compiling the whole
+// file for it. Such functions may only be called after checking CpuFeatures.
+#if defined(JHC_ARCH_X86_FAMILY) && (defined(__GNUC__) || defined(__clang__))
+#define JHC_TARGET(features) __attribute__((target(features)))
+#else
+#define JHC_TARGET(features)
+#endif
+
+// Intrinsic kernels are only built for x86 with gcc, clang or msvc.
+#if defined(JHC_ARCH_X86_FAMILY) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define JHC_X86_INTRINSICS 1
+#endif
+
+namespace jhc {
+// Instruction set extensions supported by the CPU and the OS, detected once with cpuid.
+// All false on other architectures.
+//
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool sse42 = false;
+    bool pclmul = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool bmi2 = false;
+    bool sha = false;
+
+    static const CpuFeatures& Get();
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/cpu_features.cc"
+#endif
+
+#endif  //! JHC_CPU_FEATURES_HPP__
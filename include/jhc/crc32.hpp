@@ -28,23 +28,111 @@
 #define _WINSOCKAPI_
 #endif  // !_WINSOCKAPI_
 #include "jhc/filesystem.hpp"
+#include "jhc/hasher.hpp"
 
 namespace jhc {
+// CRC-32 (IEEE 802.3, as used by zip, png and zlib).
+// update() runs the fastest kernel the CPU supports: PCLMULQDQ folding on x86-64, slicing-by-16 tables otherwise.
+//
 class CRC32 {
    public:
+    enum class Kernel {
+        Bytewise,   // one table lookup per byte
+        Slicing8,   // 8 tables, 8 bytes per step
+        Slicing16,  // 16 tables, 16 bytes per step
+        Pclmul,     // carry-less multiplication folding, x86 with PCLMULQDQ and SSE4.1
+    };
+
+    enum { kDigestSize = 4 };
+    typedef std::array<uint8_t, kDigestSize> Digest;  // the CRC, big-endian as in digest()
+
     void init();
 
-    void update(const unsigned char* pData, uint32_t uSize);
+    void update(const void* pData, size_t uSize);
 
     void finish();
 
+    // finish() and the CRC as a Digest, see hasher.hpp.
+    //
+    Digest finalize();
+
     std::string digest();
 
+    // The CRC, valid after finish().
+    //
+    uint32_t value() const;
+
     static std::string GetFileCRC32(const fs::path& filePath);
     static std::string GetDataCRC32(const unsigned char* data, size_t dataSize);
 
+    // Same convention as zlib's crc32(): Update(0, data, size) is the CRC of data,
+    // Update(Update(0, a, sizeA), b, sizeB) the CRC of a followed by b.
+    //
+    static uint32_t Update(uint32_t crc, const void* data, size_t size);
+
+    // Same as above with a given kernel, which must be supported.
+    //
+    static uint32_t Update(uint32_t crc, const void* data, size_t size, Kernel kernel);
+
+    // The CRC of a followed by b, from the CRC of a, the CRC of b and the size of b, in O(log(sizeB)).
+    // Lets chunks be checksummed independently (e.g. in parallel) and merged.
+    //
+    static uint32_t Combine(uint32_t crcA, uint32_t crcB, uint64_t sizeB);
+
+    static bool IsKernelSupported(Kernel kernel);
+
+    // The kernel used by update() and Update() on this CPU.
+    //
+    static Kernel ActiveKernel();
+
+   private:
+    uint32_t ulCRC32_ = 0xFFFFFFFF;
+};
+
+// CRC-32C (Castagnoli, as used by iSCSI, SCTP, ext4 and many storage formats).
+// update() uses the SSE4.2 crc32 instruction when available, slicing-by-16 tables otherwise.
+//
+class CRC32C {
+   public:
+    enum class Kernel {
+        Bytewise,
+        Slicing8,
+        Slicing16,
+        Sse42,  // crc32 instruction, x86 with SSE4.2
+    };
+
+    enum { kDigestSize = 4 };
+    typedef std::array<uint8_t, kDigestSize> Digest;  // the CRC, big-endian as in digest()
+
+    void init();
+
+    void update(const void* pData, size_t uSize);
+
+    void finish();
+
+    // finish() and the CRC as a Digest, see hasher.hpp.
+    //
+    Digest finalize();
+
+    std::string digest();
+
+    uint32_t value() const;
+
+    static std::string GetFileCRC32C(const fs::path& filePath);
+    static std::string GetDataCRC32C(const unsigned char* data, size_t dataSize);
+
+    static uint32_t Update(uint32_t crc, const void* data, size_t size);
+
+    static uint32_t Update(uint32_t crc, const void* data, size_t size, Kernel kernel);
+
+    static uint32_t Combine(uint32_t crcA, uint32_t crcB, uint64_t sizeB);
+
+    static bool IsKernelSupported(Kernel kernel);
+
+    static Kernel ActiveKernel();
+
    private:
-    uint32_t ulCRC32_ = 0;
+    uint32_t ulCRC32_ = 0xFFFFFFFF;
 };
 }  // namespace jhc
 
@@ -21,6 +21,7 @@
 #define JHC_FILE_UTIL_HPP_
 #include "jhc/config.hpp"
 #include "jhc/arch.hpp"
+#include <stdint.h>
 #include <stdio.h>
 #include <mutex>
 #include <string>
@@ -31,10 +32,82 @@
 #include "jhc/filesystem.hpp"
 
 namespace jhc {
+// A memory-mapped view of a file region, created by File::map() or File::MapFile().
+// Behaves as a span of bytes. The view stays valid after the File is closed, until the
+// mapping is destroyed or unmap() is called.
+//
+class FileMapping {
+   public:
+    JHC_DISALLOW_COPY(FileMapping);
+
+    // Access pattern hints for the kernel (madvise).
+    //
+    enum class Advice {
+        Normal,
+        Sequential,  // read ahead aggressively, drop pages soon after they are read
+        Random,      // no read ahead
+        WillNeed,    // start reading the pages now
+        DontNeed,    // pages can be dropped, unwritten changes are kept
+    };
+
+    FileMapping() = default;
+    FileMapping(FileMapping&& other) noexcept;
+    FileMapping& operator=(FileMapping&& other) noexcept;
+    ~FileMapping();
+
+    // False when the mapping failed. An empty region gives a valid mapping with size() 0.
+    //
+    bool isValid() const { return valid_; }
+    bool isWritable() const { return writable_; }
+
+    unsigned char* data() { return data_; }
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    unsigned char* begin() { return data_; }
+    unsigned char* end() { return data_ + size_; }
+    const unsigned char* begin() const { return data_; }
+    const unsigned char* end() const { return data_ + size_; }
+
+    unsigned char& operator[](size_t i) { return data_[i]; }
+    const unsigned char& operator[](size_t i) const { return data_[i]; }
+
+    // Applies the hint to [offset, offset + length) of the view, rounded out to whole pages.
+    //
+    bool advise(Advice advice, size_t offset = 0, size_t length = SIZE_MAX);
+
+    // Writes the modified pages of a writable mapping back to the file.
+    // Returns once they are on disk, or as soon as they are scheduled when async is true.
+    //
+    bool flush(bool async = false);
+
+    void unmap();
+
+   private:
+    friend class File;
+
+    unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    void* base_ = nullptr;  // start of the mapped pages
+    size_t mappedSize_ = 0;
+    bool valid_ = false;
+    bool writable_ = false;
+#ifdef JHC_WIN
+    void* mappingHandle_ = nullptr;
+    void* fileHandle_ = nullptr;  // duplicated, to flush writable views to disk
+#endif
+};
+
 class File {
    public:
     JHC_DISALLOW_COPY_MOVE(File);
 
+    enum class MapMode {
+        ReadOnly,
+        ReadWrite,  // changes go to the file, which must be open for update ("r+b", "w+b")
+    };
+
     File(const fs::path& path);
     File(fs::path&& path);
 
@@ -86,6 +159,11 @@ class File {
 
     bool flush();
 
+    // flush() and flushes the file data to the disk (fdatasync, FlushFileBuffers on Windows).
+    // Only the flush() part takes the lock.
+    //
+    bool sync();
+
     bool exist() const;
 
     bool canRW() const;
@@ -96,6 +174,18 @@ class File {
     //
     int64_t fileSize();
 
+    // Must be call open(...) first!
+    // Maps length bytes from offset, up to the end of the file when length is -1.
+    // A ReadOnly view is clipped to the end of the file. A ReadWrite view grows the file to offset + length.
+    // Pending writes are flushed first, so the view sees them.
+    // Return an invalid mapping when failed.
+    //
+    FileMapping map(MapMode mode = MapMode::ReadOnly, int64_t offset = 0, int64_t length = -1);
+
+    // Maps the whole file without keeping it open.
+    //
+    static FileMapping MapFile(const fs::path& filePath, MapMode mode = MapMode::ReadOnly);
+
     // Must be call open(...) first!
     bool seekFromCurrent(int64_t offset);
 
@@ -118,6 +208,47 @@ class File {
     // Caller need allocate/free buffer.
     size_t writeFrom(const void* buffer, size_t needWrite, int64_t from = -1);
 
+    // Positional I/O on the file descriptor (pread/pwrite): no file pointer and no lock, so many
+    // threads can read and write disjoint ranges of one file in parallel.
+    // It bypasses the FILE buffer of the functions above: flush() before switching from them.
+    // With an append mode, writes go to the end of the file whatever the offset (O_APPEND on Linux,
+    // a handle without FILE_WRITE_DATA on Windows).
+    //
+    struct ReadBuffer {
+        void* data;
+        size_t size;
+    };
+
+    struct WriteBuffer {
+        const void* data;
+        size_t size;
+    };
+
+    // Must be call open(...) first!
+    // Return the number of bytes read, less than size at the end of the file or on error.
+    //
+    size_t readAt(void* buffer, size_t size, int64_t offset);
+
+    // Must be call open(...) first!
+    // Return the number of bytes written, less than size on error.
+    //
+    size_t writeAt(const void* buffer, size_t size, int64_t offset);
+
+    // Vectored versions (preadv/pwritev): the buffers are filled, or written, one after the other
+    // from offset, in as few system calls as possible.
+    //
+    size_t readAt(const ReadBuffer* buffers, size_t count, int64_t offset);
+    size_t writeAt(const WriteBuffer* buffers, size_t count, int64_t offset);
+
+    // The descriptor used by readAt/writeAt, -1 when the file is not open.
+    // On Windows, a HANDLE opened for overlapped I/O, nullptr when the file is not open.
+    //
+#ifdef JHC_WIN
+    void* nativeHandle() const;
+#else
+    int nativeHandle() const;
+#endif
+
     // Must be call open(...) first!
     // This function will NOT change file pointer position.
     // readAll function will malloc memory, caller need free it.
@@ -133,6 +264,12 @@ class File {
 
    protected:
     FILE* f_ = nullptr;
+    bool writePending_ = false;  // fwrite since the last flush
+#ifdef JHC_WIN
+    void* handle_ = nullptr;  // of f_, for positional I/O
+#else
+    int fd_ = -1;  // of f_, for positional I/O
+#endif
     jhc::fs::path path_;
     std::recursive_mutex mutex_;
 };
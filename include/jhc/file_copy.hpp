@@ -0,0 +1,69 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_FILE_COPY_HPP__
+#define JHC_FILE_COPY_HPP__
+#include "jhc/config.hpp"
+#include "jhc/arch.hpp"
+#include <stdint.h>
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_
+#endif  // !_WINSOCKAPI_
+#include "jhc/filesystem.hpp"
+
+namespace jhc {
+// File copies that let the kernel move the data, without reading the file into memory.
+//
+class FileCopy {
+   public:
+    // Ways to copy the data, tried in this order.
+    //
+    enum class Method {
+        System,         // CopyFileExW, Windows only (block cloning on ReFS, server-side copy on SMB)
+        Clone,          // FICLONE reflink, shares the blocks (Btrfs, XFS), Linux only
+        CopyFileRange,  // copy_file_range, in-kernel or server-side copy, Linux only
+        Sendfile,       // sendfile, in-kernel copy, Linux only
+        Chunked,        // positional reads and writes through a 1 MB buffer, up to the end of the file
+    };
+
+    // Copies the content and the permissions of the file from to the file to, which is created or overwritten.
+    // method receives the method that copied the data.
+    //
+    static bool Copy(const fs::path& from, const fs::path& to, Method* method = nullptr);
+
+    // Same as above with one method only, fails if it is not supported for these files.
+    // The kernel methods are not supported for files whose reported size is 0, see Chunked.
+    //
+    static bool CopyWith(const fs::path& from, const fs::path& to, Method method);
+
+    // Copies the directory tree from into to (created if needed): directories and symbolic links first,
+    // then the regular files, the largest first, on threads threads (the number of CPUs when 0).
+    // Return false when any copy failed, the others are done anyway.
+    //
+    static bool CopyDirectory(const fs::path& from, const fs::path& to, size_t threads = 0);
+
+   protected:
+    static bool CopyFileData(const fs::path& from, const fs::path& to, const Method* only, Method* used);
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/file_copy.cc"
+#endif
+#endif  // !JHC_FILE_COPY_HPP__
@@ -0,0 +1,108 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef JHC_FILE_DIGEST_HPP__
+#define JHC_FILE_DIGEST_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include <stdint.h>
+#include <string>
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_
+#endif  // !_WINSOCKAPI_
+#include "jhc/filesystem.hpp"
+
+namespace jhc {
+class ThreadPool;
+
+// Computes several digests of a file in a single pass.
+// The file is read in large aligned chunks through an AsyncFileEngine that keeps several reads in flight while
+// the current chunk is hashed. Each requested algorithm runs on its own thread and CRCs of a chunk are split over
+// the remaining threads and merged with CRC32::Combine / CRC32C::Combine.
+//
+class FileDigest {
+   public:
+    enum {
+        ALG_CRC32 = 1 << 0,
+        ALG_CRC32C = 1 << 1,
+        ALG_MD5 = 1 << 2,
+        ALG_SHA1 = 1 << 3,
+        ALG_SHA256 = 1 << 4,
+        ALG_SHA512 = 1 << 5,
+    };
+
+    enum {
+        kDefaultChunkSize = 4 * 1024 * 1024,
+        // Chunks read ahead of the one being hashed.
+        kReadDepth = 4,
+    };
+
+    // Lower case hex digests, empty for the algorithms that were not requested.
+    //
+    struct Result {
+        uint64_t size = 0;
+        std::string crc32;
+        std::string crc32c;
+        std::string md5;
+        std::string sha1;
+        std::string sha256;
+        std::string sha512;
+    };
+
+    // algorithms: combination of ALG_* flags.
+    // threads: 0 uses one thread per hardware thread, 1 hashes on the calling thread only. Otherwise the hashing runs
+    //          on a thread pool shared by all the calls, created on first use.
+    // chunkSize: rounded up to a multiple of 4KB.
+    // direct: the reads bypass the page cache (O_DIRECT, Linux only) when the file system allows it, so hashing
+    //         files larger than the memory does not evict the cache.
+    // Returns false if the file can not be opened or fails to be read completely.
+    //
+    static bool Compute(const fs::path& filePath,
+                        unsigned int algorithms,
+                        Result& result,
+                        size_t threads = 0,
+                        size_t chunkSize = kDefaultChunkSize,
+                        bool direct = false);
+
+    // Same as above, the hashing runs on pool and on the calling thread.
+    //
+    static bool Compute(const fs::path& filePath,
+                        unsigned int algorithms,
+                        Result& result,
+                        ThreadPool& pool,
+                        size_t chunkSize = kDefaultChunkSize,
+                        bool direct = false);
+
+   protected:
+    // pool: null to hash on the calling thread. parts: number of concurrent tasks a chunk is split into.
+    static bool Run(const fs::path& filePath,
+                    unsigned int algorithms,
+                    Result& result,
+                    ThreadPool* pool,
+                    size_t parts,
+                    size_t chunkSize,
+                    bool direct);
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/file_digest.cc"
+#endif
+
+#endif  //! JHC_FILE_DIGEST_HPP__
@@ -0,0 +1,123 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_FILE_WRITER_HPP__
+#define JHC_FILE_WRITER_HPP__
+#include "jhc/config.hpp"
+#include "jhc/arch.hpp"
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "jhc/macros.hpp"
+#include "jhc/file.hpp"
+#include "jhc/async_file.hpp"
+
+namespace jhc {
+// Sequential writer for large outputs.
+// Data is copied into big aligned buffers, a full buffer is written in the background by an AsyncFileEngine while
+// the next one is filled, so the producer only waits when the disk is slower than the producer.
+// In direct mode (O_DIRECT, Linux only) the writes bypass the page cache.
+//
+// Not thread-safe: one producer per writer, no lock is taken per write().
+//
+class FileWriter {
+   public:
+    JHC_DISALLOW_COPY_MOVE(FileWriter);
+
+    // Alignment of the buffers, of the file offsets and of the lengths in direct mode.
+    static const size_t kAlignment = 4096;
+
+    // bufferSize: rounded up to a multiple of kAlignment.
+    // bufferCount: at least 2, up to bufferCount - 1 buffers are written while the last one is filled.
+    //
+    FileWriter(size_t bufferSize = 4 * 1024 * 1024, size_t bufferCount = 2);
+
+    // Writes what is buffered and closes the file.
+    //
+    ~FileWriter();
+
+    // Creates or truncates the file, or appends to it.
+    // With direct, the writes bypass the page cache when the system and the file system allow it,
+    // see isDirect().
+    //
+    bool open(const fs::path& path, bool append = false, bool direct = false);
+
+    bool isOpen() const;
+
+    bool isDirect() const;
+
+    // Copies the data into the buffers.
+    // Return false when the file is not open or a previous write failed.
+    //
+    bool write(const void* data, size_t size);
+
+    // Writes the buffered data and waits until everything is written (but not necessarily on the disk).
+    //
+    bool flush();
+
+    // flush() and flushes the file data to the disk.
+    //
+    bool sync();
+
+    // flush() and closes the file.
+    //
+    bool close();
+
+    // Size of the file, including the buffered data.
+    //
+    int64_t size() const;
+
+    // Whether a background write failed, all later calls fail too.
+    //
+    bool failed() const;
+
+   protected:
+    struct Buffer {
+        unsigned char* data = nullptr;
+        bool busy = false;  // being written
+    };
+
+    // Hands the current buffer over to the engine and switches to the next free one.
+    void handOff();
+
+    static unsigned char* AllocAligned(size_t size);
+    static void FreeAligned(unsigned char* p);
+
+    const size_t bufferSize_;
+    std::unique_ptr<File> file_;
+    std::unique_ptr<AsyncFileEngine> engine_;
+    std::vector<Buffer> buffers_;
+    size_t current_ = 0;
+    size_t used_ = 0;            // bytes in the current buffer
+    int64_t bufferOffset_ = 0;   // file offset of the current buffer
+    int64_t written_ = 0;        // end of the data handed over to the engine, or already in the file
+    bool direct_ = false;
+    std::atomic<bool> failed_;
+    std::mutex mutex_;
+    std::condition_variable bufferFreed_;
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/file_writer.cc"
+#endif
+#endif  // !JHC_FILE_WRITER_HPP__
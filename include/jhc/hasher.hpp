@@ -0,0 +1,74 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_HASHER_HPP__
+#define JHC_HASHER_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include "jhc/hex_encode.hpp"
+#include <stdint.h>
+#include <string.h>
+#include <array>
+#include <string>
+
+namespace jhc {
+// MD5, SHA1, SHA256, SHA512, CRC32, CRC32C, XXH3Hash64 and XXH3Hash128 share a streaming interface:
+//
+//   Hasher::kDigestSize, Hasher::Digest     the digest, std::array<uint8_t, kDigestSize>
+//   Hasher h;                               ready to use
+//   h.init();                               starts over
+//   h.update(data, size);                   any number of times, size is a size_t
+//   Hasher::Digest d = h.finalize();        h needs init() before being reused
+//
+// Hashers are copyable values that own no heap memory. A copy taken after hashing a common
+// prefix is its midstate: each copy can then hash a different suffix without hashing the
+// prefix again.
+//
+
+// The digest of a whole buffer, e.g. HashOf<SHA256>(data, size).
+//
+template <class Hasher>
+typename Hasher::Digest HashOf(const void* data, size_t size) {
+    Hasher hasher;
+    hasher.update(data, size);
+    return hasher.finalize();
+}
+
+// Lower-case hex, as returned by the GetData* functions.
+//
+template <size_t N>
+std::string DigestToHex(const std::array<uint8_t, N>& digest) {
+    return HexEncode::Encode((const char*)digest.data(), N);
+}
+
+// Hash functor to use digests as keys of unordered containers. Digest bytes are already
+// uniformly distributed, so the first bytes are used as is.
+//
+struct DigestHash {
+    template <size_t N>
+    size_t operator()(const std::array<uint8_t, N>& digest) const noexcept {
+        size_t h = 0;
+        memcpy(&h, digest.data(), N < sizeof(h) ? N : sizeof(h));
+        return h;
+    }
+};
+}  // namespace jhc
+
+#endif  // !JHC_HASHER_HPP__
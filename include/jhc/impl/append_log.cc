@@ -0,0 +1,231 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../append_log.hpp"
+#endif
+
+#include <algorithm>
+#include "jhc/crc32.hpp"
+
+namespace jhc {
+namespace append_log_detail {
+// Read size of the recovery scan.
+const size_t kScanChunk = 1024 * 1024;
+
+inline uint32_t LoadLE32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void StoreLE32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+// CRC32 of the size field followed by the payload.
+inline uint32_t FrameCRC(const unsigned char* sizeField, const void* data, size_t size) {
+    return CRC32::Update(CRC32::Update(0, sizeField, 4), data, size);
+}
+}  // namespace append_log_detail
+}  // namespace jhc
+
+JHC_INLINE jhc::AppendLog::AppendLog() {}
+
+JHC_INLINE jhc::AppendLog::~AppendLog() {
+    close();
+}
+
+JHC_INLINE bool jhc::AppendLog::open(const fs::path& path) {
+    close();
+
+    // Recovery on a read-only handle: the torn tail is cut before the log is opened for writing.
+    int64_t end = 0;
+    uint64_t count = 0;
+    {
+        File file(path);
+        if (file.open("rb")) {
+            const int64_t fileSize = file.fileSize();
+            if (fileSize < 0 || !Scan(file, fileSize, nullptr, end, count))
+                return false;
+            file.close();
+
+            if (end < fileSize) {
+                std::error_code ec;
+                fs::resize_file(path, (uintmax_t)end, ec);
+                if (ec)
+                    return false;
+            }
+        }
+    }
+
+    std::unique_ptr<File> file(new File(path));
+    if (!file->open("rb+") && !file->open("wb+"))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_ = std::move(file);
+    batch_.clear();
+    batchRecords_ = 0;
+    batchId_ = 1;
+    committedId_ = 0;
+    failedId_ = UINT64_MAX;
+    end_ = durableEnd_ = end;
+    records_ = count;
+    commits_ = 0;
+    return true;
+}
+
+JHC_INLINE bool jhc::AppendLog::close() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    committed_.wait(lock, [this]() { return !committing_ && replaying_ == 0 && batch_.empty(); });
+    if (!file_)
+        return false;
+
+    const bool result = file_->close();
+    file_.reset();
+    return result;
+}
+
+JHC_INLINE bool jhc::AppendLog::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ != nullptr;
+}
+
+JHC_INLINE int64_t jhc::AppendLog::append(const void* data, size_t size) {
+    if (size > kMaxRecordSize || (!data && size > 0))
+        return -1;
+
+    unsigned char header[kHeaderSize];
+    append_log_detail::StoreLE32(header, (uint32_t)size);
+    append_log_detail::StoreLE32(header + 4, append_log_detail::FrameCRC(header, data, size));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!file_ || failedId_ != UINT64_MAX)
+        return -1;
+
+    const int64_t offset = end_ + (int64_t)batch_.size();
+    batch_.insert(batch_.end(), header, header + kHeaderSize);
+    batch_.insert(batch_.end(), static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+    batchRecords_++;
+    const uint64_t id = batchId_;
+
+    while (committedId_ < id && failedId_ > id) {
+        if (committing_) {
+            committed_.wait(lock);
+            continue;
+        }
+
+        // No commit running: this appender leads the commit of the batch, its own record included.
+        committing_ = true;
+        writing_.swap(batch_);
+        batch_.clear();
+        const uint64_t writingId = batchId_++;
+        const uint64_t writingRecords = batchRecords_;
+        batchRecords_ = 0;
+        const int64_t at = end_;
+        end_ += (int64_t)writing_.size();
+
+        lock.unlock();
+        const bool ok = file_->writeAt(writing_.data(), writing_.size(), at) == writing_.size() && file_->sync();
+        lock.lock();
+
+        committing_ = false;
+        committedId_ = writingId;
+        commits_++;
+        if (ok) {
+            durableEnd_ = at + (int64_t)writing_.size();
+            records_ += writingRecords;
+        }
+        else {
+            // The batches collected meanwhile are dropped, their appenders fail too.
+            failedId_ = writingId;
+            batch_.clear();
+            batchRecords_ = 0;
+        }
+        writing_.clear();
+        committed_.notify_all();
+    }
+
+    return (failedId_ <= id) ? -1 : offset;
+}
+
+JHC_INLINE bool jhc::AppendLog::replay(const Visitor& visitor) {
+    int64_t end = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_)
+            return false;
+        end = durableEnd_;
+        // close() waits for the replays, file_ stays valid without holding the lock.
+        replaying_++;
+    }
+
+    int64_t scanned = 0;
+    uint64_t count = 0;
+    const bool result = Scan(*file_, end, &visitor, scanned, count);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--replaying_ == 0)
+        committed_.notify_all();
+    return result;
+}
+
+JHC_INLINE uint64_t jhc::AppendLog::recordCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_;
+}
+
+JHC_INLINE int64_t jhc::AppendLog::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return durableEnd_;
+}
+
+JHC_INLINE uint64_t jhc::AppendLog::commitCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return commits_;
+}
+
+JHC_INLINE bool jhc::AppendLog::Scan(File& file, int64_t fileSize, const Visitor* visitor, int64_t& end, uint64_t& count) {
+    end = 0;
+    count = 0;
+
+    // Frames are parsed from large reads, a frame larger than a read gets a read of its own.
+    std::vector<unsigned char> buffer;
+    int64_t bufferOffset = 0;
+    size_t bufferSize = 0;
+    auto fill = [&](int64_t pos, size_t need) {
+        const size_t want = (size_t)std::min<int64_t>(std::max(need, append_log_detail::kScanChunk), fileSize - pos);
+        if (buffer.size() < want)
+            buffer.resize(want);
+        bufferOffset = pos;
+        bufferSize = file.readAt(buffer.data(), want, pos);
+        return bufferSize >= need;
+    };
+
+    int64_t pos = 0;
+    while (fileSize - pos >= kHeaderSize) {
+        if (pos + kHeaderSize > bufferOffset + (int64_t)bufferSize && !fill(pos, kHeaderSize))
+            return false;
+
+        const uint32_t size = append_log_detail::LoadLE32(&buffer[(size_t)(pos - bufferOffset)]);
+        if (size > kMaxRecordSize || fileSize - pos - kHeaderSize < (int64_t)size)
+            break;
+
+        const size_t frame = kHeaderSize + (size_t)size;
+        if (pos + (int64_t)frame > bufferOffset + (int64_t)bufferSize && !fill(pos, frame))
+            return false;
+
+        const unsigned char* header = &buffer[(size_t)(pos - bufferOffset)];
+        if (append_log_detail::LoadLE32(header + 4) != append_log_detail::FrameCRC(header, header + kHeaderSize, size))
+            break;
+
+        count++;
+        pos += (int64_t)frame;
+        if (visitor && !(*visitor)(header + kHeaderSize, size, pos - (int64_t)frame))
+            break;
+    }
+
+    end = pos;
+    return true;
+}
@@ -0,0 +1,486 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../async_file.hpp"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#ifdef JHC_WIN
+#ifndef _INC_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+#else
+#include <unistd.h>
+#endif
+#ifdef JHC_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+namespace jhc {
+namespace async_file_detail {
+// Largest transfer of one system call.
+const size_t kMaxIoSize = 1024 * 1024 * 1024;
+
+// The engine whose completion callback runs on this thread, if any.
+inline const AsyncFileEngine*& CallbackEngine() {
+    static thread_local const AsyncFileEngine* engine = nullptr;
+    return engine;
+}
+
+#if defined(JHC_LINUX) && defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define JHC_ASYNC_FILE_IO_URING 1
+
+// user_data of the no-op that stops the reaper thread.
+const uint64_t kStopReaper = ~0ULL;
+
+inline int IoUringSetup(unsigned entries, io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+inline int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+// The rings are shared with the kernel: the producer publishes with a release store of the tail,
+// the consumer with a release store of the head.
+inline unsigned LoadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void StoreRelease(unsigned* p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+#endif
+}  // namespace async_file_detail
+}  // namespace jhc
+
+JHC_INLINE jhc::AsyncFileEngine::AsyncFileEngine(size_t queueDepth, Backend backend, size_t threads) :
+    queueDepth_(std::max<size_t>(queueDepth, 1)) {
+    slots_.resize(queueDepth_);
+    for (size_t i = queueDepth_; i > 0; i--)
+        freeSlots_.push_back(i - 1);
+
+#ifdef JHC_LINUX
+    if (backend != Backend::Threads && setupRing()) {
+        backend_ = Backend::IoUring;
+        reaper_ = std::thread([this]() { reapLoop(); });
+        return;
+    }
+#else
+    (void)backend;
+#endif
+    backend_ = Backend::Threads;
+    queued_.reserve(queueDepth_);
+    pool_.reset(new ThreadPool(std::max<size_t>(std::min(threads, queueDepth_), 1)));
+}
+
+JHC_INLINE jhc::AsyncFileEngine::~AsyncFileEngine() {
+    wait();
+
+#ifdef JHC_ASYNC_FILE_IO_URING
+    if (backend_ == Backend::IoUring) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const unsigned tail = *sqTail_;
+            const unsigned index = tail & sqMask_;
+            io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = async_file_detail::kStopReaper;
+            sqArray_[index] = index;
+            async_file_detail::StoreRelease(sqTail_, tail + 1);
+            unsubmitted_++;
+            submitLocked();
+        }
+        completeFailed();
+        reaper_.join();
+        closeRing();
+    }
+#endif
+    pool_.reset();
+}
+
+JHC_INLINE jhc::AsyncFileEngine::Backend jhc::AsyncFileEngine::backend() const {
+    return backend_;
+}
+
+JHC_INLINE size_t jhc::AsyncFileEngine::queueDepth() const {
+    return queueDepth_;
+}
+
+JHC_INLINE bool jhc::AsyncFileEngine::read(File& file, void* buffer, size_t size, int64_t offset, Callback callback) {
+    return queue(Opcode::Read, file, buffer, size, offset, std::move(callback)) == 0;
+}
+
+JHC_INLINE bool jhc::AsyncFileEngine::write(File& file, const void* buffer, size_t size, int64_t offset, Callback callback) {
+    return queue(Opcode::Write, file, const_cast<void*>(buffer), size, offset, std::move(callback)) == 0;
+}
+
+JHC_INLINE bool jhc::AsyncFileEngine::sync(File& file, Callback callback) {
+    return queue(Opcode::Sync, file, nullptr, 0, 0, std::move(callback)) == 0;
+}
+
+JHC_INLINE std::future<int64_t> jhc::AsyncFileEngine::read(File& file, void* buffer, size_t size, int64_t offset) {
+    return queueFuture(Opcode::Read, file, buffer, size, offset);
+}
+
+JHC_INLINE std::future<int64_t> jhc::AsyncFileEngine::write(File& file, const void* buffer, size_t size, int64_t offset) {
+    return queueFuture(Opcode::Write, file, const_cast<void*>(buffer), size, offset);
+}
+
+JHC_INLINE std::future<int64_t> jhc::AsyncFileEngine::sync(File& file) {
+    return queueFuture(Opcode::Sync, file, nullptr, 0, 0);
+}
+
+JHC_INLINE size_t jhc::AsyncFileEngine::submit() {
+    size_t submitted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        submitted = submitLocked();
+    }
+    completeFailed();
+    return submitted;
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    submitLocked();
+    lock.unlock();
+    completeFailed();
+    lock.lock();
+    slotFreed_.wait(lock, [this]() { return freeSlots_.size() == queueDepth_ && completing_ == 0; });
+}
+
+JHC_INLINE size_t jhc::AsyncFileEngine::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queueDepth_ - freeSlots_.size();
+}
+
+JHC_INLINE int jhc::AsyncFileEngine::queue(Opcode opcode, File& file, void* buffer, size_t size, int64_t offset, Callback callback) {
+#ifdef JHC_WIN
+    if (!file.nativeHandle() || offset < 0)
+        return -EBADF;
+#else
+    if (file.nativeHandle() < 0 || offset < 0)
+        return -EBADF;
+#endif
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (freeSlots_.empty()) {
+        // A callback waiting for a slot blocks the thread that completes operations and frees slots.
+        if (async_file_detail::CallbackEngine() == this)
+            return -EAGAIN;
+        // Nothing would free a slot while the queued operations wait for submit().
+        submitLocked();
+        if (!failed_.empty()) {
+            lock.unlock();
+            completeFailed();
+            lock.lock();
+        }
+        slotFreed_.wait(lock, [this]() { return !freeSlots_.empty(); });
+    }
+    const size_t slot = freeSlots_.back();
+    freeSlots_.pop_back();
+
+    Operation& op = slots_[slot];
+    op.opcode = opcode;
+    op.file = &file;
+    op.buffer = buffer;
+    op.size = size;
+    op.offset = offset;
+    op.done = 0;
+    op.callback = std::move(callback);
+    pushLocked(slot);
+    return 0;
+}
+
+JHC_INLINE std::future<int64_t> jhc::AsyncFileEngine::queueFuture(Opcode opcode, File& file, void* buffer, size_t size, int64_t offset) {
+    std::shared_ptr<std::promise<int64_t>> promise = std::make_shared<std::promise<int64_t>>();
+    std::future<int64_t> result = promise->get_future();
+    const int error = queue(opcode, file, buffer, size, offset, [promise](int64_t r) { promise->set_value(r); });
+    if (error != 0)
+        promise->set_value(error);
+    return result;
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::pushLocked(size_t slot) {
+#ifdef JHC_ASYNC_FILE_IO_URING
+    if (backend_ == Backend::IoUring) {
+        // Every slot has at most one entry in the submission queue, which has at least queueDepth_ entries.
+        const Operation& op = slots_[slot];
+        const unsigned tail = *sqTail_;
+        const unsigned index = tail & sqMask_;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = op.file->nativeHandle();
+        sqe->user_data = slot;
+        if (op.opcode == Opcode::Sync) {
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        }
+        else {
+            sqe->opcode = (op.opcode == Opcode::Read) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (uint64_t)(uintptr_t)(static_cast<char*>(op.buffer) + op.done);
+            sqe->len = (uint32_t)std::min(op.size - op.done, async_file_detail::kMaxIoSize);
+            sqe->off = (uint64_t)(op.offset + (int64_t)op.done);
+        }
+        sqArray_[index] = index;
+        async_file_detail::StoreRelease(sqTail_, tail + 1);
+        unsubmitted_++;
+        return;
+    }
+#endif
+    queued_.push_back(slot);
+}
+
+JHC_INLINE size_t jhc::AsyncFileEngine::submitLocked() {
+    size_t submitted = 0;
+#ifdef JHC_ASYNC_FILE_IO_URING
+    if (backend_ == Backend::IoUring) {
+        while (unsubmitted_ > 0) {
+            const int r = async_file_detail::IoUringEnter(ringFd_, (unsigned)unsubmitted_, 0, 0);
+            if (r < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // The kernel refuses the entries: take them back and fail their operations, which would
+                // never complete otherwise. The kernel only reads the queue in io_uring_enter.
+                const int64_t error = -errno;
+                const unsigned tail = *sqTail_;
+                for (unsigned i = tail - (unsigned)unsubmitted_; i != tail; i++) {
+                    const uint64_t userData = (static_cast<const io_uring_sqe*>(sqes_) + (i & sqMask_))->user_data;
+                    if (userData == async_file_detail::kStopReaper)
+                        continue;
+                    // The rest of a partial transfer reports what was transferred so far.
+                    const size_t done = slots_[(size_t)userData].done;
+                    failed_.push_back(std::make_pair((size_t)userData, done > 0 ? (int64_t)done : error));
+                }
+                async_file_detail::StoreRelease(sqTail_, tail - (unsigned)unsubmitted_);
+                unsubmitted_ = 0;
+                break;
+            }
+            unsubmitted_ -= (size_t)r;
+            submitted += (size_t)r;
+        }
+        return submitted;
+    }
+#endif
+    for (size_t slot : queued_)
+        pool_->post([this, slot]() { runOperation(slot); });
+    submitted = queued_.size();
+    queued_.clear();
+    return submitted;
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::onResult(size_t slot, int64_t result) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Operation& op = slots_[slot];
+        if (op.opcode != Opcode::Sync && result > 0) {
+            op.done += (size_t)result;
+            if (op.done < op.size) {
+                pushLocked(slot);
+                submitLocked();
+                slot = SIZE_MAX;
+            }
+        }
+        if (op.done > 0)
+            result = (int64_t)op.done;
+    }
+    if (slot == SIZE_MAX)
+        completeFailed();
+    else
+        complete(slot, result);
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::runOperation(size_t slot) {
+    Operation& op = slots_[slot];
+    int64_t result = 0;
+#ifdef JHC_WIN
+    if (op.opcode == Opcode::Sync)
+        result = FlushFileBuffers((HANDLE)op.file->nativeHandle()) ? 0 : -EIO;
+    else if (op.opcode == Opcode::Read)
+        result = (int64_t)op.file->readAt(op.buffer, op.size, op.offset);
+    else
+        result = (int64_t)op.file->writeAt(op.buffer, op.size, op.offset);
+#else
+    const int fd = op.file->nativeHandle();
+    if (op.opcode == Opcode::Sync) {
+        int r;
+        do {
+            r = fdatasync(fd);
+        } while (r != 0 && errno == EINTR);
+        result = (r == 0) ? 0 : -errno;
+    }
+    else {
+        while (op.done < op.size) {
+            char* p = static_cast<char*>(op.buffer) + op.done;
+            const size_t n = std::min(op.size - op.done, async_file_detail::kMaxIoSize);
+            const int64_t at = op.offset + (int64_t)op.done;
+            const ssize_t r = (op.opcode == Opcode::Read) ? pread64(fd, p, n, at) : pwrite64(fd, p, n, at);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r < 0 && op.done == 0)
+                result = -errno;
+            if (r <= 0)
+                break;
+            op.done += (size_t)r;
+        }
+        if (op.done > 0)
+            result = (int64_t)op.done;
+    }
+#endif
+    complete(slot, result);
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::complete(size_t slot, int64_t result) {
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Operation& op = slots_[slot];
+        callback = std::move(op.callback);
+        op.callback = nullptr;
+        op.file = nullptr;
+        freeSlots_.push_back(slot);
+        completing_++;
+    }
+    // The slot is free before the callback runs, so the callback can queue a new operation.
+    slotFreed_.notify_all();
+
+    if (callback) {
+        const AsyncFileEngine*& engine = async_file_detail::CallbackEngine();
+        const AsyncFileEngine* outer = engine;
+        engine = this;
+        callback(result);
+        engine = outer;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        completing_--;
+    }
+    slotFreed_.notify_all();
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::completeFailed() {
+    std::vector<std::pair<size_t, int64_t>> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_.empty())
+            return;
+        failed.swap(failed_);
+    }
+    for (const std::pair<size_t, int64_t>& f : failed)
+        complete(f.first, f.second);
+}
+
+#ifdef JHC_LINUX
+JHC_INLINE bool jhc::AsyncFileEngine::setupRing() {
+#ifdef JHC_ASYNC_FILE_IO_URING
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int fd = async_file_detail::IoUringSetup((unsigned)queueDepth_, &params);
+    if (fd < 0)
+        return false;
+    ringFd_ = fd;
+
+    // IORING_OP_READ/WRITE need Linux 5.6, which is also the first version with IORING_FEAT_RW_CUR_POS.
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        closeRing();
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+    void* sq = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        closeRing();
+        return false;
+    }
+    sqRing_ = sq;
+
+    if (!singleMmap) {
+        void* cq = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            closeRing();
+            return false;
+        }
+        cqRing_ = cq;
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        closeRing();
+        return false;
+    }
+    sqes_ = sqes;
+
+    char* sqBase = static_cast<char*>(sqRing_);
+    char* cqBase = static_cast<char*>(cqRing_ ? cqRing_ : sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+    cqes_ = cqBase + params.cq_off.cqes;
+    return true;
+#else
+    return false;
+#endif
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::closeRing() {
+    if (sqes_)
+        munmap(sqes_, sqesSize_);
+    if (cqRing_)
+        munmap(cqRing_, cqRingSize_);
+    if (sqRing_)
+        munmap(sqRing_, sqRingSize_);
+    if (ringFd_ >= 0)
+        ::close(ringFd_);
+    sqes_ = cqRing_ = sqRing_ = nullptr;
+    ringFd_ = -1;
+}
+
+JHC_INLINE void jhc::AsyncFileEngine::reapLoop() {
+#ifdef JHC_ASYNC_FILE_IO_URING
+    for (;;) {
+        unsigned head = *cqHead_;
+        if (head == async_file_detail::LoadAcquire(cqTail_)) {
+            if (async_file_detail::IoUringEnter(ringFd_, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    std::this_thread::yield();
+                else  // cannot block until a completion (e.g. ENOMEM): polls the completion queue without spinning hot.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+
+        const io_uring_cqe* cqe = static_cast<const io_uring_cqe*>(cqes_) + (head & cqMask_);
+        const uint64_t userData = cqe->user_data;
+        const int64_t result = cqe->res;
+        async_file_detail::StoreRelease(cqHead_, head + 1);
+
+        if (userData == async_file_detail::kStopReaper)
+            return;
+        onResult((size_t)userData, result);
+    }
+#endif
+}
+#endif
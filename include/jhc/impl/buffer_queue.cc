@@ -4,45 +4,160 @@
 #include "../buffer_queue.hpp"
 #endif
 
-JHC_INLINE jhc::BufferQueue::BufferQueue(const std::string& name) {
+JHC_INLINE jhc::BufferQueue::BufferQueue(const std::string& name, size_t slabSize) {
     queue_name_ = name;
     first_element_ = nullptr;
     last_element_ = nullptr;
     element_num_ = 0;
     total_data_size_ = 0;
+    waiter_num_ = 0;
+    closed_ = false;
+
+    if (slabSize > 0 && slabSize < kMaxSlabBlockSize)
+        slabSize = kMaxSlabBlockSize;
+    slab_size_ = slabSize;
+    slab_cursor_ = nullptr;
+    slab_left_ = 0;
+    memset(free_blocks_, 0, sizeof(free_blocks_));
+    memset(&slab_stats_, 0, sizeof(slab_stats_));
 }
 
 JHC_INLINE jhc::BufferQueue::~BufferQueue() {
     clear();
+
+    for (void* slab : slabs_)
+        free(slab);
+    slabs_.clear();
 }
 
 JHC_INLINE std::string jhc::BufferQueue::getQueueName() const {
     return queue_name_;
 }
 
-JHC_INLINE bool jhc::BufferQueue::pushElementToFront(void* pData, size_t nDataSize) {
-    if (pData == nullptr || nDataSize == 0)
-        return false;
+JHC_INLINE bool jhc::BufferQueue::isSlabEnabled() const {
+    return slab_size_ > 0;
+}
 
-    QUEUE_ELEMENT* elem = (QUEUE_ELEMENT*)malloc(sizeof(QUEUE_ELEMENT));
+JHC_INLINE jhc::BufferQueue::SlabStatistics jhc::BufferQueue::getSlabStatistics() {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    return slab_stats_;
+}
 
+JHC_INLINE bool jhc::BufferQueue::fitsSlab(size_t nDataSize) const {
+    return slab_size_ > 0 && sizeof(QUEUE_ELEMENT) + nDataSize <= kMaxSlabBlockSize;
+}
+
+// Must be called with queue_mutex_ held, and only for sizes that fit the slab.
+JHC_INLINE jhc::QUEUE_ELEMENT* jhc::BufferQueue::allocSlabElement(size_t nDataSize) {
+    const size_t blockSize = sizeof(QUEUE_ELEMENT) + nDataSize;
+    int cls = 0;
+    size_t clsSize = 64;
+    while (clsSize < blockSize) {
+        clsSize <<= 1;
+        cls++;
+    }
+
+    QUEUE_ELEMENT* elem = free_blocks_[cls];
+    if (elem) {
+        free_blocks_[cls] = elem->next;
+        slab_stats_.hits++;
+    }
+    else {
+        if (slab_left_ < clsSize) {
+            // the tail of the old slab is too small for this class, it is simply left unused.
+            void* slab = malloc(slab_size_);
+            if (!slab)
+                return nullptr;
+            slabs_.push_back(slab);
+            slab_cursor_ = (char*)slab;
+            slab_left_ = slab_size_;
+            slab_stats_.slabCount++;
+            slab_stats_.slabBytes += slab_size_;
+        }
+
+        elem = (QUEUE_ELEMENT*)slab_cursor_;
+        slab_cursor_ += clsSize;
+        slab_left_ -= clsSize;
+        slab_stats_.misses++;
+    }
+
+    elem->dataStartAddress = elem + 1;
+    elem->dataReadAddress = elem->dataStartAddress;
+    elem->size = nDataSize;
+    elem->slabClass = cls;
+    return elem;
+}
+
+// Does not touch the queue, called without queue_mutex_ held.
+JHC_INLINE jhc::QUEUE_ELEMENT* jhc::BufferQueue::mallocElement(const void* pData, size_t nDataSize) {
+    QUEUE_ELEMENT* elem = (QUEUE_ELEMENT*)malloc(sizeof(QUEUE_ELEMENT));
     if (!elem)
-        return false;
+        return nullptr;
 
     void* data = malloc(nDataSize);
-
     if (!data) {
         free(elem);
+        return nullptr;
+    }
+    memcpy(data, pData, nDataSize);
+
+    elem->dataStartAddress = data;
+    elem->dataReadAddress = data;
+    elem->size = nDataSize;
+    elem->slabClass = -1;
+    return elem;
+}
+
+// Must be called with queue_mutex_ held. Takes a slab block, or counts the malloc'd element as a slab miss.
+JHC_INLINE jhc::QUEUE_ELEMENT* jhc::BufferQueue::allocElement(QUEUE_ELEMENT* malloced, const void* pData, size_t nDataSize) {
+    if (malloced) {
+        if (slab_size_ > 0)
+            slab_stats_.misses++;
+        return malloced;
+    }
+
+    QUEUE_ELEMENT* elem = allocSlabElement(nDataSize);
+    if (elem)
+        memcpy(elem->dataStartAddress, pData, nDataSize);
+    return elem;
+}
+
+// Must be called with queue_mutex_ held.
+JHC_INLINE void jhc::BufferQueue::freeElement(QUEUE_ELEMENT* elem) {
+    if (elem->slabClass >= 0) {
+        elem->next = free_blocks_[elem->slabClass];
+        free_blocks_[elem->slabClass] = elem;
+        return;
+    }
+
+    if (elem->dataStartAddress)
+        free(elem->dataStartAddress);
+    free(elem);
+}
+
+JHC_INLINE bool jhc::BufferQueue::pushElementToFront(void* pData, size_t nDataSize) {
+    if (pData == nullptr || nDataSize == 0)
         return false;
+
+    // Without the slab, the element is allocated and filled before taking the lock.
+    QUEUE_ELEMENT* malloced = nullptr;
+    if (!fitsSlab(nDataSize)) {
+        malloced = mallocElement(pData, nDataSize);
+        if (!malloced)
+            return false;
     }
 
     {
         std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
-        memcpy(data, pData, nDataSize);
+        if (closed_) {
+            if (malloced)
+                freeElement(malloced);
+            return false;
+        }
 
-        elem->dataReadAddress = data;
-        elem->dataStartAddress = data;
-        elem->size = nDataSize;
+        QUEUE_ELEMENT* elem = allocElement(malloced, pData, nDataSize);
+        if (!elem)
+            return false;
 
         total_data_size_ += nDataSize;
         element_num_++;
@@ -60,6 +175,9 @@ JHC_INLINE bool jhc::BufferQueue::pushElementToFront(void* pData, size_t nDataSi
             first_element_->prev = elem;
             first_element_ = elem;
         }
+
+        if (waiter_num_ > 0)
+            data_cond_.notify_one();
     }
 
     return true;
@@ -69,26 +187,25 @@ JHC_INLINE bool jhc::BufferQueue::pushElementToLast(void* pData, size_t nDataSiz
     if (pData == nullptr || nDataSize == 0)
         return false;
 
-    QUEUE_ELEMENT* elem = (QUEUE_ELEMENT*)malloc(sizeof(QUEUE_ELEMENT));
-
-    if (!elem)
-        return false;
-
-    void* data = malloc(nDataSize);
-
-    if (!data) {
-        free(elem);
-        return false;
+    // Without the slab, the element is allocated and filled before taking the lock.
+    QUEUE_ELEMENT* malloced = nullptr;
+    if (!fitsSlab(nDataSize)) {
+        malloced = mallocElement(pData, nDataSize);
+        if (!malloced)
+            return false;
     }
 
     {
         std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+        if (closed_) {
+            if (malloced)
+                freeElement(malloced);
+            return false;
+        }
 
-        memcpy(data, pData, nDataSize);
-
-        elem->dataReadAddress = data;
-        elem->dataStartAddress = data;
-        elem->size = nDataSize;
+        QUEUE_ELEMENT* elem = allocElement(malloced, pData, nDataSize);
+        if (!elem)
+            return false;
 
         total_data_size_ += nDataSize;
         element_num_++;
@@ -107,6 +224,9 @@ JHC_INLINE bool jhc::BufferQueue::pushElementToLast(void* pData, size_t nDataSiz
             last_element_->next = elem;
             last_element_ = elem;
         }
+
+        if (waiter_num_ > 0)
+            data_cond_.notify_one();
     }
 
     return true;
@@ -134,17 +254,11 @@ JHC_INLINE size_t jhc::BufferQueue::popElementFromFront(void* pBuffer, size_t nB
         if (next != nullptr) {
             next->prev = nullptr;
 
-            if (first_element_->dataStartAddress)
-                free(first_element_->dataStartAddress);
-
-            free(first_element_);
+            freeElement(first_element_);
             first_element_ = next;
         }
         else {
-            if (first_element_->dataStartAddress)
-                free(first_element_->dataStartAddress);
-
-            free(first_element_);
+            freeElement(first_element_);
             first_element_ = nullptr;
             last_element_ = nullptr;
         }
@@ -174,17 +288,11 @@ JHC_INLINE size_t jhc::BufferQueue::popElementFromLast(void* pBuffer, size_t nBu
         if (prev) {
             prev->next = nullptr;
 
-            if (last_element_->dataStartAddress)
-                free(last_element_->dataStartAddress);
-
-            free(last_element_);
+            freeElement(last_element_);
             last_element_ = prev;
         }
         else {
-            if (last_element_->dataStartAddress)
-                free(last_element_->dataStartAddress);
-
-            free(last_element_);
+            freeElement(last_element_);
             first_element_ = nullptr;
             last_element_ = nullptr;
         }
@@ -193,6 +301,76 @@ JHC_INLINE size_t jhc::BufferQueue::popElementFromLast(void* pBuffer, size_t nBu
     return rvalue;
 }
 
+JHC_INLINE bool jhc::BufferQueue::waitForData(const std::chrono::milliseconds& timeout) {
+    std::unique_lock<std::recursive_mutex> lock(queue_mutex_);
+    return waitForData(lock, timeout);
+}
+
+// lock must own queue_mutex_ exactly once, otherwise waiting can't release it to the producers.
+JHC_INLINE bool jhc::BufferQueue::waitForData(std::unique_lock<std::recursive_mutex>& lock, const std::chrono::milliseconds& timeout) {
+    if (element_num_ > 0)
+        return true;
+
+    waiter_num_++;
+    data_cond_.wait_for(lock, timeout, [this]() { return element_num_ > 0 || closed_; });
+    waiter_num_--;
+
+    return element_num_ > 0;
+}
+
+JHC_INLINE size_t jhc::BufferQueue::popElementFromFront(void* pBuffer, size_t nBufferSize, const std::chrono::milliseconds& timeout) {
+    std::unique_lock<std::recursive_mutex> lock(queue_mutex_);
+    if (!waitForData(lock, timeout))
+        return 0;
+
+    return popElementFromFront(pBuffer, nBufferSize);
+}
+
+JHC_INLINE size_t jhc::BufferQueue::popElementsFromFront(void* pBuffer, size_t nBufferSize, size_t* pElementSizes, size_t nMaxElements) {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    if (pBuffer == nullptr || nBufferSize == 0 || pElementSizes == nullptr)
+        return 0;
+
+    size_t num = 0;
+    char* pB = (char*)pBuffer;
+    size_t remaind = nBufferSize;
+
+    while (num < nMaxElements && element_num_ > 0) {
+        if (first_element_->size > remaind && num > 0)
+            break;
+
+        const size_t size = popElementFromFront(pB, remaind);
+        pElementSizes[num++] = size;
+        pB += size;
+        remaind -= size;
+    }
+
+    return num;
+}
+
+JHC_INLINE size_t jhc::BufferQueue::popElementsFromFront(void* pBuffer,
+                                                         size_t nBufferSize,
+                                                         size_t* pElementSizes,
+                                                         size_t nMaxElements,
+                                                         const std::chrono::milliseconds& timeout) {
+    std::unique_lock<std::recursive_mutex> lock(queue_mutex_);
+    if (!waitForData(lock, timeout))
+        return 0;
+
+    return popElementsFromFront(pBuffer, nBufferSize, pElementSizes, nMaxElements);
+}
+
+JHC_INLINE void jhc::BufferQueue::close() {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    closed_ = true;
+    data_cond_.notify_all();
+}
+
+JHC_INLINE bool jhc::BufferQueue::isClosed() {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    return closed_;
+}
+
 JHC_INLINE size_t jhc::BufferQueue::getDataFromFrontElement(void* pBuffer, size_t nBufferSize) {
     std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
     size_t rvalue = 0;
@@ -246,11 +424,8 @@ JHC_INLINE size_t jhc::BufferQueue::clear() {
         QUEUE_ELEMENT* next = first_element_;
 
         while (next) {
-            if (next->dataStartAddress)
-                free(next->dataStartAddress);
-
             next = next->next;
-            free(elem);
+            freeElement(elem);
             elem = next;
         }
     }
@@ -431,4 +606,67 @@ JHC_INLINE size_t jhc::BufferQueue::toOneBufferWithNullEnding(char** ppBuf) {
     }
 
     return iBufSize + 1;
-}
\ No newline at end of file
+}
+JHC_INLINE size_t jhc::BufferQueue::getSegments(BUFFER_SEGMENT* pSegments, size_t nMaxSegments, size_t nMaxBytes) {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    if (pSegments == nullptr)
+        return 0;
+
+    size_t num = 0;
+    QUEUE_ELEMENT* p = first_element_;
+    while (p && num < nMaxSegments && nMaxBytes > 0) {
+        const size_t size = (p->size > nMaxBytes) ? nMaxBytes : p->size;
+        pSegments[num].data = p->dataReadAddress;
+        pSegments[num].size = size;
+        nMaxBytes -= size;
+        num++;
+
+        p = p->next;
+    }
+
+    return num;
+}
+
+#ifndef JHC_WIN
+JHC_INLINE size_t jhc::BufferQueue::getSegments(struct iovec* pIov, size_t nMaxIov, size_t nMaxBytes) {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    if (pIov == nullptr)
+        return 0;
+
+    size_t num = 0;
+    QUEUE_ELEMENT* p = first_element_;
+    while (p && num < nMaxIov && nMaxBytes > 0) {
+        const size_t size = (p->size > nMaxBytes) ? nMaxBytes : p->size;
+        pIov[num].iov_base = p->dataReadAddress;
+        pIov[num].iov_len = size;
+        nMaxBytes -= size;
+        num++;
+
+        p = p->next;
+    }
+
+    return num;
+}
+#endif
+
+JHC_INLINE size_t jhc::BufferQueue::consume(size_t nBytes) {
+    std::lock_guard<std::recursive_mutex> lg(queue_mutex_);
+    size_t consumed = 0;
+
+    while (nBytes > 0 && first_element_) {
+        if (first_element_->size > nBytes) {
+            // element isn't empty, but we have released some data from element.
+            first_element_->size -= nBytes;
+            first_element_->dataReadAddress = (char*)first_element_->dataReadAddress + nBytes;
+            total_data_size_ -= nBytes;
+            consumed += nBytes;
+            break;
+        }
+
+        nBytes -= first_element_->size;
+        consumed += first_element_->size;
+        popElementFromFront(nullptr, 0);
+    }
+
+    return consumed;
+}
@@ -0,0 +1,82 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../cpu_features.hpp"
+#endif
+
+#ifdef JHC_X86_INTRINSICS
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace jhc {
+namespace cpu_features_detail {
+#ifdef JHC_X86_INTRINSICS
+inline void CpuId(unsigned int leaf, unsigned int subLeaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int info[4] = {0};
+    __cpuidex(info, (int)leaf, (int)subLeaf);
+    for (int i = 0; i < 4; i++)
+        regs[i] = (unsigned int)info[i];
+#else
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0, the register states the OS saves on context switches.
+inline unsigned long long XGetBv() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax = 0, edx = 0;
+    __asm__ __volatile__("xgetbv"
+                         : "=a"(eax), "=d"(edx)
+                         : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+inline CpuFeatures Detect() {
+    CpuFeatures f;
+#ifdef JHC_X86_INTRINSICS
+    unsigned int regs[4] = {0};
+    CpuId(0, 0, regs);
+    const unsigned int maxLeaf = regs[0];
+    if (maxLeaf < 1)
+        return f;
+
+    CpuId(1, 0, regs);
+    const unsigned int ecx = regs[2];
+    const unsigned int edx = regs[3];
+    f.sse2 = (edx >> 26) & 1;
+    f.ssse3 = (ecx >> 9) & 1;
+    f.sse41 = (ecx >> 19) & 1;
+    f.sse42 = (ecx >> 20) & 1;
+    f.pclmul = (ecx >> 1) & 1;
+
+    // AVX needs the OS to save the YMM registers (OSXSAVE and XCR0 bits 1 and 2).
+    const bool osxsave = (ecx >> 27) & 1;
+    const bool ymmSaved = osxsave && (XGetBv() & 0x6) == 0x6;
+    f.avx = ((ecx >> 28) & 1) && ymmSaved;
+
+    if (maxLeaf >= 7) {
+        CpuId(7, 0, regs);
+        const unsigned int ebx = regs[1];
+        f.avx2 = f.avx && ((ebx >> 5) & 1);
+        f.bmi2 = (ebx >> 8) & 1;
+        f.sha = (ebx >> 29) & 1;
+    }
+#endif
+    return f;
+}
+}  // namespace cpu_features_detail
+}  // namespace jhc
+
+JHC_INLINE const jhc::CpuFeatures& jhc::CpuFeatures::Get() {
+    static const CpuFeatures features = cpu_features_detail::Detect();
+    return features;
+}
@@ -4,66 +4,366 @@
 #include "../crc32.hpp"
 #endif
 #include "jhc/file.hpp"
+#include "jhc/arch.hpp"
+#include "jhc/cpu_features.hpp"
+#include <string.h>
+#include <vector>
+#ifdef JHC_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
+namespace jhc {
+namespace crc32_detail {
+// Bit reflected polynomials.
+// CRC-32:  X^32+X^26+X^23+X^22+X^16+X^12+X^11+X^10+X^8+X^7+X^5+X^4+X^2+X+1
+// CRC-32C: X^32+X^28+X^27+X^26+X^25+X^23+X^22+X^20+X^19+X^18+X^14+X^13+X^11+X^10+X^9+X^8+X^6+1
+const uint32_t kCrc32Poly = 0xEDB88320;
+const uint32_t kCrc32cPoly = 0x82F63B78;
+
+// Bytes per stream of the 3-way interleaved crc32 instruction kernel.
+const size_t kCrc32cStride = 4096;
+
+// a * b modulo the polynomial, in the reflected representation where x^0 is 0x80000000.
+inline uint32_t MultModP(uint32_t a, uint32_t b, uint32_t poly) {
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+}
+
+struct Tables {
+    // table[0] is the classic byte-at-a-time table, table[k][b] is the CRC register of byte b followed by k zero bytes.
+    uint32_t table[16][256];
+    // x^(2^k) modulo the polynomial.
+    uint32_t x2n[68];
+    uint32_t poly;
+    // x^(8 * kCrc32cStride) modulo the polynomial, shifts a CRC register over one stream.
+    uint32_t strideShift;
+
+    explicit Tables(uint32_t polynomial) :
+        poly(polynomial) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+            table[0][i] = c;
+        }
+        for (int k = 1; k < 16; k++) {
+            for (int i = 0; i < 256; i++)
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+
+        x2n[0] = (uint32_t)1 << 30;  // x^1
+        for (int k = 1; k < 68; k++)
+            x2n[k] = MultModP(x2n[k - 1], x2n[k - 1], poly);
+        strideShift = X2nModP(kCrc32cStride, 3);
+    }
+
+    // x^(n * 2^k) modulo the polynomial.
+    uint32_t X2nModP(uint64_t n, unsigned int k) const {
+        uint32_t p = (uint32_t)1 << 31;  // x^0
+        while (n) {
+            if (n & 1)
+                p = MultModP(x2n[k], p, poly);
+            n >>= 1;
+            k++;
+        }
+        return p;
+    }
+};
+
+inline const Tables& Crc32Tables() {
+    static const Tables tables(kCrc32Poly);
+    return tables;
+}
+
+inline const Tables& Crc32cTables() {
+    static const Tables tables(kCrc32cPoly);
+    return tables;
+}
+
+inline uint32_t Load32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// All kernels work on the CRC register, i.e. the CRC before the final inversion.
+inline uint32_t Bytewise(uint32_t crc, const unsigned char* p, size_t n, const Tables& tb) {
+    const uint32_t* t = tb.table[0];
+    while (n--)
+        crc = (crc >> 8) ^ t[(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+inline uint32_t Slicing8(uint32_t crc, const unsigned char* p, size_t n, const Tables& tb) {
+#ifdef JHC_ARCH_LITTLE_ENDIAN
+    const uint32_t(*t)[256] = tb.table;
+    while (n >= 8) {
+        const uint32_t a = Load32(p) ^ crc;
+        const uint32_t b = Load32(p + 4);
+        crc = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24] ^
+              t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+        p += 8;
+        n -= 8;
+    }
+#endif
+    return Bytewise(crc, p, n, tb);
+}
+
+inline uint32_t Slicing16(uint32_t crc, const unsigned char* p, size_t n, const Tables& tb) {
+#ifdef JHC_ARCH_LITTLE_ENDIAN
+    const uint32_t(*t)[256] = tb.table;
+    while (n >= 16) {
+        const uint32_t a = Load32(p) ^ crc;
+        const uint32_t b = Load32(p + 4);
+        const uint32_t c = Load32(p + 8);
+        const uint32_t d = Load32(p + 12);
+        crc = t[15][a & 0xFF] ^ t[14][(a >> 8) & 0xFF] ^ t[13][(a >> 16) & 0xFF] ^ t[12][a >> 24] ^
+              t[11][b & 0xFF] ^ t[10][(b >> 8) & 0xFF] ^ t[9][(b >> 16) & 0xFF] ^ t[8][b >> 24] ^
+              t[7][c & 0xFF] ^ t[6][(c >> 8) & 0xFF] ^ t[5][(c >> 16) & 0xFF] ^ t[4][c >> 24] ^
+              t[3][d & 0xFF] ^ t[2][(d >> 8) & 0xFF] ^ t[1][(d >> 16) & 0xFF] ^ t[0][d >> 24];
+        p += 16;
+        n -= 16;
+    }
+#endif
+    return Slicing8(crc, p, n, tb);
+}
+
+#ifdef JHC_X86_INTRINSICS
+// Folds 4 x 128 bits in parallel with carry-less multiplications, then reduces to 32 bits (Barrett).
+// See "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction", Intel, 2009.
+// The constants are for the reflected CRC-32 polynomial. n must be a multiple of 16 and at least 64.
+JHC_TARGET("pclmul,sse4.1")
+inline uint32_t FoldPclmul(uint32_t crc, const unsigned char* p, size_t n) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    p += 64;
+    n -= 64;
+
+    while (n >= 64) {
+        const __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        const __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        const __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        const __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+        p += 64;
+        n -= 64;
+    }
+
+    // Fold the 4 lanes into one.
+    __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (n >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)p)), x5);
+        p += 16;
+        n -= 16;
+    }
+
+    // 128 to 64 bits.
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits.
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+JHC_TARGET("sse4.2")
+inline uint32_t HardwareCrc32cRun(uint32_t crc, const unsigned char* p, size_t n) {
+#ifdef JHC_ARCH_X86_64
+    uint64_t c = crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t)c;
+#endif
+    for (; n >= 4; p += 4, n -= 4)
+        crc = _mm_crc32_u32(crc, Load32(p));
+    while (n--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+
+// The crc32 instruction has a latency of 3 cycles and a throughput of 1, so large buffers are
+// split into 3 interleaved streams whose registers are merged with a shift by kCrc32cStride bytes.
+JHC_TARGET("sse4.2")
+inline uint32_t HardwareCrc32c(uint32_t crc, const unsigned char* p, size_t n, const Tables& tb) {
+#ifdef JHC_ARCH_X86_64
+    while (n >= 3 * kCrc32cStride) {
+        uint64_t a = crc, b = 0, c = 0;
+        const unsigned char* pb = p + kCrc32cStride;
+        const unsigned char* pc = p + 2 * kCrc32cStride;
+        for (size_t i = 0; i < kCrc32cStride; i += 8) {
+            uint64_t va, vb, vc;
+            memcpy(&va, p + i, 8);
+            memcpy(&vb, pb + i, 8);
+            memcpy(&vc, pc + i, 8);
+            a = _mm_crc32_u64(a, va);
+            b = _mm_crc32_u64(b, vb);
+            c = _mm_crc32_u64(c, vc);
+        }
+        crc = MultModP(tb.strideShift, (uint32_t)a, tb.poly) ^ (uint32_t)b;
+        crc = MultModP(tb.strideShift, crc, tb.poly) ^ (uint32_t)c;
+        p += 3 * kCrc32cStride;
+        n -= 3 * kCrc32cStride;
+    }
+#endif
+    return HardwareCrc32cRun(crc, p, n);
+}
+#endif
+
+inline uint32_t Combine(uint32_t crcA, uint32_t crcB, uint64_t sizeB, const Tables& tb) {
+    return MultModP(tb.X2nModP(sizeB, 3), crcA, tb.poly) ^ crcB;
+}
+
+inline std::string Hex(uint32_t crc) {
+    char szCRC[10] = {0};
+    snprintf(szCRC, sizeof(szCRC), "%08x", crc);
+    return szCRC;
+}
+
+inline std::array<uint8_t, 4> ToDigest(uint32_t crc) {
+    const std::array<uint8_t, 4> digest = {{(uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc}};
+    return digest;
+}
+
+inline uint32_t RunCrc32(uint32_t crc, const unsigned char* p, size_t n, CRC32::Kernel kernel) {
+    const Tables& tb = Crc32Tables();
+    switch (kernel) {
+        case CRC32::Kernel::Bytewise:
+            return Bytewise(crc, p, n, tb);
+        case CRC32::Kernel::Slicing8:
+            return Slicing8(crc, p, n, tb);
+        case CRC32::Kernel::Pclmul:
+#ifdef JHC_X86_INTRINSICS
+            if (n >= 64) {
+                const size_t bulk = n & ~(size_t)15;
+                crc = FoldPclmul(crc, p, bulk);
+                p += bulk;
+                n -= bulk;
+            }
+#endif
+            return Slicing16(crc, p, n, tb);
+        default:
+            return Slicing16(crc, p, n, tb);
+    }
+}
+
+inline uint32_t RunCrc32c(uint32_t crc, const unsigned char* p, size_t n, CRC32C::Kernel kernel) {
+    const Tables& tb = Crc32cTables();
+    switch (kernel) {
+        case CRC32C::Kernel::Bytewise:
+            return Bytewise(crc, p, n, tb);
+        case CRC32C::Kernel::Slicing8:
+            return Slicing8(crc, p, n, tb);
+        case CRC32C::Kernel::Sse42:
+#ifdef JHC_X86_INTRINSICS
+            return HardwareCrc32c(crc, p, n, tb);
+#endif
+        default:
+            return Slicing16(crc, p, n, tb);
+    }
+}
+}  // namespace crc32_detail
+}  // namespace jhc
 
 JHC_INLINE void jhc::CRC32::init() {
     ulCRC32_ = 0xFFFFFFFF;
 }
 
-JHC_INLINE void jhc::CRC32::update(const unsigned char* pData, uint32_t uSize) {
-    // CRC-32 table for the following polynominal:
-    // X^32+X^26+X^23+X^22+X^16+X^12+X^11+X^10+X^8+X^7+X^5+X^4+X^2+X+1
-    static uint32_t crc32tab[] = {
-        0x00000000L, 0x77073096L, 0xEE0E612CL, 0x990951BAL, 0x076DC419L, 0x706AF48FL, 0xE963A535L,
-        0x9E6495A3L, 0x0EDB8832L, 0x79DCB8A4L, 0xE0D5E91EL, 0x97D2D988L, 0x09B64C2BL, 0x7EB17CBDL,
-        0xE7B82D07L, 0x90BF1D91L, 0x1DB71064L, 0x6AB020F2L, 0xF3B97148L, 0x84BE41DEL, 0x1ADAD47DL,
-        0x6DDDE4EBL, 0xF4D4B551L, 0x83D385C7L, 0x136C9856L, 0x646BA8C0L, 0xFD62F97AL, 0x8A65C9ECL,
-        0x14015C4FL, 0x63066CD9L, 0xFA0F3D63L, 0x8D080DF5L, 0x3B6E20C8L, 0x4C69105EL, 0xD56041E4L,
-        0xA2677172L, 0x3C03E4D1L, 0x4B04D447L, 0xD20D85FDL, 0xA50AB56BL, 0x35B5A8FAL, 0x42B2986CL,
-        0xDBBBC9D6L, 0xACBCF940L, 0x32D86CE3L, 0x45DF5C75L, 0xDCD60DCFL, 0xABD13D59L, 0x26D930ACL,
-        0x51DE003AL, 0xC8D75180L, 0xBFD06116L, 0x21B4F4B5L, 0x56B3C423L, 0xCFBA9599L, 0xB8BDA50FL,
-        0x2802B89EL, 0x5F058808L, 0xC60CD9B2L, 0xB10BE924L, 0x2F6F7C87L, 0x58684C11L, 0xC1611DABL,
-        0xB6662D3DL, 0x76DC4190L, 0x01DB7106L, 0x98D220BCL, 0xEFD5102AL, 0x71B18589L, 0x06B6B51FL,
-        0x9FBFE4A5L, 0xE8B8D433L, 0x7807C9A2L, 0x0F00F934L, 0x9609A88EL, 0xE10E9818L, 0x7F6A0DBBL,
-        0x086D3D2DL, 0x91646C97L, 0xE6635C01L, 0x6B6B51F4L, 0x1C6C6162L, 0x856530D8L, 0xF262004EL,
-        0x6C0695EDL, 0x1B01A57BL, 0x8208F4C1L, 0xF50FC457L, 0x65B0D9C6L, 0x12B7E950L, 0x8BBEB8EAL,
-        0xFCB9887CL, 0x62DD1DDFL, 0x15DA2D49L, 0x8CD37CF3L, 0xFBD44C65L, 0x4DB26158L, 0x3AB551CEL,
-        0xA3BC0074L, 0xD4BB30E2L, 0x4ADFA541L, 0x3DD895D7L, 0xA4D1C46DL, 0xD3D6F4FBL, 0x4369E96AL,
-        0x346ED9FCL, 0xAD678846L, 0xDA60B8D0L, 0x44042D73L, 0x33031DE5L, 0xAA0A4C5FL, 0xDD0D7CC9L,
-        0x5005713CL, 0x270241AAL, 0xBE0B1010L, 0xC90C2086L, 0x5768B525L, 0x206F85B3L, 0xB966D409L,
-        0xCE61E49FL, 0x5EDEF90EL, 0x29D9C998L, 0xB0D09822L, 0xC7D7A8B4L, 0x59B33D17L, 0x2EB40D81L,
-        0xB7BD5C3BL, 0xC0BA6CADL, 0xEDB88320L, 0x9ABFB3B6L, 0x03B6E20CL, 0x74B1D29AL, 0xEAD54739L,
-        0x9DD277AFL, 0x04DB2615L, 0x73DC1683L, 0xE3630B12L, 0x94643B84L, 0x0D6D6A3EL, 0x7A6A5AA8L,
-        0xE40ECF0BL, 0x9309FF9DL, 0x0A00AE27L, 0x7D079EB1L, 0xF00F9344L, 0x8708A3D2L, 0x1E01F268L,
-        0x6906C2FEL, 0xF762575DL, 0x806567CBL, 0x196C3671L, 0x6E6B06E7L, 0xFED41B76L, 0x89D32BE0L,
-        0x10DA7A5AL, 0x67DD4ACCL, 0xF9B9DF6FL, 0x8EBEEFF9L, 0x17B7BE43L, 0x60B08ED5L, 0xD6D6A3E8L,
-        0xA1D1937EL, 0x38D8C2C4L, 0x4FDFF252L, 0xD1BB67F1L, 0xA6BC5767L, 0x3FB506DDL, 0x48B2364BL,
-        0xD80D2BDAL, 0xAF0A1B4CL, 0x36034AF6L, 0x41047A60L, 0xDF60EFC3L, 0xA867DF55L, 0x316E8EEFL,
-        0x4669BE79L, 0xCB61B38CL, 0xBC66831AL, 0x256FD2A0L, 0x5268E236L, 0xCC0C7795L, 0xBB0B4703L,
-        0x220216B9L, 0x5505262FL, 0xC5BA3BBEL, 0xB2BD0B28L, 0x2BB45A92L, 0x5CB36A04L, 0xC2D7FFA7L,
-        0xB5D0CF31L, 0x2CD99E8BL, 0x5BDEAE1DL, 0x9B64C2B0L, 0xEC63F226L, 0x756AA39CL, 0x026D930AL,
-        0x9C0906A9L, 0xEB0E363FL, 0x72076785L, 0x05005713L, 0x95BF4A82L, 0xE2B87A14L, 0x7BB12BAEL,
-        0x0CB61B38L, 0x92D28E9BL, 0xE5D5BE0DL, 0x7CDCEFB7L, 0x0BDBDF21L, 0x86D3D2D4L, 0xF1D4E242L,
-        0x68DDB3F8L, 0x1FDA836EL, 0x81BE16CDL, 0xF6B9265BL, 0x6FB077E1L, 0x18B74777L, 0x88085AE6L,
-        0xFF0F6A70L, 0x66063BCAL, 0x11010B5CL, 0x8F659EFFL, 0xF862AE69L, 0x616BFFD3L, 0x166CCF45L,
-        0xA00AE278L, 0xD70DD2EEL, 0x4E048354L, 0x3903B3C2L, 0xA7672661L, 0xD06016F7L, 0x4969474DL,
-        0x3E6E77DBL, 0xAED16A4AL, 0xD9D65ADCL, 0x40DF0B66L, 0x37D83BF0L, 0xA9BCAE53L, 0xDEBB9EC5L,
-        0x47B2CF7FL, 0x30B5FFE9L, 0xBDBDF21CL, 0xCABAC28AL, 0x53B39330L, 0x24B4A3A6L, 0xBAD03605L,
-        0xCDD70693L, 0x54DE5729L, 0x23D967BFL, 0xB3667A2EL, 0xC4614AB8L, 0x5D681B02L, 0x2A6F2B94L,
-        0xB40BBE37L, 0xC30C8EA1L, 0x5A05DF1BL, 0x2D02EF8DL};
-    uint32_t i = 0;
-
-    for (i = 0; i < uSize; i++)
-        ulCRC32_ = ((ulCRC32_) >> 8) ^ crc32tab[(pData[i]) ^ ((ulCRC32_)&0x000000FF)];
+JHC_INLINE void jhc::CRC32::update(const void* pData, size_t uSize) {
+    static const Kernel kernel = ActiveKernel();
+    ulCRC32_ = crc32_detail::RunCrc32(ulCRC32_, (const unsigned char*)pData, uSize, kernel);
 }
 
 JHC_INLINE void jhc::CRC32::finish() {
     ulCRC32_ = ~(ulCRC32_);
 }
 
+JHC_INLINE jhc::CRC32::Digest jhc::CRC32::finalize() {
+    finish();
+    return crc32_detail::ToDigest(ulCRC32_);
+}
+
 JHC_INLINE std::string jhc::CRC32::digest() {
-    char szCRC[10] = {0};
-    snprintf(szCRC, sizeof(szCRC), "%08x", ulCRC32_);
-    return szCRC;
+    return crc32_detail::Hex(ulCRC32_);
+}
+
+JHC_INLINE uint32_t jhc::CRC32::value() const {
+    return ulCRC32_;
+}
+
+JHC_INLINE uint32_t jhc::CRC32::Update(uint32_t crc, const void* data, size_t size) {
+    static const Kernel kernel = ActiveKernel();
+    return ~crc32_detail::RunCrc32(~crc, (const unsigned char*)data, size, kernel);
+}
+
+JHC_INLINE uint32_t jhc::CRC32::Update(uint32_t crc, const void* data, size_t size, Kernel kernel) {
+    return ~crc32_detail::RunCrc32(~crc, (const unsigned char*)data, size, kernel);
+}
+
+JHC_INLINE uint32_t jhc::CRC32::Combine(uint32_t crcA, uint32_t crcB, uint64_t sizeB) {
+    return crc32_detail::Combine(crcA, crcB, sizeB, crc32_detail::Crc32Tables());
+}
+
+JHC_INLINE bool jhc::CRC32::IsKernelSupported(Kernel kernel) {
+    if (kernel == Kernel::Pclmul) {
+#ifdef JHC_X86_INTRINSICS
+        return CpuFeatures::Get().pclmul && CpuFeatures::Get().sse41;
+#else
+        return false;
+#endif
+    }
+    return true;
+}
+
+JHC_INLINE jhc::CRC32::Kernel jhc::CRC32::ActiveKernel() {
+    return IsKernelSupported(Kernel::Pclmul) ? Kernel::Pclmul : Kernel::Slicing16;
 }
 
 JHC_INLINE std::string jhc::CRC32::GetFileCRC32(const jhc::fs::path& filePath) {
@@ -75,10 +375,10 @@ JHC_INLINE std::string jhc::CRC32::GetFileCRC32(const jhc::fs::path& filePath) {
     crc32.init();
 
     size_t dwReadBytes = 0;
-    unsigned char szData[1024] = {0};
+    std::vector<unsigned char> szData(1024 * 1024);
 
-    while ((dwReadBytes = file.readFrom(szData, 1024, -1)) > 0) {
-        crc32.update(szData, dwReadBytes);
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        crc32.update(szData.data(), dwReadBytes);
     }
     file.close();
 
@@ -88,20 +388,84 @@ JHC_INLINE std::string jhc::CRC32::GetFileCRC32(const jhc::fs::path& filePath) {
 }
 
 JHC_INLINE std::string jhc::CRC32::GetDataCRC32(const unsigned char* data, size_t dataSize) {
-    CRC32 crc32;
-    crc32.init();
+    return crc32_detail::Hex(Update(0, data, dataSize));
+}
+
+JHC_INLINE void jhc::CRC32C::init() {
+    ulCRC32_ = 0xFFFFFFFF;
+}
+
+JHC_INLINE void jhc::CRC32C::update(const void* pData, size_t uSize) {
+    static const Kernel kernel = ActiveKernel();
+    ulCRC32_ = crc32_detail::RunCrc32c(ulCRC32_, (const unsigned char*)pData, uSize, kernel);
+}
+
+JHC_INLINE void jhc::CRC32C::finish() {
+    ulCRC32_ = ~(ulCRC32_);
+}
+
+JHC_INLINE jhc::CRC32C::Digest jhc::CRC32C::finalize() {
+    finish();
+    return crc32_detail::ToDigest(ulCRC32_);
+}
+
+JHC_INLINE std::string jhc::CRC32C::digest() {
+    return crc32_detail::Hex(ulCRC32_);
+}
 
-    size_t offset = 0;
-    while (offset < dataSize) {
-        unsigned int needRead = 10240;
-        if (offset + needRead > dataSize)
-            needRead = dataSize - offset;
+JHC_INLINE uint32_t jhc::CRC32C::value() const {
+    return ulCRC32_;
+}
 
-        crc32.update(data + offset, needRead);
-        offset += needRead;
+JHC_INLINE std::string jhc::CRC32C::GetFileCRC32C(const jhc::fs::path& filePath) {
+    File file(filePath);
+    if (!file.open("rb"))
+        return "";
+
+    CRC32C crc32c;
+    crc32c.init();
+
+    size_t dwReadBytes = 0;
+    std::vector<unsigned char> szData(1024 * 1024);
+
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        crc32c.update(szData.data(), dwReadBytes);
     }
+    file.close();
 
-    crc32.finish();
+    crc32c.finish();
 
-    return crc32.digest();
+    return crc32c.digest();
+}
+
+JHC_INLINE std::string jhc::CRC32C::GetDataCRC32C(const unsigned char* data, size_t dataSize) {
+    return crc32_detail::Hex(Update(0, data, dataSize));
+}
+
+JHC_INLINE uint32_t jhc::CRC32C::Update(uint32_t crc, const void* data, size_t size) {
+    static const Kernel kernel = ActiveKernel();
+    return ~crc32_detail::RunCrc32c(~crc, (const unsigned char*)data, size, kernel);
+}
+
+JHC_INLINE uint32_t jhc::CRC32C::Update(uint32_t crc, const void* data, size_t size, Kernel kernel) {
+    return ~crc32_detail::RunCrc32c(~crc, (const unsigned char*)data, size, kernel);
+}
+
+JHC_INLINE uint32_t jhc::CRC32C::Combine(uint32_t crcA, uint32_t crcB, uint64_t sizeB) {
+    return crc32_detail::Combine(crcA, crcB, sizeB, crc32_detail::Crc32cTables());
+}
+
+JHC_INLINE bool jhc::CRC32C::IsKernelSupported(Kernel kernel) {
+    if (kernel == Kernel::Sse42) {
+#ifdef JHC_X86_INTRINSICS
+        return CpuFeatures::Get().sse42;
+#else
+        return false;
+#endif
+    }
+    return true;
+}
+
+JHC_INLINE jhc::CRC32C::Kernel jhc::CRC32C::ActiveKernel() {
+    return IsKernelSupported(Kernel::Sse42) ? Kernel::Sse42 : Kernel::Slicing16;
 }
@@ -18,10 +18,245 @@
 #include <strsafe.h>
 #include <Shlwapi.h>
 #else
+#include <errno.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #endif  // !JHC_WIN
+#include <algorithm>
+
+namespace jhc {
+namespace file_detail {
+// Largest transfer of one system call.
+const size_t kMaxIoSize = 1024 * 1024 * 1024;
+
+// One positional read or write. Returns the bytes transferred, 0 at the end of the file, -1 on error.
+#ifdef JHC_WIN
+inline int64_t TransferAt(void* handle, bool write, void* buffer, size_t size, int64_t offset) {
+    struct IoEvent {
+        HANDLE event = CreateEventW(NULL, TRUE, FALSE, NULL);
+        ~IoEvent() {
+            if (event)
+                CloseHandle(event);
+        }
+    };
+    static thread_local IoEvent ioEvent;
+    if (!handle || !ioEvent.event)
+        return -1;
+
+    OVERLAPPED ov = {};
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)((uint64_t)offset >> 32);
+    ov.hEvent = ioEvent.event;
+    const DWORD n = (DWORD)std::min(size, kMaxIoSize);
+    const BOOL ok = write ? WriteFile((HANDLE)handle, buffer, n, NULL, &ov) : ReadFile((HANDLE)handle, buffer, n, NULL, &ov);
+    DWORD transferred = 0;
+    if ((ok || GetLastError() == ERROR_IO_PENDING) && GetOverlappedResult((HANDLE)handle, &ov, &transferred, TRUE))
+        return transferred;
+    return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+}
+#else
+inline int64_t TransferAt(int fd, bool write, void* buffer, size_t size, int64_t offset) {
+    if (fd < 0)
+        return -1;
+    const size_t n = std::min(size, kMaxIoSize);
+    for (;;) {
+        const ssize_t r = write ? pwrite64(fd, buffer, n, offset) : pread64(fd, buffer, n, offset);
+        if (r >= 0 || errno != EINTR)
+            return r;
+    }
+}
+
+inline int64_t TransferAtV(int fd, bool write, const struct iovec* iov, int count, int64_t offset) {
+    if (fd < 0)
+        return -1;
+    for (;;) {
+        const ssize_t r = write ? pwritev64(fd, iov, count, offset) : preadv64(fd, iov, count, offset);
+        if (r >= 0 || errno != EINTR)
+            return r;
+    }
+}
+#endif
+
+// Transfers the buffers one after the other from offset, until all are done, the end of the file or an error.
+template <class Buffer, class Handle>
+size_t TransferBuffers(Handle handle, bool write, const Buffer* buffers, size_t count, int64_t offset) {
+    if (!buffers || offset < 0)
+        return 0;
+
+    size_t total = 0;
+    size_t index = 0;
+    size_t done = 0;  // bytes of buffers[index] already transferred
+    for (;;) {
+        while (index < count && done == buffers[index].size) {
+            index++;
+            done = 0;
+        }
+        if (index == count)
+            break;
+
+#ifdef JHC_WIN
+        const int64_t r = TransferAt(handle, write, (char*)buffers[index].data + done, buffers[index].size - done, offset + total);
+#else
+        // Up to 64 buffers per call, the part of buffers[index] already transferred left out.
+        struct iovec iov[64];
+        int n = 0;
+        size_t bytes = 0;
+        for (size_t i = index; i < count && n < 64 && bytes < kMaxIoSize; i++) {
+            const size_t skip = (i == index) ? done : 0;
+            const size_t size = std::min(buffers[i].size - skip, kMaxIoSize - bytes);
+            if (size == 0)
+                continue;
+            iov[n].iov_base = (char*)buffers[i].data + skip;
+            iov[n].iov_len = size;
+            bytes += size;
+            n++;
+        }
+        const int64_t r = TransferAtV(handle, write, iov, n, offset + (int64_t)total);
+#endif
+        if (r <= 0)
+            break;
+
+        total += (size_t)r;
+        size_t left = (size_t)r;
+        while (left > 0) {
+            const size_t avail = buffers[index].size - done;
+            if (left < avail) {
+                done += left;
+                break;
+            }
+            left -= avail;
+            index++;
+            done = 0;
+        }
+    }
+    return total;
+}
+}  // namespace file_detail
+}  // namespace jhc
+
+JHC_INLINE jhc::FileMapping::FileMapping(FileMapping&& other) noexcept {
+    *this = std::move(other);
+}
+
+JHC_INLINE jhc::FileMapping& jhc::FileMapping::operator=(FileMapping&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        data_ = other.data_;
+        size_ = other.size_;
+        base_ = other.base_;
+        mappedSize_ = other.mappedSize_;
+        valid_ = other.valid_;
+        writable_ = other.writable_;
+#ifdef JHC_WIN
+        mappingHandle_ = other.mappingHandle_;
+        fileHandle_ = other.fileHandle_;
+        other.mappingHandle_ = nullptr;
+        other.fileHandle_ = nullptr;
+#endif
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.base_ = nullptr;
+        other.mappedSize_ = 0;
+        other.valid_ = false;
+        other.writable_ = false;
+    }
+    return *this;
+}
+
+JHC_INLINE jhc::FileMapping::~FileMapping() {
+    unmap();
+}
+
+JHC_INLINE bool jhc::FileMapping::advise(Advice advice, size_t offset, size_t length) {
+    if (!valid_)
+        return false;
+    if (offset >= size_)
+        return true;
+    length = std::min(length, size_ - offset);
+
+#ifdef JHC_WIN
+    // Only WillNeed has an equivalent, the other hints are left to the system.
+    if (advice != Advice::WillNeed)
+        return true;
+
+    struct MemoryRange {
+        PVOID VirtualAddress;
+        SIZE_T NumberOfBytes;
+    };
+    typedef BOOL(WINAPI * PrefetchVirtualMemoryFn)(HANDLE, ULONG_PTR, MemoryRange*, ULONG);
+    static const PrefetchVirtualMemoryFn prefetch =
+        (PrefetchVirtualMemoryFn)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory");
+    if (!prefetch)
+        return false;
+
+    MemoryRange range = {data_ + offset, length};
+    return prefetch(GetCurrentProcess(), 1, &range, 0) != FALSE;
+#else
+    int flag = MADV_NORMAL;
+    switch (advice) {
+        case Advice::Sequential:
+            flag = MADV_SEQUENTIAL;
+            break;
+        case Advice::Random:
+            flag = MADV_RANDOM;
+            break;
+        case Advice::WillNeed:
+            flag = MADV_WILLNEED;
+            break;
+        case Advice::DontNeed:
+            flag = MADV_DONTNEED;
+            break;
+        default:
+            break;
+    }
+
+    // madvise wants a page aligned address.
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = ((uintptr_t)(data_ + offset)) / page * page;
+    const uintptr_t end = (uintptr_t)(data_ + offset + length);
+    return madvise((void*)begin, end - begin, flag) == 0;
+#endif
+}
+
+JHC_INLINE bool jhc::FileMapping::flush(bool async) {
+    if (!valid_ || !writable_)
+        return false;
+    if (!base_)
+        return true;
+
+#ifdef JHC_WIN
+    if (!FlushViewOfFile(base_, mappedSize_))
+        return false;
+    return async || FlushFileBuffers((HANDLE)fileHandle_) != FALSE;
+#else
+    return msync(base_, mappedSize_, async ? MS_ASYNC : MS_SYNC) == 0;
+#endif
+}
+
+JHC_INLINE void jhc::FileMapping::unmap() {
+#ifdef JHC_WIN
+    if (base_)
+        UnmapViewOfFile(base_);
+    if (mappingHandle_)
+        CloseHandle((HANDLE)mappingHandle_);
+    if (fileHandle_)
+        CloseHandle((HANDLE)fileHandle_);
+    mappingHandle_ = nullptr;
+    fileHandle_ = nullptr;
+#else
+    if (base_)
+        munmap(base_, mappedSize_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    base_ = nullptr;
+    mappedSize_ = 0;
+    valid_ = false;
+    writable_ = false;
+}
 
 JHC_INLINE jhc::File::File(const fs::path& path) :
     path_(path) {
@@ -54,8 +289,25 @@ JHC_INLINE bool jhc::File::open(const jhc::fs::path& openMode) {
 
 #ifdef JHC_WIN
     _wfopen_s(&f_, path_.wstring().c_str(), openMode.wstring().c_str());
+    if (f_) {
+        // A second, overlapped handle: positional I/O on the synchronous handle of the FILE would be
+        // serialized by the system.
+        const std::wstring mode = openMode.wstring();
+        DWORD access = GENERIC_READ;
+        if (mode[0] == L'a')
+            access |= FILE_GENERIC_WRITE & ~FILE_WRITE_DATA;  // append only: the system writes at the end whatever the offset
+        else if (mode.find_first_of(L"w+") != std::wstring::npos)
+            access |= GENERIC_WRITE;
+        HANDLE handle = ReOpenFile((HANDLE)_get_osfhandle(_fileno(f_)),
+                                   access,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                   FILE_FLAG_OVERLAPPED);
+        handle_ = (handle == INVALID_HANDLE_VALUE) ? nullptr : handle;
+    }
 #else
     f_ = fopen(path_.u8string().c_str(), openMode.u8string().c_str());
+    if (f_)
+        fd_ = fileno(f_);
 #endif
 
     return (f_ != nullptr);
@@ -65,8 +317,17 @@ JHC_INLINE bool jhc::File::close() {
     std::lock_guard<std::recursive_mutex> lg(mutex_);
     if (f_) {
         const int err = fclose(f_);
-        if (err == 0)
+        if (err == 0) {
             f_ = nullptr;
+            writePending_ = false;
+#ifdef JHC_WIN
+            if (handle_)
+                CloseHandle((HANDLE)handle_);
+            handle_ = nullptr;
+#else
+            fd_ = -1;
+#endif
+        }
         return (err == 0);
     }
     return false;
@@ -74,11 +335,29 @@ JHC_INLINE bool jhc::File::close() {
 
 JHC_INLINE bool jhc::File::flush() {
     std::lock_guard<std::recursive_mutex> lg(mutex_);
-    if (f_)
-        return (fflush(f_) == 0);
+    if (f_) {
+        if (fflush(f_) != 0)
+            return false;
+        writePending_ = false;
+        return true;
+    }
     return false;
 }
 
+JHC_INLINE bool jhc::File::sync() {
+    if (!flush())
+        return false;
+#ifdef JHC_WIN
+    return FlushFileBuffers(handle_ ? (HANDLE)handle_ : (HANDLE)_get_osfhandle(_fileno(f_))) != 0;
+#else
+    int err;
+    do {
+        err = fdatasync(fd_);
+    } while (err != 0 && errno == EINTR);
+    return (err == 0);
+#endif
+}
+
 JHC_INLINE bool jhc::File::exist() const {
     if (path_.empty())
         return false;
@@ -105,31 +384,108 @@ JHC_INLINE int64_t jhc::File::fileSize() {
     if (!f_)
         return -1;
 
-#ifdef JHC_WIN
-    const int64_t curPos = _ftelli64(f_);
-    if (curPos == -1L)
+    // The size of the descriptor, which does not include what is still in the FILE buffer.
+    if (writePending_ && !flush())
         return -1;
 
-    if (_fseeki64(f_, 0L, SEEK_END) != 0)
+#ifdef JHC_WIN
+    return _filelengthi64(_fileno(f_));
+#else
+    struct stat64 st;
+    if (fstat64(fileno(f_), &st) != 0)
         return -1;
+    return st.st_size;
+#endif
+}
 
-    const int64_t ret = _ftelli64(f_);
-    _fseeki64(f_, curPos, SEEK_SET);
+JHC_INLINE jhc::FileMapping jhc::File::map(MapMode mode, int64_t offset, int64_t length) {
+    std::lock_guard<std::recursive_mutex> lg(mutex_);
+    FileMapping mapping;
+    if (!f_ || offset < 0 || length < -1)
+        return mapping;
+
+    const int64_t size = fileSize();
+    if (size < 0)
+        return mapping;
+
+    const bool writable = (mode == MapMode::ReadWrite);
+    if (!writable && offset > size)
+        return mapping;
+    if (length == -1)
+        length = offset < size ? size - offset : 0;
+    if (!writable)
+        length = std::min(length, size - offset);
+    if ((uint64_t)length > SIZE_MAX - 65536)
+        return mapping;
+
+    mapping.valid_ = true;
+    mapping.writable_ = writable;
+    if (length == 0)
+        return mapping;
+
+    const int64_t end = offset + length;
+#ifdef JHC_WIN
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(f_));
+    if (file == INVALID_HANDLE_VALUE) {
+        mapping.valid_ = false;
+        return mapping;
+    }
 
-    return ret;
+    // A maximum size above the file size grows the file.
+    const uint64_t maxSize = writable && end > size ? (uint64_t)end : 0;
+    HANDLE handle = CreateFileMappingW(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(maxSize >> 32), (DWORD)maxSize, NULL);
+    if (!handle) {
+        mapping.valid_ = false;
+        return mapping;
+    }
+    mapping.mappingHandle_ = handle;
+
+    // Views start on the allocation granularity.
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    const int64_t aligned = offset - offset % si.dwAllocationGranularity;
+    const size_t mappedSize = (size_t)(end - aligned);
+    void* base = MapViewOfFile(handle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, (DWORD)((uint64_t)aligned >> 32), (DWORD)aligned, mappedSize);
+    if (!base) {
+        mapping.unmap();
+        return mapping;
+    }
+
+    if (writable) {
+        HANDLE dup = NULL;
+        if (DuplicateHandle(GetCurrentProcess(), file, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS))
+            mapping.fileHandle_ = dup;
+    }
 #else
-    const int64_t curPos = ftello64(f_);
-    if (curPos == -1L)
-        return -1;
+    const int fd = fileno(f_);
+    if (writable && end > size && ftruncate64(fd, end) != 0) {
+        mapping.valid_ = false;
+        return mapping;
+    }
 
-    if (fseeko64(f_, 0L, SEEK_END) != 0)
-        return -1;
+    // Views start on a page.
+    const int64_t page = (int64_t)sysconf(_SC_PAGESIZE);
+    const int64_t aligned = offset - offset % page;
+    const size_t mappedSize = (size_t)(end - aligned);
+    void* base = mmap64(nullptr, mappedSize, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, aligned);
+    if (base == MAP_FAILED) {
+        mapping.valid_ = false;
+        return mapping;
+    }
+#endif
 
-    const int64_t ret = ftello64(f_);
-    fseeko64(f_, curPos, SEEK_SET);
+    mapping.base_ = base;
+    mapping.mappedSize_ = mappedSize;
+    mapping.data_ = (unsigned char*)base + (offset - aligned);
+    mapping.size_ = (size_t)length;
+    return mapping;
+}
 
-    return ret;
-#endif
+JHC_INLINE jhc::FileMapping jhc::File::MapFile(const fs::path& filePath, MapMode mode) {
+    File file(filePath);
+    if (!file.open(mode == MapMode::ReadWrite ? "r+b" : "rb"))
+        return FileMapping();
+    return file.map(mode);
 }
 
 // Must be call open(...) first!
@@ -216,9 +572,47 @@ JHC_INLINE size_t jhc::File::writeFrom(const void* buffer, size_t needWrite, int
     }
 
     const size_t written = fwrite(buffer, 1, needWrite, f_);
+    if (written > 0)
+        writePending_ = true;
     return written;
 }
 
+JHC_INLINE size_t jhc::File::readAt(void* buffer, size_t size, int64_t offset) {
+    const ReadBuffer one = {buffer, size};
+    return readAt(&one, 1, offset);
+}
+
+JHC_INLINE size_t jhc::File::writeAt(const void* buffer, size_t size, int64_t offset) {
+    const WriteBuffer one = {buffer, size};
+    return writeAt(&one, 1, offset);
+}
+
+JHC_INLINE size_t jhc::File::readAt(const ReadBuffer* buffers, size_t count, int64_t offset) {
+#ifdef JHC_WIN
+    return file_detail::TransferBuffers(handle_, false, buffers, count, offset);
+#else
+    return file_detail::TransferBuffers(fd_, false, buffers, count, offset);
+#endif
+}
+
+JHC_INLINE size_t jhc::File::writeAt(const WriteBuffer* buffers, size_t count, int64_t offset) {
+#ifdef JHC_WIN
+    return file_detail::TransferBuffers(handle_, true, buffers, count, offset);
+#else
+    return file_detail::TransferBuffers(fd_, true, buffers, count, offset);
+#endif
+}
+
+#ifdef JHC_WIN
+JHC_INLINE void* jhc::File::nativeHandle() const {
+    return handle_;
+}
+#else
+JHC_INLINE int jhc::File::nativeHandle() const {
+    return fd_;
+}
+#endif
+
 JHC_INLINE size_t jhc::File::readAll(void** buffer) {
     std::lock_guard<std::recursive_mutex> lg(mutex_);
     if (!f_ || !buffer)
@@ -0,0 +1,225 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../file_copy.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "jhc/file.hpp"
+#include "jhc/thread_pool.hpp"
+#ifdef JHC_WIN
+#ifndef _INC_WINDOWS
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#endif
+#endif
+#ifdef JHC_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+namespace jhc {
+namespace file_copy_detail {
+// Largest transfer of one system call.
+const size_t kMaxIoSize = 1024 * 1024 * 1024;
+
+const size_t kChunkSize = 1024 * 1024;
+
+#ifdef JHC_LINUX
+// Copies size bytes from the beginning of in with copy_file_range (sendfile when sendfile is set).
+// copied receives the bytes copied. When the call is not supported for these files nothing is copied
+// and false is returned: both calls return 0 at once on file systems that cannot do it (procfs, sysfs,
+// some FUSE mounts), which only means "the file got shorter" after some data was copied.
+inline bool KernelCopy(int in, int out, int64_t size, bool sendfile, int64_t& copied) {
+    copied = 0;
+    loff_t inOffset = 0;
+    loff_t outOffset = 0;
+    off64_t offset = 0;
+    while (copied < size) {
+        const size_t n = (size_t)std::min<int64_t>(size - copied, (int64_t)kMaxIoSize);
+        ssize_t r;
+        if (sendfile) {
+            r = sendfile64(out, in, &offset, n);
+        }
+        else {
+#ifdef __NR_copy_file_range
+            r = syscall(__NR_copy_file_range, in, &inOffset, out, &outOffset, n, 0);
+#else
+            (void)inOffset;
+            (void)outOffset;
+            errno = ENOSYS;
+            r = -1;
+#endif
+        }
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return false;
+        if (r == 0) {
+            if (copied == 0) {
+                errno = EOPNOTSUPP;
+                return false;
+            }
+            break;  // the file got shorter
+        }
+        copied += r;
+    }
+    return true;
+}
+#endif
+}  // namespace file_copy_detail
+}  // namespace jhc
+
+JHC_INLINE bool jhc::FileCopy::Copy(const fs::path& from, const fs::path& to, Method* method) {
+    return CopyFileData(from, to, nullptr, method);
+}
+
+JHC_INLINE bool jhc::FileCopy::CopyWith(const fs::path& from, const fs::path& to, Method method) {
+    return CopyFileData(from, to, &method, nullptr);
+}
+
+JHC_INLINE bool jhc::FileCopy::CopyFileData(const fs::path& from, const fs::path& to, const Method* only, Method* used) {
+    std::error_code ec;
+    if (fs::equivalent(from, to, ec))
+        return false;
+
+    auto allowed = [only](Method m) { return !only || *only == m; };
+    auto done = [used](Method m) {
+        if (used)
+            *used = m;
+        return true;
+    };
+
+#ifdef JHC_WIN
+    if (allowed(Method::System)) {
+        if (CopyFileExW(from.wstring().c_str(), to.wstring().c_str(), NULL, NULL, NULL, 0))
+            return done(Method::System);
+        if (only)
+            return false;
+    }
+#endif
+
+    File in(from);
+    if (!in.open("rb"))
+        return false;
+    const int64_t size = in.fileSize();
+    if (size < 0)
+        return false;
+
+    File out(to);
+    if (!out.open("wb"))
+        return false;
+
+#ifdef JHC_LINUX
+    const int inFd = in.nativeHandle();
+    const int outFd = out.nativeHandle();
+    struct stat64 st;
+    if (fstat64(inFd, &st) == 0)
+        fchmod(outFd, st.st_mode & 07777);
+
+    if (allowed(Method::Clone)) {
+#ifdef FICLONE
+        if (ioctl(outFd, FICLONE, inFd) == 0)
+            return out.close() && done(Method::Clone);
+#endif
+        if (only)
+            return false;
+    }
+
+    // A method that fails before copying anything is not supported here, the next one is tried.
+    // The kernel methods copy st_size bytes, which is 0 for pseudo files (procfs) that do have data:
+    // an empty size is left to the chunked copy, which reads to the end of the file.
+    const Method kernelMethods[] = {Method::CopyFileRange, Method::Sendfile};
+    for (Method m : kernelMethods) {
+        if (!allowed(m))
+            continue;
+        if (size == 0) {
+            if (only)
+                return false;
+            continue;
+        }
+        int64_t copied = 0;
+        if (file_copy_detail::KernelCopy(inFd, outFd, size, m == Method::Sendfile, copied))
+            return out.close() && done(m);
+        if (copied > 0 || only)
+            return false;
+    }
+
+    posix_fadvise(inFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    if (!allowed(Method::Chunked))
+        return false;
+
+    std::vector<unsigned char> buffer(file_copy_detail::kChunkSize);
+    int64_t offset = 0;
+    for (;;) {
+        // Up to the end of the file rather than up to size, which may be wrong (procfs, sysfs).
+        const size_t n = in.readAt(buffer.data(), buffer.size(), offset);
+        if (n == 0)
+            break;
+        if (out.writeAt(buffer.data(), n, offset) != n)
+            return false;
+        offset += (int64_t)n;
+    }
+    return out.close() && done(Method::Chunked);
+}
+
+JHC_INLINE bool jhc::FileCopy::CopyDirectory(const fs::path& from, const fs::path& to, size_t threads) {
+    std::error_code ec;
+    if (!fs::is_directory(from, ec))
+        return false;
+    fs::create_directories(to, ec);
+    if (!fs::is_directory(to, ec))
+        return false;
+
+    bool result = true;
+    std::vector<std::pair<uintmax_t, fs::path>> files;  // size, path relative to from
+    for (fs::recursive_directory_iterator it(from, ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path relative = it->path().lexically_relative(from);
+        const fs::path target = to / relative;
+        std::error_code ec2;
+        if (it->is_symlink(ec2)) {
+            fs::remove(target, ec2);
+            fs::copy_symlink(it->path(), target, ec2);
+            result = result && !ec2;
+        }
+        else if (it->is_directory(ec2)) {
+            fs::create_directories(target, ec2);
+            result = result && !ec2;
+        }
+        else if (it->is_regular_file(ec2)) {
+            files.emplace_back(it->file_size(ec2), relative);
+        }
+    }
+    if (ec)
+        return false;
+
+    std::sort(files.begin(), files.end(), [](const std::pair<uintmax_t, fs::path>& a, const std::pair<uintmax_t, fs::path>& b) { return a.first > b.first; });
+
+    if (threads == 0)
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<size_t>(files.size(), 1));
+
+    std::atomic<bool> copied(true);
+    ThreadPool pool(threads);
+    pool.parallelFor<size_t>(0, files.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!Copy(from / files[i].second, to / files[i].second))
+                copied = false;
+        }
+    });
+    return result && copied;
+}
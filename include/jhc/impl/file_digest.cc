@@ -0,0 +1,294 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../file_digest.hpp"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef JHC_WIN
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#endif
+#include "jhc/macros.hpp"
+#include "jhc/file.hpp"
+#include "jhc/async_file.hpp"
+#include "jhc/crc32.hpp"
+#include "jhc/md5.hpp"
+#include "jhc/sha1.hpp"
+#include "jhc/sha256.hpp"
+#include "jhc/sha512.hpp"
+#include "jhc/thread_pool.hpp"
+
+namespace jhc {
+namespace file_digest_detail {
+// Alignment of the buffers, offsets and lengths of the reads, as O_DIRECT requires.
+const size_t kAlignment = 4096;
+// Caps the memory of the chunk buffers.
+const size_t kMaxChunkSize = 256 * 1024 * 1024;
+// Smallest part of a chunk whose CRC is computed on its own thread.
+const size_t kMinCrcPart = 1024 * 1024;
+
+// A buffer whose data is aligned to kAlignment.
+class AlignedBuffer {
+   public:
+    JHC_DISALLOW_COPY_MOVE(AlignedBuffer);
+
+    AlignedBuffer() = default;
+
+    ~AlignedBuffer() {
+#ifdef JHC_WIN
+        _aligned_free(data_);
+#else
+        free(data_);
+#endif
+    }
+
+    bool allocate(size_t size) {
+#ifdef JHC_WIN
+        data_ = static_cast<unsigned char*>(_aligned_malloc(size, kAlignment));
+        return data_ != nullptr;
+#else
+        void* p = nullptr;
+        if (posix_memalign(&p, kAlignment, size) != 0)
+            return false;
+        data_ = static_cast<unsigned char*>(p);
+        return true;
+#endif
+    }
+
+    unsigned char* data() { return data_; }
+
+   private:
+    unsigned char* data_ = nullptr;
+};
+
+// Used by Compute() when it is given a number of threads.
+inline ThreadPool& SharedPool() {
+    static ThreadPool pool(std::max<size_t>(1, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+struct Hashers {
+    unsigned int algorithms = 0;
+    uint32_t crc32 = 0;
+    uint32_t crc32c = 0;
+    MD5 md5;
+    SHA1 sha1;
+    SHA256 sha256;
+    SHA512 sha512;
+
+    explicit Hashers(unsigned int algs) :
+        algorithms(algs) {
+    }
+
+    // Runs a sequential hash over a chunk, alg is a single ALG_* flag.
+    void updateSequential(unsigned int alg, const unsigned char* data, size_t size) {
+        switch (alg) {
+            case FileDigest::ALG_MD5:
+                md5.update(data, size);
+                break;
+            case FileDigest::ALG_SHA1:
+                sha1.update(data, size);
+                break;
+            case FileDigest::ALG_SHA256:
+                sha256.update(data, size);
+                break;
+            case FileDigest::ALG_SHA512:
+                sha512.update(data, size);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void report(FileDigest::Result& result) {
+        char hex[9] = {0};
+        if (algorithms & FileDigest::ALG_CRC32) {
+            snprintf(hex, sizeof(hex), "%08x", crc32);
+            result.crc32 = hex;
+        }
+        if (algorithms & FileDigest::ALG_CRC32C) {
+            snprintf(hex, sizeof(hex), "%08x", crc32c);
+            result.crc32c = hex;
+        }
+        if (algorithms & FileDigest::ALG_MD5)
+            result.md5 = DigestToHex(md5.finalize());
+        if (algorithms & FileDigest::ALG_SHA1)
+            result.sha1 = DigestToHex(sha1.finalize());
+        if (algorithms & FileDigest::ALG_SHA256)
+            result.sha256 = DigestToHex(sha256.finalize());
+        if (algorithms & FileDigest::ALG_SHA512)
+            result.sha512 = DigestToHex(sha512.finalize());
+    }
+};
+
+// One unit of work on a chunk: a whole sequential hash, or one part of a CRC.
+struct Task {
+    unsigned int alg;
+    size_t offset;
+    size_t size;
+    uint32_t crc;
+};
+
+// Splits the hashing of a chunk into tasks that can run concurrently.
+inline void PlanChunk(unsigned int algorithms, size_t size, size_t threads, std::vector<Task>& tasks) {
+    tasks.clear();
+    const unsigned int sequential[] = {FileDigest::ALG_MD5, FileDigest::ALG_SHA1, FileDigest::ALG_SHA256, FileDigest::ALG_SHA512};
+    for (unsigned int alg : sequential) {
+        if (algorithms & alg)
+            tasks.push_back(Task{alg, 0, size, 0});
+    }
+
+    // The CRCs get the threads the sequential hashes leave.
+    size_t parts = threads > tasks.size() ? threads - tasks.size() : 1;
+    parts = std::max<size_t>(1, std::min(parts, size / kMinCrcPart));
+    const size_t partSize = (size + parts - 1) / parts;
+    const unsigned int crcs[] = {FileDigest::ALG_CRC32, FileDigest::ALG_CRC32C};
+    for (unsigned int alg : crcs) {
+        if (!(algorithms & alg))
+            continue;
+        for (size_t offset = 0; offset < size; offset += partSize)
+            tasks.push_back(Task{alg, offset, std::min(partSize, size - offset), 0});
+    }
+}
+
+inline void RunTask(Task& task, Hashers& hashers, const unsigned char* data) {
+    if (task.alg == FileDigest::ALG_CRC32)
+        task.crc = CRC32::Update(0, data + task.offset, task.size);
+    else if (task.alg == FileDigest::ALG_CRC32C)
+        task.crc = CRC32C::Update(0, data + task.offset, task.size);
+    else
+        hashers.updateSequential(task.alg, data + task.offset, task.size);
+}
+
+// Merges the CRC parts of a chunk, in order, into the running CRCs.
+inline void CombineChunk(const std::vector<Task>& tasks, Hashers& hashers) {
+    for (const Task& task : tasks) {
+        if (task.alg == FileDigest::ALG_CRC32)
+            hashers.crc32 = CRC32::Combine(hashers.crc32, task.crc, task.size);
+        else if (task.alg == FileDigest::ALG_CRC32C)
+            hashers.crc32c = CRC32C::Combine(hashers.crc32c, task.crc, task.size);
+    }
+}
+}  // namespace file_digest_detail
+}  // namespace jhc
+
+JHC_INLINE bool jhc::FileDigest::Compute(const fs::path& filePath,
+                                         unsigned int algorithms,
+                                         Result& result,
+                                         size_t threads,
+                                         size_t chunkSize,
+                                         bool direct) {
+    if (threads == 0)
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    ThreadPool* pool = threads > 1 ? &file_digest_detail::SharedPool() : nullptr;
+    return Run(filePath, algorithms, result, pool, threads, chunkSize, direct);
+}
+
+JHC_INLINE bool jhc::FileDigest::Compute(const fs::path& filePath,
+                                         unsigned int algorithms,
+                                         Result& result,
+                                         ThreadPool& pool,
+                                         size_t chunkSize,
+                                         bool direct) {
+    return Run(filePath, algorithms, result, &pool, pool.threadCount() + 1, chunkSize, direct);
+}
+
+JHC_INLINE bool jhc::FileDigest::Run(const fs::path& filePath,
+                                     unsigned int algorithms,
+                                     Result& result,
+                                     ThreadPool* pool,
+                                     size_t parts,
+                                     size_t chunkSize,
+                                     bool direct) {
+    using namespace file_digest_detail;
+    result = Result();
+
+    File file(filePath);
+    if (!file.open("rb"))
+        return false;
+    const int64_t fileSize = file.fileSize();
+
+    chunkSize = std::min(std::max(chunkSize, kAlignment), kMaxChunkSize);
+    chunkSize = (chunkSize + kAlignment - 1) / kAlignment * kAlignment;
+
+    AlignedBuffer buffers[kReadDepth];
+    for (AlignedBuffer& buffer : buffers) {
+        if (!buffer.allocate(chunkSize))
+            return false;
+    }
+
+#ifdef JHC_LINUX
+    // Chunk offsets and sizes are multiples of kAlignment, only the last read stops early, at the end of the file.
+    if (direct) {
+        const int fd = file.nativeHandle();
+        const int flags = fcntl(fd, F_GETFL);
+        if (flags != -1)
+            fcntl(fd, F_SETFL, flags | O_DIRECT);
+    }
+#else
+    (void)direct;
+#endif
+
+    // Declared after the buffers: its destructor waits for the reads still in flight before they are freed.
+    AsyncFileEngine engine(kReadDepth, AsyncFileEngine::Backend::Auto, kReadDepth);
+    std::future<int64_t> reads[kReadDepth];
+    uint64_t readOffset = 0;
+    for (size_t i = 0; i < kReadDepth; i++) {
+        reads[i] = engine.read(file, buffers[i].data(), chunkSize, (int64_t)readOffset);
+        readOffset += chunkSize;
+    }
+    engine.submit();
+
+    Hashers hashers(algorithms);
+    std::vector<Task> tasks;
+    uint64_t offset = 0;
+    for (size_t current = 0;; current = (current + 1) % kReadDepth) {
+        const int64_t read = reads[current].get();
+        if (read < 0) {
+            engine.wait();
+            return false;
+        }
+        const size_t size = (size_t)read;
+        if (size == 0)
+            break;
+
+        const unsigned char* data = buffers[current].data();
+        PlanChunk(algorithms, size, parts, tasks);
+        if (pool) {
+            pool->parallelFor<size_t>(0, tasks.size(), 1, [&](size_t b, size_t e) {
+                for (size_t i = b; i < e; i++)
+                    RunTask(tasks[i], hashers, data);
+            });
+        }
+        else {
+            for (Task& task : tasks)
+                RunTask(task, hashers, data);
+        }
+        CombineChunk(tasks, hashers);
+        offset += size;
+        if (size < chunkSize)
+            break;
+
+        // The buffer is hashed, it reads the chunk kReadDepth ahead.
+        reads[current] = engine.read(file, buffers[current].data(), chunkSize, (int64_t)readOffset);
+        readOffset += chunkSize;
+        engine.submit();
+    }
+    engine.wait();
+    file.close();
+
+    result.size = offset;
+    if (fileSize >= 0 && offset != (uint64_t)fileSize)
+        return false;
+
+    hashers.report(result);
+    return true;
+}
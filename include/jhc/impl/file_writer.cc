@@ -0,0 +1,218 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../file_writer.hpp"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#ifdef JHC_WIN
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+JHC_INLINE jhc::FileWriter::FileWriter(size_t bufferSize, size_t bufferCount) :
+    bufferSize_((std::max<size_t>(bufferSize, (size_t)kAlignment) + kAlignment - 1) / kAlignment * kAlignment),
+    failed_(false) {
+    buffers_.resize(std::max<size_t>(bufferCount, 2));
+    for (Buffer& buffer : buffers_)
+        buffer.data = AllocAligned(bufferSize_);
+    engine_.reset(new AsyncFileEngine(buffers_.size(), AsyncFileEngine::Backend::Auto, buffers_.size()));
+}
+
+JHC_INLINE jhc::FileWriter::~FileWriter() {
+    close();
+    engine_.reset();
+    for (Buffer& buffer : buffers_)
+        FreeAligned(buffer.data);
+}
+
+JHC_INLINE bool jhc::FileWriter::open(const fs::path& path, bool append, bool direct) {
+    close();
+    for (const Buffer& buffer : buffers_) {
+        if (!buffer.data)
+            return false;
+    }
+
+    // Never opened in append mode, the system would ignore the offsets of the writes.
+    std::unique_ptr<File> file(new File(path));
+    if (append) {
+        if (!file->open("rb+") && !file->open("wb+"))
+            return false;
+    }
+    else if (!file->open("wb+")) {
+        return false;
+    }
+
+    const int64_t start = append ? file->fileSize() : 0;
+    if (start < 0)
+        return false;
+
+    current_ = 0;
+    used_ = 0;
+    bufferOffset_ = written_ = start;
+    direct_ = false;
+    failed_ = false;
+
+#ifdef JHC_LINUX
+    if (direct) {
+        // Buffers start at aligned offsets: the partial last block of the file is read back into the first one.
+        const size_t tail = (size_t)(start % kAlignment);
+        if (tail > 0 && file->readAt(buffers_[0].data, tail, start - tail) != tail)
+            return false;
+
+        const int fd = file->nativeHandle();
+        const int flags = fcntl(fd, F_GETFL);
+        if (flags != -1 && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0) {
+            direct_ = true;
+            bufferOffset_ = start - tail;
+            used_ = tail;
+        }
+    }
+#else
+    (void)direct;
+#endif
+
+    file_ = std::move(file);
+    return true;
+}
+
+JHC_INLINE bool jhc::FileWriter::isOpen() const {
+    return file_ != nullptr;
+}
+
+JHC_INLINE bool jhc::FileWriter::isDirect() const {
+    return direct_;
+}
+
+JHC_INLINE bool jhc::FileWriter::write(const void* data, size_t size) {
+    if (!file_ || failed_)
+        return false;
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    while (size > 0) {
+        const size_t n = std::min(size, bufferSize_ - used_);
+        memcpy(buffers_[current_].data + used_, p, n);
+        used_ += n;
+        p += n;
+        size -= n;
+
+        if (used_ == bufferSize_) {
+            handOff();
+            if (failed_)
+                return false;
+        }
+    }
+    return true;
+}
+
+JHC_INLINE bool jhc::FileWriter::flush() {
+    if (!file_)
+        return false;
+
+    if (size() > written_)
+        handOff();
+    engine_->wait();
+
+#ifdef JHC_LINUX
+    // Cuts the padding of the last block.
+    if (direct_ && !failed_ && ftruncate64(file_->nativeHandle(), size()) != 0)
+        failed_ = true;
+#endif
+    return !failed_;
+}
+
+JHC_INLINE bool jhc::FileWriter::sync() {
+    if (!flush())
+        return false;
+
+    std::future<int64_t> synced = engine_->sync(*file_);
+    engine_->submit();
+    return synced.get() == 0;
+}
+
+JHC_INLINE bool jhc::FileWriter::close() {
+    if (!file_)
+        return false;
+
+    bool result = flush();
+    result = file_->close() && result;
+    file_.reset();
+    direct_ = false;
+    return result;
+}
+
+JHC_INLINE int64_t jhc::FileWriter::size() const {
+    return bufferOffset_ + (int64_t)used_;
+}
+
+JHC_INLINE bool jhc::FileWriter::failed() const {
+    return failed_;
+}
+
+JHC_INLINE void jhc::FileWriter::handOff() {
+    Buffer* buffer = &buffers_[current_];
+    size_t length = used_;
+    if (direct_) {
+        // Only the last buffer before a flush is not full, its padding is cut by flush().
+        length = (used_ + kAlignment - 1) / kAlignment * kAlignment;
+        memset(buffer->data + used_, 0, length - used_);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer->busy = true;
+    }
+    const bool queued = engine_->write(*file_, buffer->data, length, bufferOffset_, [this, buffer, length](int64_t result) {
+        if (result != (int64_t)length)
+            failed_ = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer->busy = false;
+        }
+        bufferFreed_.notify_all();
+    });
+    if (!queued) {
+        failed_ = true;
+        buffer->busy = false;
+        return;
+    }
+    engine_->submit();
+
+    const size_t next = (current_ + 1) % buffers_.size();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bufferFreed_.wait(lock, [this, next]() { return !buffers_[next].busy; });
+    }
+
+    // In direct mode the partial last block is written again, completed, with the next buffer.
+    const size_t tail = direct_ ? used_ % kAlignment : 0;
+    if (tail > 0)
+        memcpy(buffers_[next].data, buffer->data + used_ - tail, tail);
+    written_ = bufferOffset_ + (int64_t)used_;
+    bufferOffset_ += (int64_t)(used_ - tail);
+    used_ = tail;
+    current_ = next;
+}
+
+JHC_INLINE unsigned char* jhc::FileWriter::AllocAligned(size_t size) {
+#ifdef JHC_WIN
+    return static_cast<unsigned char*>(_aligned_malloc(size, kAlignment));
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, kAlignment, size) != 0)
+        return nullptr;
+    return static_cast<unsigned char*>(p);
+#endif
+}
+
+JHC_INLINE void jhc::FileWriter::FreeAligned(unsigned char* p) {
+#ifdef JHC_WIN
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
@@ -5,29 +5,46 @@
 #endif
 #include "jhc/arch.hpp"
 #include "jhc/byteorder.hpp"
+#include "jhc/cpu_features.hpp"
+#include "jhc/impl/multi_buffer_hash.hpp"
+#include <vector>
+#ifdef JHC_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
+JHC_INLINE jhc::MD5::MD5() {
+    init();
+}
+
+JHC_INLINE void jhc::MD5::init() {
+    MD5Init(&ctx_);
+}
+
+JHC_INLINE void jhc::MD5::update(const void* data, size_t size) {
+    const unsigned char* p = (const unsigned char*)data;
+    while (size > 0) {
+        const unsigned int len = size > (1u << 30) ? (1u << 30) : (unsigned int)size;
+        MD5Update(&ctx_, p, len);
+        p += len;
+        size -= len;
+    }
+}
+
+JHC_INLINE jhc::MD5::Digest jhc::MD5::finalize() {
+    Digest digest;
+    MD5Final(digest.data(), &ctx_);
+    return digest;
+}
 
 // Support large memory.
 //
 JHC_INLINE std::string jhc::MD5::GetDataMD5(const unsigned char* buffer, size_t buffer_size) {
-    unsigned char md5Sig[16] = {0};
     char szMd5[33] = {0};
 
     MD5 md5;
-    MD5Context md5Context;
-    md5.MD5Init(&md5Context);
-
-    size_t offset = 0;
-    while (offset < buffer_size) {
-        unsigned int needRead = 10240;
-        if (offset + needRead > buffer_size)
-            needRead = buffer_size - offset;
-
-        md5.MD5Update(&md5Context, buffer + offset, needRead);
-        offset += needRead;
-    }
-
-    md5.MD5Final(md5Sig, &md5Context);
-    md5.MD5SigToString(md5Sig, szMd5, 33);
+    md5.update(buffer, buffer_size);
+    Digest md5Sig = md5.finalize();
+    md5.MD5SigToString(md5Sig.data(), szMd5, 33);
 
     return szMd5;
 }
@@ -51,10 +68,10 @@ JHC_INLINE std::string jhc::MD5::GetFileMD5(const jhc::fs::path& file_path) {
     md5.MD5Init(&md5Context);
 
     size_t dwReadBytes = 0;
-    unsigned char szData[1024] = {0};
+    std::vector<unsigned char> szData(1024 * 1024);
 
-    while ((dwReadBytes = fread(szData, 1, 1024, f)) > 0) {
-        md5.MD5Update(&md5Context, szData, dwReadBytes);
+    while ((dwReadBytes = fread(szData.data(), 1, szData.size(), f)) > 0) {
+        md5.MD5Update(&md5Context, szData.data(), dwReadBytes);
     }
 
     fclose(f);
@@ -165,6 +182,7 @@ JHC_INLINE void jhc::MD5::MD5Buffer(const unsigned char* buf, unsigned int len,
 }
 
 JHC_INLINE void jhc::MD5::MD5SigToString(unsigned char signature[16], char* str, int len) {
+    static const char HEX_STRING[17] = "0123456789abcdef"; /* to convert to hex */
     unsigned char* sig_p;
     char *str_p, *max_p;
     unsigned int high, low;
@@ -293,6 +311,114 @@ JHC_INLINE void jhc::MD5::MD5Transform(unsigned int buf[4], unsigned int const i
 
 #endif
 
+namespace jhc {
+namespace md5_detail {
+#ifdef JHC_X86_INTRINSICS
+#define JHC_MD5_F18(x, y, z) _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z)))
+#define JHC_MD5_F28(x, y, z) JHC_MD5_F18(z, x, y)
+#define JHC_MD5_F38(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define JHC_MD5_F48(x, y, z) _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, ones)))
+#define JHC_MD5_STEP8(f, w, x, y, z, in, k, s)                                                            \
+    w = _mm256_add_epi32(w, _mm256_add_epi32(f(x, y, z), _mm256_add_epi32(in, _mm256_set1_epi32((int)k)))); \
+    w = _mm256_add_epi32(_mm256_or_si256(_mm256_slli_epi32(w, s), _mm256_srli_epi32(w, 32 - s)), x)
+
+// MD5Transform on one block of 8 independent messages, lane l of state[i] is word i of message l.
+//
+JHC_TARGET("avx2")
+inline void Transform8Avx2(uint32_t state[4][8], const unsigned char* const blocks[8]) {
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i in[16];
+    multi_buffer_detail::LoadBlocks8(blocks, in);
+
+    __m256i a = _mm256_load_si256((const __m256i*)state[0]);
+    __m256i b = _mm256_load_si256((const __m256i*)state[1]);
+    __m256i c = _mm256_load_si256((const __m256i*)state[2]);
+    __m256i d = _mm256_load_si256((const __m256i*)state[3]);
+    const __m256i a0 = a, b0 = b, c0 = c, d0 = d;
+
+    JHC_MD5_STEP8(JHC_MD5_F18, a, b, c, d, in[0], 0xd76aa478, 7);
+    JHC_MD5_STEP8(JHC_MD5_F18, d, a, b, c, in[1], 0xe8c7b756, 12);
+    JHC_MD5_STEP8(JHC_MD5_F18, c, d, a, b, in[2], 0x242070db, 17);
+    JHC_MD5_STEP8(JHC_MD5_F18, b, c, d, a, in[3], 0xc1bdceee, 22);
+    JHC_MD5_STEP8(JHC_MD5_F18, a, b, c, d, in[4], 0xf57c0faf, 7);
+    JHC_MD5_STEP8(JHC_MD5_F18, d, a, b, c, in[5], 0x4787c62a, 12);
+    JHC_MD5_STEP8(JHC_MD5_F18, c, d, a, b, in[6], 0xa8304613, 17);
+    JHC_MD5_STEP8(JHC_MD5_F18, b, c, d, a, in[7], 0xfd469501, 22);
+    JHC_MD5_STEP8(JHC_MD5_F18, a, b, c, d, in[8], 0x698098d8, 7);
+    JHC_MD5_STEP8(JHC_MD5_F18, d, a, b, c, in[9], 0x8b44f7af, 12);
+    JHC_MD5_STEP8(JHC_MD5_F18, c, d, a, b, in[10], 0xffff5bb1, 17);
+    JHC_MD5_STEP8(JHC_MD5_F18, b, c, d, a, in[11], 0x895cd7be, 22);
+    JHC_MD5_STEP8(JHC_MD5_F18, a, b, c, d, in[12], 0x6b901122, 7);
+    JHC_MD5_STEP8(JHC_MD5_F18, d, a, b, c, in[13], 0xfd987193, 12);
+    JHC_MD5_STEP8(JHC_MD5_F18, c, d, a, b, in[14], 0xa679438e, 17);
+    JHC_MD5_STEP8(JHC_MD5_F18, b, c, d, a, in[15], 0x49b40821, 22);
+
+    JHC_MD5_STEP8(JHC_MD5_F28, a, b, c, d, in[1], 0xf61e2562, 5);
+    JHC_MD5_STEP8(JHC_MD5_F28, d, a, b, c, in[6], 0xc040b340, 9);
+    JHC_MD5_STEP8(JHC_MD5_F28, c, d, a, b, in[11], 0x265e5a51, 14);
+    JHC_MD5_STEP8(JHC_MD5_F28, b, c, d, a, in[0], 0xe9b6c7aa, 20);
+    JHC_MD5_STEP8(JHC_MD5_F28, a, b, c, d, in[5], 0xd62f105d, 5);
+    JHC_MD5_STEP8(JHC_MD5_F28, d, a, b, c, in[10], 0x02441453, 9);
+    JHC_MD5_STEP8(JHC_MD5_F28, c, d, a, b, in[15], 0xd8a1e681, 14);
+    JHC_MD5_STEP8(JHC_MD5_F28, b, c, d, a, in[4], 0xe7d3fbc8, 20);
+    JHC_MD5_STEP8(JHC_MD5_F28, a, b, c, d, in[9], 0x21e1cde6, 5);
+    JHC_MD5_STEP8(JHC_MD5_F28, d, a, b, c, in[14], 0xc33707d6, 9);
+    JHC_MD5_STEP8(JHC_MD5_F28, c, d, a, b, in[3], 0xf4d50d87, 14);
+    JHC_MD5_STEP8(JHC_MD5_F28, b, c, d, a, in[8], 0x455a14ed, 20);
+    JHC_MD5_STEP8(JHC_MD5_F28, a, b, c, d, in[13], 0xa9e3e905, 5);
+    JHC_MD5_STEP8(JHC_MD5_F28, d, a, b, c, in[2], 0xfcefa3f8, 9);
+    JHC_MD5_STEP8(JHC_MD5_F28, c, d, a, b, in[7], 0x676f02d9, 14);
+    JHC_MD5_STEP8(JHC_MD5_F28, b, c, d, a, in[12], 0x8d2a4c8a, 20);
+
+    JHC_MD5_STEP8(JHC_MD5_F38, a, b, c, d, in[5], 0xfffa3942, 4);
+    JHC_MD5_STEP8(JHC_MD5_F38, d, a, b, c, in[8], 0x8771f681, 11);
+    JHC_MD5_STEP8(JHC_MD5_F38, c, d, a, b, in[11], 0x6d9d6122, 16);
+    JHC_MD5_STEP8(JHC_MD5_F38, b, c, d, a, in[14], 0xfde5380c, 23);
+    JHC_MD5_STEP8(JHC_MD5_F38, a, b, c, d, in[1], 0xa4beea44, 4);
+    JHC_MD5_STEP8(JHC_MD5_F38, d, a, b, c, in[4], 0x4bdecfa9, 11);
+    JHC_MD5_STEP8(JHC_MD5_F38, c, d, a, b, in[7], 0xf6bb4b60, 16);
+    JHC_MD5_STEP8(JHC_MD5_F38, b, c, d, a, in[10], 0xbebfbc70, 23);
+    JHC_MD5_STEP8(JHC_MD5_F38, a, b, c, d, in[13], 0x289b7ec6, 4);
+    JHC_MD5_STEP8(JHC_MD5_F38, d, a, b, c, in[0], 0xeaa127fa, 11);
+    JHC_MD5_STEP8(JHC_MD5_F38, c, d, a, b, in[3], 0xd4ef3085, 16);
+    JHC_MD5_STEP8(JHC_MD5_F38, b, c, d, a, in[6], 0x04881d05, 23);
+    JHC_MD5_STEP8(JHC_MD5_F38, a, b, c, d, in[9], 0xd9d4d039, 4);
+    JHC_MD5_STEP8(JHC_MD5_F38, d, a, b, c, in[12], 0xe6db99e5, 11);
+    JHC_MD5_STEP8(JHC_MD5_F38, c, d, a, b, in[15], 0x1fa27cf8, 16);
+    JHC_MD5_STEP8(JHC_MD5_F38, b, c, d, a, in[2], 0xc4ac5665, 23);
+
+    JHC_MD5_STEP8(JHC_MD5_F48, a, b, c, d, in[0], 0xf4292244, 6);
+    JHC_MD5_STEP8(JHC_MD5_F48, d, a, b, c, in[7], 0x432aff97, 10);
+    JHC_MD5_STEP8(JHC_MD5_F48, c, d, a, b, in[14], 0xab9423a7, 15);
+    JHC_MD5_STEP8(JHC_MD5_F48, b, c, d, a, in[5], 0xfc93a039, 21);
+    JHC_MD5_STEP8(JHC_MD5_F48, a, b, c, d, in[12], 0x655b59c3, 6);
+    JHC_MD5_STEP8(JHC_MD5_F48, d, a, b, c, in[3], 0x8f0ccc92, 10);
+    JHC_MD5_STEP8(JHC_MD5_F48, c, d, a, b, in[10], 0xffeff47d, 15);
+    JHC_MD5_STEP8(JHC_MD5_F48, b, c, d, a, in[1], 0x85845dd1, 21);
+    JHC_MD5_STEP8(JHC_MD5_F48, a, b, c, d, in[8], 0x6fa87e4f, 6);
+    JHC_MD5_STEP8(JHC_MD5_F48, d, a, b, c, in[15], 0xfe2ce6e0, 10);
+    JHC_MD5_STEP8(JHC_MD5_F48, c, d, a, b, in[6], 0xa3014314, 15);
+    JHC_MD5_STEP8(JHC_MD5_F48, b, c, d, a, in[13], 0x4e0811a1, 21);
+    JHC_MD5_STEP8(JHC_MD5_F48, a, b, c, d, in[4], 0xf7537e82, 6);
+    JHC_MD5_STEP8(JHC_MD5_F48, d, a, b, c, in[11], 0xbd3af235, 10);
+    JHC_MD5_STEP8(JHC_MD5_F48, c, d, a, b, in[2], 0x2ad7d2bb, 15);
+    JHC_MD5_STEP8(JHC_MD5_F48, b, c, d, a, in[9], 0xeb86d391, 21);
+
+    _mm256_store_si256((__m256i*)state[0], _mm256_add_epi32(a, a0));
+    _mm256_store_si256((__m256i*)state[1], _mm256_add_epi32(b, b0));
+    _mm256_store_si256((__m256i*)state[2], _mm256_add_epi32(c, c0));
+    _mm256_store_si256((__m256i*)state[3], _mm256_add_epi32(d, d0));
+}
+
+#undef JHC_MD5_F18
+#undef JHC_MD5_F28
+#undef JHC_MD5_F38
+#undef JHC_MD5_F48
+#undef JHC_MD5_STEP8
+#endif
+}  // namespace md5_detail
+}  // namespace jhc
+
 JHC_INLINE void jhc::MD5::byteSwap(unsigned int* buf, unsigned words) {
     unsigned char* p;
 
@@ -305,4 +431,49 @@ JHC_INLINE void jhc::MD5::byteSwap(unsigned int* buf, unsigned words) {
         *buf++ = (unsigned int)((unsigned)p[3] << 8 | p[2]) << 16 | ((unsigned)p[1] << 8 | p[0]);
         p += 4;
     } while (--words);
-}
\ No newline at end of file
+}
+
+JHC_INLINE void jhc::MD5::HashBatch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests) {
+#ifdef JHC_X86_INTRINSICS
+    if (CpuFeatures::Get().avx2) {
+        struct Lanes {
+            enum { kStateWords = 4,
+                   kDigestSize = 16,
+                   kBigEndian = 0 };
+
+            static void Init(uint32_t state[4]) {
+                state[0] = 0x67452301;
+                state[1] = 0xefcdab89;
+                state[2] = 0x98badcfe;
+                state[3] = 0x10325476;
+            }
+
+            static void Compress8(uint32_t state[4][8], const unsigned char* const blocks[8]) {
+                md5_detail::Transform8Avx2(state, blocks);
+            }
+
+            static void Compress(uint32_t state[4], const unsigned char* data, size_t blocks) {
+                unsigned int in[16];
+                for (; blocks > 0; blocks--, data += 64) {
+                    memcpy(in, data, 64);
+                    MD5Transform(state, in);
+                }
+            }
+
+            static void Digest(const uint32_t state[4], unsigned char* digest) {
+                memcpy(digest, state, 16);
+            }
+        };
+        multi_buffer_detail::Batch<Lanes>::Run(data, sizes, count, digests);
+        return;
+    }
+#endif
+
+    MD5 md5;
+    for (size_t i = 0; i < count; i++) {
+        md5.init();
+        md5.update(data[i], sizes[i]);
+        const Digest digest = md5.finalize();
+        memcpy(digests + kDigestSize * i, digest.data(), kDigestSize);
+    }
+}
@@ -0,0 +1,152 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../monotonic_arena.hpp"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+JHC_INLINE jhc::MonotonicArena::Scope::Scope(MonotonicArena& arena) :
+    prev_(CurrentRef()) {
+    CurrentRef() = &arena;
+}
+
+JHC_INLINE jhc::MonotonicArena::Scope::~Scope() {
+    CurrentRef() = prev_;
+}
+
+JHC_INLINE jhc::MonotonicArena::MonotonicArena(size_t blockSize) :
+    first_(nullptr),
+    current_(nullptr),
+    cursor_(nullptr),
+    end_(nullptr),
+    next_block_size_(blockSize < 64 ? 64 : blockSize),
+    used_before_current_(0),
+    reserved_(0) {}
+
+JHC_INLINE jhc::MonotonicArena::~MonotonicArena() {
+    release();
+}
+
+JHC_INLINE jhc::MonotonicArena*& jhc::MonotonicArena::CurrentRef() {
+    static thread_local MonotonicArena* current = nullptr;
+    return current;
+}
+
+JHC_INLINE jhc::MonotonicArena* jhc::MonotonicArena::Current() {
+    return CurrentRef();
+}
+
+JHC_INLINE size_t jhc::MonotonicArena::BlockHeaderSize() {
+    return (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+}
+
+JHC_INLINE char* jhc::MonotonicArena::blockData(Block* b) const {
+    return reinterpret_cast<char*>(b) + BlockHeaderSize();
+}
+
+JHC_INLINE void* jhc::MonotonicArena::allocate(size_t bytes, size_t alignment) {
+    if (bytes == 0)
+        bytes = 1;
+
+    for (;;) {
+        if (cursor_) {
+            char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+            if (p <= end_ && static_cast<size_t>(end_ - p) >= bytes) {
+                cursor_ = p + bytes;
+                return p;
+            }
+        }
+
+        if (!nextBlock(bytes, alignment))
+            throw std::bad_alloc();
+    }
+}
+
+// Move to the next block that can hold bytes: a block kept by reset() or a new one.
+JHC_INLINE bool jhc::MonotonicArena::nextBlock(size_t bytes, size_t alignment) {
+    const size_t maxSize = SIZE_MAX - BlockHeaderSize();
+    if (bytes > maxSize - alignment)
+        return false;
+    const size_t need = bytes + alignment;
+
+    if (current_)
+        used_before_current_ += current_->size;
+
+    // blocks that are too small for this request are skipped until the next reset.
+    Block* reuse = current_ ? current_->next : nullptr;
+    Block* prev = current_;
+    while (reuse && reuse->size < need) {
+        used_before_current_ += reuse->size;
+        prev = reuse;
+        reuse = reuse->next;
+    }
+
+    if (!reuse) {
+        size_t size = next_block_size_;
+        while (size < need)
+            size = size > maxSize / 2 ? need : size * 2;
+        if (next_block_size_ < kMaxBlockSize)
+            next_block_size_ *= 2;
+
+        reuse = static_cast<Block*>(malloc(BlockHeaderSize() + size));
+        if (!reuse)
+            return false;
+        reuse->size = size;
+        reuse->next = nullptr;
+        reserved_ += BlockHeaderSize() + size;
+
+        if (prev)
+            prev->next = reuse;
+        else
+            first_ = reuse;
+    }
+
+    current_ = reuse;
+    cursor_ = blockData(reuse);
+    end_ = cursor_ + reuse->size;
+    return true;
+}
+
+JHC_INLINE char* jhc::MonotonicArena::copyString(const char* s, size_t len) {
+    char* p = static_cast<char*>(allocate(len + 1, 1));
+    if (len > 0)
+        memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+JHC_INLINE char* jhc::MonotonicArena::copyString(const std::string& s) {
+    return copyString(s.data(), s.size());
+}
+
+JHC_INLINE void jhc::MonotonicArena::reset() noexcept {
+    current_ = first_;
+    cursor_ = first_ ? blockData(first_) : nullptr;
+    end_ = first_ ? cursor_ + first_->size : nullptr;
+    used_before_current_ = 0;
+}
+
+JHC_INLINE void jhc::MonotonicArena::release() noexcept {
+    Block* b = first_;
+    while (b) {
+        Block* next = b->next;
+        free(b);
+        b = next;
+    }
+
+    first_ = nullptr;
+    reserved_ = 0;
+    reset();
+}
+
+JHC_INLINE size_t jhc::MonotonicArena::usedBytes() const {
+    if (!current_)
+        return 0;
+    return used_before_current_ + static_cast<size_t>(cursor_ - blockData(current_));
+}
+
+JHC_INLINE size_t jhc::MonotonicArena::reservedBytes() const {
+    return reserved_;
+}
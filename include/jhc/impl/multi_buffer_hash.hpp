@@ -0,0 +1,234 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_MULTI_BUFFER_HASH_HPP__
+#define JHC_MULTI_BUFFER_HASH_HPP__
+
+#include "jhc/cpu_features.hpp"
+#include <stdint.h>
+#include <string.h>
+#ifdef JHC_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
+namespace jhc {
+namespace multi_buffer_detail {
+// Hashes many independent messages with a Merkle-Damgard compression function that processes
+// one 64-byte block of 8 messages at a time (one message per SIMD lane).
+// A lane is refilled with the next message as soon as its last block is done. Once no message
+// is left and less than half of the lanes are busy, the remaining ones are finished one by one.
+//
+// Hash provides:
+//   enum { kStateWords, kDigestSize, kBigEndian };   // kBigEndian: byte order of the length field
+//   static void Init(uint32_t state[kStateWords]);
+//   static void Compress8(uint32_t state[kStateWords][8], const unsigned char* const blocks[8]);
+//   static void Compress(uint32_t state[kStateWords], const unsigned char* data, size_t blocks);
+//   static void Digest(const uint32_t state[kStateWords], unsigned char* digest);
+//
+template <class Hash>
+class Batch {
+   public:
+    enum { kLanes = 8 };
+
+    static void Run(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests) {
+        Batch batch(data, sizes, count, digests);
+        batch.run();
+    }
+
+    // One message at a time through Hash::Compress, for CPUs where the single-buffer kernel
+    // is faster than 8 lanes (e.g. with the SHA extensions). Still no per-message allocation.
+    //
+    static void RunSerial(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests) {
+        unsigned char tail[128];
+        for (size_t i = 0; i < count; i++) {
+            uint32_t state[Hash::kStateWords];
+            Hash::Init(state);
+            Hash::Compress(state, data[i], sizes[i] / 64);
+            Hash::Compress(state, tail, Pad(data[i], sizes[i], tail));
+            Hash::Digest(state, digests + i * Hash::kDigestSize);
+        }
+    }
+
+   private:
+    struct Lane {
+        size_t message;  // index of the message, count when idle
+        const unsigned char* data;
+        size_t blocks;  // full blocks left in data
+        size_t tailBlocks;
+        size_t tailIndex;
+        unsigned char tail[128];  // last partial block, padding and length
+    };
+
+    Batch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests) :
+        data_(data), sizes_(sizes), count_(count), digests_(digests) {
+        memset(zero_, 0, sizeof(zero_));
+    }
+
+    void run() {
+        for (int l = 0; l < kLanes; l++)
+            start(l);
+
+        while (active_ > 0 && (next_ < count_ || active_ * 2 >= kLanes)) {
+            const unsigned char* blocks[kLanes];
+            for (int l = 0; l < kLanes; l++)
+                blocks[l] = advance(lanes_[l]);
+
+            Hash::Compress8(state_, blocks);
+
+            for (int l = 0; l < kLanes; l++) {
+                const Lane& lane = lanes_[l];
+                if (lane.message < count_ && lane.blocks == 0 && lane.tailIndex == lane.tailBlocks) {
+                    uint32_t state[Hash::kStateWords];
+                    getState(l, state);
+                    Hash::Digest(state, digests_ + lane.message * Hash::kDigestSize);
+                    active_--;
+                    start(l);
+                }
+            }
+        }
+
+        for (int l = 0; l < kLanes; l++) {
+            Lane& lane = lanes_[l];
+            if (lane.message >= count_)
+                continue;
+
+            uint32_t state[Hash::kStateWords];
+            getState(l, state);
+            Hash::Compress(state, lane.data, lane.blocks);
+            Hash::Compress(state, lane.tail + lane.tailIndex * 64, lane.tailBlocks - lane.tailIndex);
+            Hash::Digest(state, digests_ + lane.message * Hash::kDigestSize);
+        }
+    }
+
+    void start(int l) {
+        Lane& lane = lanes_[l];
+        lane.message = next_ < count_ ? next_++ : count_;
+        uint32_t state[Hash::kStateWords];
+        Hash::Init(state);
+        for (int i = 0; i < Hash::kStateWords; i++)
+            state_[i][l] = state[i];
+
+        if (lane.message == count_) {
+            lane.data = zero_;
+            lane.blocks = lane.tailBlocks = lane.tailIndex = 0;
+            return;
+        }
+
+        const size_t size = sizes_[lane.message];
+        lane.data = data_[lane.message];
+        lane.blocks = size / 64;
+        lane.tailBlocks = Pad(lane.data, size, lane.tail);
+        lane.tailIndex = 0;
+        active_++;
+    }
+
+    // Writes the last partial block of the message, the padding and the length to tail.
+    // Returns the number of blocks written, 1 or 2.
+    //
+    static size_t Pad(const unsigned char* data, size_t size, unsigned char tail[128]) {
+        const size_t rest = size % 64;
+        const size_t blocks = rest + 9 <= 64 ? 1 : 2;
+        if (rest > 0)
+            memcpy(tail, data + size - rest, rest);
+        tail[rest] = 0x80;
+        memset(tail + rest + 1, 0, blocks * 64 - rest - 1);
+
+        const uint64_t bits = (uint64_t)size << 3;
+        for (int i = 0; i < 8; i++)
+            tail[blocks * 64 - 8 + i] = (unsigned char)(bits >> (Hash::kBigEndian ? 56 - 8 * i : 8 * i));
+        return blocks;
+    }
+
+    // The next block of the lane, zeros for idle lanes.
+    //
+    const unsigned char* advance(Lane& lane) {
+        if (lane.blocks > 0) {
+            const unsigned char* block = lane.data;
+            lane.data += 64;
+            lane.blocks--;
+            return block;
+        }
+        if (lane.tailIndex < lane.tailBlocks)
+            return lane.tail + 64 * lane.tailIndex++;
+        return zero_;
+    }
+
+    void getState(int l, uint32_t state[Hash::kStateWords]) const {
+        for (int i = 0; i < Hash::kStateWords; i++)
+            state[i] = state_[i][l];
+    }
+
+    const unsigned char* const* data_;
+    const size_t* sizes_;
+    const size_t count_;
+    unsigned char* digests_;
+    size_t next_ = 0;
+    int active_ = 0;
+    Lane lanes_[kLanes];
+    alignas(32) uint32_t state_[Hash::kStateWords][kLanes];
+    unsigned char zero_[64];
+};
+
+#ifdef JHC_X86_INTRINSICS
+// Transposes 8 rows of 8 words: out[k] gets word k of every row.
+//
+JHC_TARGET("avx2")
+inline void Transpose8x8(const __m256i r[8], __m256i out[8]) {
+    const __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    const __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    const __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    const __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    const __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    const __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    const __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    const __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    out[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    out[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    out[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    out[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    out[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    out[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    out[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    out[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// Loads one 64-byte block of 8 messages as 16 vectors, words[k] holding word k of every block.
+//
+JHC_TARGET("avx2")
+inline void LoadBlocks8(const unsigned char* const blocks[8], __m256i words[16]) {
+    for (int half = 0; half < 2; half++) {
+        __m256i rows[8];
+        for (int l = 0; l < 8; l++)
+            rows[l] = _mm256_loadu_si256((const __m256i*)(blocks[l] + half * 32));
+        Transpose8x8(rows, words + half * 8);
+    }
+}
+#endif
+}  // namespace multi_buffer_detail
+}  // namespace jhc
+
+#endif  // !JHC_MULTI_BUFFER_HASH_HPP__
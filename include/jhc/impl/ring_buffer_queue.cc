@@ -0,0 +1,130 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../ring_buffer_queue.hpp"
+#endif
+
+#include <stdint.h>
+
+// Implementation of Dmitry Vyukov's bounded MPMC queue.
+// Each slot carries a sequence number: sequence == pos means the slot is free for the producer
+// that claimed pos, sequence == pos + 1 means it holds data for the consumer that claimed pos.
+
+JHC_INLINE jhc::RingBufferQueue::RingBufferQueue(size_t capacity, size_t maxElementSize, const std::string& name) :
+    queue_name_(name),
+    mask_(0),
+    max_element_size_(maxElementSize),
+    slot_stride_(0),
+    memory_(nullptr),
+    slots_(nullptr),
+    enqueue_pos_(0),
+    dequeue_pos_(0) {
+    size_t cap = 2;
+    while (cap < capacity)
+        cap <<= 1;
+    mask_ = cap - 1;
+
+    // Every slot starts on its own cache line, so neighbouring producers/consumers don't false-share.
+    slot_stride_ = (sizeof(Slot) + max_element_size_ + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+
+    memory_ = malloc(slot_stride_ * cap + kCacheLineSize);
+    if (!memory_)
+        throw std::bad_alloc();
+
+    slots_ = (char*)(((uintptr_t)memory_ + kCacheLineSize - 1) & ~(uintptr_t)(kCacheLineSize - 1));
+
+    for (size_t i = 0; i < cap; i++) {
+        Slot* slot = new (slots_ + i * slot_stride_) Slot();
+        slot->sequence.store(i, std::memory_order_relaxed);
+        slot->size = 0;
+    }
+}
+
+JHC_INLINE jhc::RingBufferQueue::~RingBufferQueue() {
+    for (size_t i = 0; i <= mask_; i++)
+        slotAt(i)->~Slot();
+    SAFE_FREE(memory_);
+}
+
+JHC_INLINE std::string jhc::RingBufferQueue::getQueueName() const {
+    return queue_name_;
+}
+
+JHC_INLINE size_t jhc::RingBufferQueue::capacity() const {
+    return mask_ + 1;
+}
+
+JHC_INLINE size_t jhc::RingBufferQueue::maxElementSize() const {
+    return max_element_size_;
+}
+
+JHC_INLINE jhc::RingBufferQueue::Slot* jhc::RingBufferQueue::slotAt(size_t pos) const {
+    return (Slot*)(slots_ + (pos & mask_) * slot_stride_);
+}
+
+JHC_INLINE bool jhc::RingBufferQueue::pushElementToLast(const void* pData, size_t nDataSize) {
+    if (pData == nullptr || nDataSize == 0 || nDataSize > max_element_size_)
+        return false;
+
+    Slot* slot = nullptr;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = slotAt(pos);
+        const size_t seq = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0) {
+            return false;  // full
+        }
+        else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    memcpy((char*)slot + sizeof(Slot), pData, nDataSize);
+    slot->size = nDataSize;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+JHC_INLINE size_t jhc::RingBufferQueue::popElementFromFront(void* pBuffer, size_t nBufferSize) {
+    Slot* slot = nullptr;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = slotAt(pos);
+        const size_t seq = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0) {
+            return 0;  // empty
+        }
+        else {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t rvalue = 0;
+    if (pBuffer != nullptr && nBufferSize > 0) {
+        // get smaller value of size.
+        rvalue = (slot->size > nBufferSize) ? nBufferSize : slot->size;
+        memcpy(pBuffer, (char*)slot + sizeof(Slot), rvalue);
+    }
+
+    // hand the slot back to the producer that will claim pos + capacity.
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+    return rvalue;
+}
+
+JHC_INLINE size_t jhc::RingBufferQueue::getElementCount() const {
+    const size_t deq = dequeue_pos_.load(std::memory_order_acquire);
+    const size_t enq = enqueue_pos_.load(std::memory_order_acquire);
+    return enq > deq ? enq - deq : 0;
+}
@@ -4,8 +4,20 @@
 #include "../sha1.hpp"
 #endif
 #include "jhc/file.hpp"
+#include "jhc/cpu_features.hpp"
+#include <vector>
+#ifdef JHC_X86_INTRINSICS
+#include <immintrin.h>
+#endif
 
 JHC_INLINE jhc::SHA1::SHA1() {
+    static const Kernel kernel = ActiveKernel();
+    kernel_ = kernel;
+    reset();
+}
+
+JHC_INLINE jhc::SHA1::SHA1(Kernel kernel) :
+    kernel_(kernel) {
     reset();
 }
 
@@ -21,49 +33,48 @@ JHC_INLINE void jhc::SHA1::reset() {
     m_state[3] = 0x10325476;
     m_state[4] = 0xC3D2E1F0;
 
-    m_count[0] = 0;
-    m_count[1] = 0;
+    m_count = 0;
 }
 
-// Use this function to hash in binary data and strings
-JHC_INLINE void jhc::SHA1::update(const unsigned char* data, unsigned int len) {
-    uint32_t i = 0, j = 0;
-
-    j = (m_count[0] >> 3) & 63;
+JHC_INLINE void jhc::SHA1::init() {
+    reset();
+}
 
-    if ((m_count[0] += len << 3) < (len << 3))
-        m_count[1]++;
+// Use this function to hash in binary data and strings
+JHC_INLINE void jhc::SHA1::update(const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i = 0;
+    size_t j = (size_t)(m_count >> 3) & 63;
 
-    m_count[1] += (len >> 29);
+    m_count += (uint64_t)len << 3;
 
     if ((j + len) > 63) {
-        memcpy(&m_buffer[j], data, (i = 64 - j));
-        transform(m_state, m_buffer);
+        memcpy(&m_buffer[j], p, (i = 64 - j));
+        transform(m_state, m_buffer, 1);
 
-        for (; i + 63 < len; i += 64) {
-            transform(m_state, &data[i]);
+        const size_t blocks = (len - i) / 64;
+        if (blocks > 0) {
+            transform(m_state, &p[i], blocks);
+            i += blocks * 64;
         }
 
         j = 0;
     }
-    else
-        i = 0;
 
-    memcpy(&m_buffer[j], &data[i], len - i);
+    memcpy(&m_buffer[j], &p[i], len - i);
 }
 
 JHC_INLINE void jhc::SHA1::final() {
-    uint32_t i = 0, j = 0;
+    uint32_t i = 0;
     unsigned char finalcount[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 
     for (i = 0; i < 8; i++)
-        finalcount[i] = (unsigned char)((m_count[(i >= 4 ? 0 : 1)] >> ((3 - (i & 3)) * 8)) &
-                                        255);  // Endian independent
+        finalcount[i] = (unsigned char)((m_count >> ((7 - i) * 8)) & 255);  // Endian independent
 
-    update((unsigned char*)"\200", 1);
+    update("\200", 1);
 
-    while ((m_count[0] & 504) != 448)
-        update((unsigned char*)"\0", 1);
+    while ((m_count & 504) != 448)
+        update("\0", 1);
 
     update(finalcount, 8);  // Cause a SHA1Transform()
 
@@ -72,14 +83,19 @@ JHC_INLINE void jhc::SHA1::final() {
     }
 
     // Wipe variables for security reasons
-    i = 0;
-    j = 0;
     memset(m_buffer, 0, 64);
     memset(m_state, 0, 20);
-    memset(m_count, 0, 8);
+    m_count = 0;
     memset(finalcount, 0, 8);
 
-    transform(m_state, m_buffer);
+    transform(m_state, m_buffer, 1);
+}
+
+JHC_INLINE jhc::SHA1::Digest jhc::SHA1::finalize() {
+    final();
+    Digest digest;
+    memcpy(digest.data(), m_digest, kDigestSize);
+    return digest;
 }
 
 // Get the final hash as a pre-formatted string
@@ -87,17 +103,12 @@ JHC_INLINE void jhc::SHA1::reportHash(char* szReport, unsigned char uReportType)
     unsigned char i = 0;
 
     if (uReportType == REPORT_HEX) {
-        sprintf(szReport, "%02x", m_digest[0]);
-
-        for (i = 1; i < 20; i++)
-            sprintf(szReport, "%s%02x", szReport, m_digest[i]);
+        for (i = 0; i < 20; i++)
+            szReport += sprintf(szReport, "%02x", m_digest[i]);
     }
     else if (uReportType == REPORT_DIGIT) {
-        sprintf(szReport, "%u", m_digest[0]);
-
-        for (i = 1; i < 20; i++) {
-            sprintf(szReport, "%s%u", szReport, m_digest[i]);
-        }
+        for (i = 0; i < 20; i++)
+            szReport += sprintf(szReport, "%u", m_digest[i]);
     }
 }
 
@@ -118,45 +129,23 @@ JHC_INLINE std::string jhc::SHA1::GetFileSHA1(const jhc::fs::path& filePath) {
     }
 
     SHA1 sha1;
-    sha1.reset();
 
     size_t dwReadBytes = 0;
-    unsigned char szData[1024] = {0};
+    std::vector<unsigned char> szData(1024 * 1024);
 
-    while ((dwReadBytes = file.readFrom(szData, 1024, -1)) > 0) {
-        sha1.update(szData, dwReadBytes);
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        sha1.update(szData.data(), dwReadBytes);
     }
     file.close();
 
-    sha1.final();
-
-    char szSHA1[256] = {0};
-    sha1.reportHash(szSHA1, SHA1::REPORT_HEX);
-
-    result = szSHA1;
+    result = DigestToHex(sha1.finalize());
     return result;
 }
 
 JHC_INLINE std::string jhc::SHA1::GetDataSHA1(const unsigned char* data, size_t dataSize) {
     SHA1 sha1;
-    sha1.reset();
-
-    size_t offset = 0;
-    while (offset < dataSize) {
-        unsigned int needRead = 10240;
-        if (offset + needRead > dataSize)
-            needRead = dataSize - offset;
-
-        sha1.update(data + offset, needRead);
-        offset += needRead;
-    }
-
-    sha1.final();
-
-    char szSHA1[256] = {0};
-    sha1.reportHash(szSHA1, SHA1::REPORT_HEX);
-
-    return szSHA1;
+    sha1.update(data, dataSize);
+    return DigestToHex(sha1.finalize());
 }
 
 #define ROL32(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
@@ -199,12 +188,18 @@ JHC_INLINE std::string jhc::SHA1::GetDataSHA1(const unsigned char* data, size_t
         w = ROL32(w, 30);                                        \
     }
 
-JHC_INLINE void jhc::SHA1::transform(uint32_t state[5], const unsigned char buffer[64]) {
+namespace jhc {
+namespace sha1_detail {
+typedef union {
+    unsigned char c[64];
+    uint32_t l[16];
+} WorkspaceBlock;
+
+inline void TransformBlock(uint32_t state[5], const unsigned char buffer[64]) {
     uint32_t a = 0, b = 0, c = 0, d = 0, e = 0;
 
-    SHA1_WORKSPACE_BLOCK* block;
-    static unsigned char workspace[64];
-    block = (SHA1_WORKSPACE_BLOCK*)workspace;
+    WorkspaceBlock workspace;
+    WorkspaceBlock* block = &workspace;
     memcpy(block, buffer, 64);
 
     // Copy state[] to working vars
@@ -309,4 +304,270 @@ JHC_INLINE void jhc::SHA1::transform(uint32_t state[5], const unsigned char buff
     c = 0;
     d = 0;
     e = 0;
+}
+
+inline void TransformScalar(uint32_t state[5], const unsigned char* data, size_t blocks) {
+    for (; blocks > 0; blocks--, data += 64)
+        TransformBlock(state, data);
+}
+
+#define JHC_SHA1_F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define JHC_SHA1_F2(b, c, d) ((b) ^ (c) ^ (d))
+#define JHC_SHA1_F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define JHC_SHA1_ROUND(f, a, b, c, d, e, wk)        \
+    {                                                \
+        e += f(b, c, d) + (wk) + ROL32(a, 5);        \
+        b = ROL32(b, 30);                            \
+    }
+#define JHC_SHA1_5ROUNDS(f, wk)                   \
+    JHC_SHA1_ROUND(f, a, b, c, d, e, (wk)[0]);    \
+    JHC_SHA1_ROUND(f, e, a, b, c, d, (wk)[1]);    \
+    JHC_SHA1_ROUND(f, d, e, a, b, c, (wk)[2]);    \
+    JHC_SHA1_ROUND(f, c, d, e, a, b, (wk)[3]);    \
+    JHC_SHA1_ROUND(f, b, c, d, e, a, (wk)[4])
+#define JHC_SHA1_20ROUNDS(f, wk)      \
+    JHC_SHA1_5ROUNDS(f, (wk));        \
+    JHC_SHA1_5ROUNDS(f, (wk) + 5);    \
+    JHC_SHA1_5ROUNDS(f, (wk) + 10);   \
+    JHC_SHA1_5ROUNDS(f, (wk) + 15)
+
+// The 80 rounds, with W[t] + K[t] already computed in wk.
+//
+inline void RoundsWk(uint32_t state[5], const uint32_t wk[80]) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    JHC_SHA1_20ROUNDS(JHC_SHA1_F1, wk);
+    JHC_SHA1_20ROUNDS(JHC_SHA1_F2, wk + 20);
+    JHC_SHA1_20ROUNDS(JHC_SHA1_F3, wk + 40);
+    JHC_SHA1_20ROUNDS(JHC_SHA1_F2, wk + 60);
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+#undef JHC_SHA1_F1
+#undef JHC_SHA1_F2
+#undef JHC_SHA1_F3
+#undef JHC_SHA1_ROUND
+#undef JHC_SHA1_5ROUNDS
+#undef JHC_SHA1_20ROUNDS
+
+#ifdef JHC_X86_INTRINSICS
+inline uint32_t RoundConstant(int t) {
+    return t < 20 ? 0x5A827999 : t < 40 ? 0x6ED9EBA1 : t < 60 ? 0x8F1BBCDC : 0xCA62C1D6;
+}
+
+JHC_TARGET("ssse3")
+inline __m128i Rol1(__m128i x) {
+    return _mm_or_si128(_mm_slli_epi32(x, 1), _mm_srli_epi32(x, 31));
+}
+
+// W[t..t+3] from w0..w3 = W[t-16..t-1]: W[t] = rol1(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]).
+// W[t+3] depends on W[t], so lane 3 is computed without it first and fixed up after.
+//
+JHC_TARGET("ssse3")
+inline __m128i Schedule(__m128i w0, __m128i w1, __m128i w2, __m128i w3) {
+    const __m128i x = Rol1(_mm_xor_si128(_mm_xor_si128(_mm_srli_si128(w3, 4), w2),
+                                         _mm_xor_si128(_mm_alignr_epi8(w1, w0, 8), w0)));
+    return _mm_xor_si128(x, Rol1(_mm_slli_si128(x, 12)));
+}
+
+JHC_TARGET("ssse3")
+inline void TransformSsse3(uint32_t state[5], const unsigned char* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    alignas(16) uint32_t wk[80];
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i w[4];
+        for (int i = 0; i < 4; i++) {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), bswap);
+            _mm_store_si128((__m128i*)(wk + i * 4), _mm_add_epi32(w[i], _mm_set1_epi32((int)RoundConstant(0))));
+        }
+        for (int t = 16; t < 80; t += 4) {
+            const __m128i next = Schedule(w[0], w[1], w[2], w[3]);
+            _mm_store_si128((__m128i*)(wk + t), _mm_add_epi32(next, _mm_set1_epi32((int)RoundConstant(t))));
+            w[0] = w[1];
+            w[1] = w[2];
+            w[2] = w[3];
+            w[3] = next;
+        }
+        RoundsWk(state, wk);
+    }
+}
+
+JHC_TARGET("avx2")
+inline __m256i Rol1(__m256i x) {
+    return _mm256_or_si256(_mm256_slli_epi32(x, 1), _mm256_srli_epi32(x, 31));
+}
+
+// Same as above for two blocks, one per 128-bit lane.
+//
+JHC_TARGET("avx2")
+inline __m256i Schedule(__m256i w0, __m256i w1, __m256i w2, __m256i w3) {
+    const __m256i x = Rol1(_mm256_xor_si256(_mm256_xor_si256(_mm256_srli_si256(w3, 4), w2),
+                                            _mm256_xor_si256(_mm256_alignr_epi8(w1, w0, 8), w0)));
+    return _mm256_xor_si256(x, Rol1(_mm256_slli_si256(x, 12)));
+}
+
+JHC_TARGET("avx2,bmi2")
+inline void TransformAvx2(uint32_t state[5], const unsigned char* data, size_t blocks) {
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    alignas(32) uint32_t wk[2][80];
+
+    for (; blocks >= 2; blocks -= 2, data += 128) {
+        __m256i w[4];
+        for (int i = 0; i < 4; i++) {
+            const __m128i lo = _mm_loadu_si128((const __m128i*)(data + i * 16));
+            const __m128i hi = _mm_loadu_si128((const __m128i*)(data + 64 + i * 16));
+            w[i] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), bswap);
+            const __m256i x = _mm256_add_epi32(w[i], _mm256_set1_epi32((int)RoundConstant(0)));
+            _mm_store_si128((__m128i*)(wk[0] + i * 4), _mm256_castsi256_si128(x));
+            _mm_store_si128((__m128i*)(wk[1] + i * 4), _mm256_extracti128_si256(x, 1));
+        }
+        for (int t = 16; t < 80; t += 4) {
+            const __m256i next = Schedule(w[0], w[1], w[2], w[3]);
+            const __m256i x = _mm256_add_epi32(next, _mm256_set1_epi32((int)RoundConstant(t)));
+            _mm_store_si128((__m128i*)(wk[0] + t), _mm256_castsi256_si128(x));
+            _mm_store_si128((__m128i*)(wk[1] + t), _mm256_extracti128_si256(x, 1));
+            w[0] = w[1];
+            w[1] = w[2];
+            w[2] = w[3];
+            w[3] = next;
+        }
+        RoundsWk(state, wk[0]);
+        RoundsWk(state, wk[1]);
+    }
+    if (blocks > 0)
+        TransformSsse3(state, data, blocks);
+}
+
+// Four rounds of the SHA extensions, with m0 the message words of these rounds. Also advances the
+// message schedule of the following rounds: m1 is completed, m2 and m3 get their next terms.
+//
+#define JHC_SHA1_NI_4ROUNDS(f, eIn, eOut, m0, m1, m2, m3) \
+    eIn = _mm_sha1nexte_epu32(eIn, m0);                   \
+    eOut = abcd;                                          \
+    m1 = _mm_sha1msg2_epu32(m1, m0);                      \
+    abcd = _mm_sha1rnds4_epu32(abcd, eIn, f);             \
+    m3 = _mm_sha1msg1_epu32(m3, m0);                      \
+    m2 = _mm_xor_si128(m2, m0)
+
+JHC_TARGET("sha,sse4.1,ssse3")
+inline void TransformShaNi(uint32_t state[5], const unsigned char* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+    __m128i e1;
+
+    for (; blocks > 0; blocks--, data += 64) {
+        const __m128i abcdSave = abcd;
+        const __m128i eSave = e0;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), bswap);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), bswap);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), bswap);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), bswap);
+
+        // Rounds 0-15, the message words are the block itself.
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        m0 = _mm_sha1msg1_epu32(m0, m1);
+
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        m1 = _mm_sha1msg1_epu32(m1, m2);
+        m0 = _mm_xor_si128(m0, m2);
+
+        JHC_SHA1_NI_4ROUNDS(0, e1, e0, m3, m0, m1, m2);
+
+        // Rounds 16-67.
+        JHC_SHA1_NI_4ROUNDS(0, e0, e1, m0, m1, m2, m3);
+        JHC_SHA1_NI_4ROUNDS(1, e1, e0, m1, m2, m3, m0);
+        JHC_SHA1_NI_4ROUNDS(1, e0, e1, m2, m3, m0, m1);
+        JHC_SHA1_NI_4ROUNDS(1, e1, e0, m3, m0, m1, m2);
+        JHC_SHA1_NI_4ROUNDS(1, e0, e1, m0, m1, m2, m3);
+        JHC_SHA1_NI_4ROUNDS(1, e1, e0, m1, m2, m3, m0);
+        JHC_SHA1_NI_4ROUNDS(2, e0, e1, m2, m3, m0, m1);
+        JHC_SHA1_NI_4ROUNDS(2, e1, e0, m3, m0, m1, m2);
+        JHC_SHA1_NI_4ROUNDS(2, e0, e1, m0, m1, m2, m3);
+        JHC_SHA1_NI_4ROUNDS(2, e1, e0, m1, m2, m3, m0);
+        JHC_SHA1_NI_4ROUNDS(2, e0, e1, m2, m3, m0, m1);
+        JHC_SHA1_NI_4ROUNDS(3, e1, e0, m3, m0, m1, m2);
+        JHC_SHA1_NI_4ROUNDS(3, e0, e1, m0, m1, m2, m3);
+
+        // Rounds 68-79, the schedule is complete.
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        m3 = _mm_xor_si128(m3, m1);
+
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, eSave);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#undef JHC_SHA1_NI_4ROUNDS
+#endif
+}  // namespace sha1_detail
+}  // namespace jhc
+
+JHC_INLINE void jhc::SHA1::transform(uint32_t state[5], const unsigned char* data, size_t blocks) {
+    switch (kernel_) {
+#ifdef JHC_X86_INTRINSICS
+        case Kernel::Ssse3:
+            return sha1_detail::TransformSsse3(state, data, blocks);
+        case Kernel::Avx2:
+            return sha1_detail::TransformAvx2(state, data, blocks);
+        case Kernel::ShaNi:
+            return sha1_detail::TransformShaNi(state, data, blocks);
+#endif
+        default:
+            return sha1_detail::TransformScalar(state, data, blocks);
+    }
+}
+
+JHC_INLINE bool jhc::SHA1::IsKernelSupported(Kernel kernel) {
+#ifdef JHC_X86_INTRINSICS
+    const CpuFeatures& cpu = CpuFeatures::Get();
+    switch (kernel) {
+        case Kernel::Ssse3:
+            return cpu.ssse3;
+        case Kernel::Avx2:
+            return cpu.ssse3 && cpu.avx2 && cpu.bmi2;
+        case Kernel::ShaNi:
+            return cpu.ssse3 && cpu.sse41 && cpu.sha;
+        default:
+            return true;
+    }
+#else
+    return kernel == Kernel::Scalar;
+#endif
+}
+
+JHC_INLINE jhc::SHA1::Kernel jhc::SHA1::ActiveKernel() {
+    for (Kernel kernel : {Kernel::ShaNi, Kernel::Avx2, Kernel::Ssse3}) {
+        if (IsKernelSupported(kernel))
+            return kernel;
+    }
+    return Kernel::Scalar;
 }
\ No newline at end of file
@@ -5,6 +5,13 @@
 #endif
 #include "jhc/arch.hpp"
 #include "jhc/file.hpp"
+#include "jhc/cpu_features.hpp"
+#include "jhc/hex_encode.hpp"
+#include "jhc/impl/multi_buffer_hash.hpp"
+#include <vector>
+#ifdef JHC_X86_INTRINSICS
+#include <immintrin.h>
+#endif
 
 #define SHA256_DIGEST_SIZE 32
 #define SHA256_DATA_SIZE 64
@@ -12,13 +19,6 @@
 /* Digest is kept internally as 8 32-bit words. */
 #define _SHA256_DIGEST_LENGTH 8
 
-typedef struct sha256_ctx {
-    uint32_t state[_SHA256_DIGEST_LENGTH]; /* State variables */
-    uint32_t count_low, count_high;        /* 64-bit block count */
-    unsigned char block[SHA256_DATA_SIZE]; /* SHA256 data buffer */
-    uint32_t index;                        /* index into buffer */
-} SHA256_CTX;
-
 /* A block, treated as a sequence of 32-bit words. */
 #define SHA256_DATA_LENGTH 16
 
@@ -60,18 +60,15 @@ typedef struct sha256_ctx {
     ((((((EXTRACT_UCHAR(s) << 8) | EXTRACT_UCHAR(s + 1)) << 8) | EXTRACT_UCHAR(s + 2)) << 8) | \
      EXTRACT_UCHAR(s + 3))
 
-class jhc::SHA256::Private {
-   public:
-    SHA256_CTX ctx_;
-};
-
-JHC_INLINE jhc::SHA256::SHA256() :
-    p_(new jhc::SHA256::Private()) {
+JHC_INLINE jhc::SHA256::SHA256() {
+    static const Kernel kernel = ActiveKernel();
+    kernel_ = kernel;
+    init();
 }
 
-JHC_INLINE jhc::SHA256::~SHA256() {
-    delete p_;
-    p_ = nullptr;
+JHC_INLINE jhc::SHA256::SHA256(Kernel kernel) :
+    kernel_(kernel) {
+    init();
 }
 
 /* Initialize the SHA values */
@@ -88,87 +85,72 @@ JHC_INLINE void jhc::SHA256::init() {
         0x5be0cd19UL,
     };
 
-    memcpy(p_->ctx_.state, H0, sizeof(H0));
+    memcpy(ctx_.state, H0, sizeof(H0));
 
     /* Initialize bit count */
-    p_->ctx_.count_low = p_->ctx_.count_high = 0;
+    ctx_.count_low = ctx_.count_high = 0;
 
     /* Initialize buffer */
-    p_->ctx_.index = 0;
+    ctx_.index = 0;
 }
 
-JHC_INLINE void jhc::SHA256::update(const unsigned char* buffer, uint32_t length) {
-    uint32_t left;
+JHC_INLINE void jhc::SHA256::update(const void* data, size_t length) {
+    const unsigned char* buffer = (const unsigned char*)data;
+    size_t left;
 
-    if (p_->ctx_.index) { /* Try to fill partial block */
-        left = SHA256_DATA_SIZE - p_->ctx_.index;
+    if (ctx_.index) { /* Try to fill partial block */
+        left = SHA256_DATA_SIZE - ctx_.index;
         if (length < left) {
-            memcpy(p_->ctx_.block + p_->ctx_.index, buffer, length);
-            p_->ctx_.index += length;
+            memcpy(ctx_.block + ctx_.index, buffer, length);
+            ctx_.index += (uint32_t)length;
             return; /* Finished */
         }
         else {
-            memcpy(p_->ctx_.block + p_->ctx_.index, buffer, left);
-            sha256_block(p_->ctx_.block);
+            memcpy(ctx_.block + ctx_.index, buffer, left);
+            sha256_blocks(ctx_.block, 1);
             buffer += left;
             length -= left;
         }
     }
-    while (length >= SHA256_DATA_SIZE) {
-        sha256_block(buffer);
-        buffer += SHA256_DATA_SIZE;
-        length -= SHA256_DATA_SIZE;
+    const size_t blocks = length / SHA256_DATA_SIZE;
+    if (blocks > 0) {
+        sha256_blocks(buffer, blocks);
+        buffer += blocks * SHA256_DATA_SIZE;
+        length -= blocks * SHA256_DATA_SIZE;
     }
     /* Buffer leftovers */
     /* NOTE: The corresponding sha1 code checks for the special case length == 0.
         * That seems supoptimal, as I suspect it increases the number of branches. */
 
-    memcpy(p_->ctx_.block, buffer, length);
-    p_->ctx_.index = length;
+    memcpy(ctx_.block, buffer, length);
+    ctx_.index = (uint32_t)length;
 }
 
 /* Final wrapup - pad to SHA1_DATA_SIZE-byte boundary with the bit pattern
       1 0* (64-bit count of bits processed, MSB-first) */
 
 JHC_INLINE void jhc::SHA256::final() {
-    uint32_t data[SHA256_DATA_LENGTH];
-    uint32_t i;
-    uint32_t words;
+    unsigned char* block = ctx_.block;
+    uint32_t i = ctx_.index;
 
-    i = p_->ctx_.index;
+    /* There are 512 = 2^9 bits in one block */
+    const uint64_t bits = ((((uint64_t)ctx_.count_high << 32) | ctx_.count_low) << 9) | (ctx_.index << 3);
 
     /* Set the first char of padding to 0x80.  This is safe since there is
         always at least one byte free */
+    block[i++] = 0x80;
 
-    /*  assert(i < SHA256_DATA_SIZE);
-          */
-    p_->ctx_.block[i++] = 0x80;
-
-    /* Fill rest of word */
-    for (; i & 3; i++)
-        p_->ctx_.block[i] = 0;
-
-    /* i is now a multiple of the word size 4 */
-    words = i >> 2;
-    for (i = 0; i < words; i++)
-        data[i] = STRING2INT(p_->ctx_.block + 4 * i);
-
-    if (words > (SHA256_DATA_LENGTH - 2)) { /* No room for length in this block. Process it and
+    if (i > SHA256_DATA_SIZE - 8) { /* No room for length in this block. Process it and
                             * pad with another one */
-        for (i = words; i < SHA256_DATA_LENGTH; i++)
-            data[i] = 0;
-        sha256_transform(p_->ctx_.state, data);
-        for (i = 0; i < (SHA256_DATA_LENGTH - 2); i++)
-            data[i] = 0;
+        memset(block + i, 0, SHA256_DATA_SIZE - i);
+        sha256_blocks(block, 1);
+        i = 0;
     }
-    else
-        for (i = words; i < SHA256_DATA_LENGTH - 2; i++)
-            data[i] = 0;
+    memset(block + i, 0, SHA256_DATA_SIZE - 8 - i);
 
-    /* There are 512 = 2^9 bits in one block */
-    data[SHA256_DATA_LENGTH - 2] = (p_->ctx_.count_high << 9) | (p_->ctx_.count_low >> 23);
-    data[SHA256_DATA_LENGTH - 1] = (p_->ctx_.count_low << 9) | (p_->ctx_.index << 3);
-    sha256_transform(p_->ctx_.state, data);
+    for (i = 0; i < 8; i++)
+        block[SHA256_DATA_SIZE - 8 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256_blocks(block, 1);
 }
 
 JHC_INLINE void jhc::SHA256::digest(unsigned char* s) {
@@ -176,32 +158,24 @@ JHC_INLINE void jhc::SHA256::digest(unsigned char* s) {
 
     if (s != NULL)
         for (i = 0; i < _SHA256_DIGEST_LENGTH; i++) {
-            *s++ = p_->ctx_.state[i] >> 24;
-            *s++ = 0xff & (p_->ctx_.state[i] >> 16);
-            *s++ = 0xff & (p_->ctx_.state[i] >> 8);
-            *s++ = 0xff & p_->ctx_.state[i];
+            *s++ = ctx_.state[i] >> 24;
+            *s++ = 0xff & (ctx_.state[i] >> 16);
+            *s++ = 0xff & (ctx_.state[i] >> 8);
+            *s++ = 0xff & ctx_.state[i];
         }
 }
 
 JHC_INLINE std::string jhc::SHA256::digest() {
-    uint32_t i;
-    unsigned int digest[32] = {0};
-    unsigned int* s = digest;
-
-    for (i = 0; i < _SHA256_DIGEST_LENGTH; i++) {
-        *s++ = p_->ctx_.state[i] >> 24;
-        *s++ = 0xff & (p_->ctx_.state[i] >> 16);
-        *s++ = 0xff & (p_->ctx_.state[i] >> 8);
-        *s++ = 0xff & p_->ctx_.state[i];
-    }
+    unsigned char raw[SHA256_DIGEST_SIZE];
+    digest(raw);
+    return HexEncode::Encode((const char*)raw, sizeof(raw));
+}
 
-    std::string strSHA256;
-    for (int p = 0; p < 32; p++) {
-        char buf[10] = {0};
-        snprintf(buf, sizeof(buf), "%02x", digest[p]);
-        strSHA256.append(std::string(buf));
-    }
-    return strSHA256;
+JHC_INLINE jhc::SHA256::Digest jhc::SHA256::finalize() {
+    final();
+    Digest result;
+    digest(result.data());
+    return result;
 }
 
 JHC_INLINE std::string jhc::SHA256::GetFileSHA256(const jhc::fs::path& filePath) {
@@ -216,10 +190,10 @@ JHC_INLINE std::string jhc::SHA256::GetFileSHA256(const jhc::fs::path& filePath)
     sha256.init();
 
     size_t dwReadBytes = 0;
-    unsigned char szData[1024] = {0};
+    std::vector<unsigned char> szData(1024 * 1024);
 
-    while ((dwReadBytes = file.readFrom(szData, 1024, -1)) > 0) {
-        sha256.update(szData, dwReadBytes);
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        sha256.update(szData.data(), dwReadBytes);
     }
     file.close();
 
@@ -231,45 +205,13 @@ JHC_INLINE std::string jhc::SHA256::GetFileSHA256(const jhc::fs::path& filePath)
 
 JHC_INLINE std::string jhc::SHA256::GetDataSHA256(const unsigned char* data, size_t dataSize) {
     SHA256 sha256;
-    sha256.init();
-
-    size_t offset = 0;
-    while (offset < dataSize) {
-        unsigned int needRead = 10240;
-        if (offset + needRead > dataSize)
-            needRead = dataSize - offset;
-
-        sha256.update(data + offset, needRead);
-        offset += needRead;
-    }
-
-    sha256.final();
-
-    return sha256.digest();
+    sha256.update(data, dataSize);
+    return DigestToHex(sha256.finalize());
 }
 
-JHC_INLINE void jhc::SHA256::sha256_block(const unsigned char* block) {
-    uint32_t data[SHA256_DATA_LENGTH];
-    uint16_t i;
-
-    /* Update block count */
-    if (!++p_->ctx_.count_low)
-        ++p_->ctx_.count_high;
-
-    /* Endian independent conversion */
-    for (i = 0; i < SHA256_DATA_LENGTH; i++, block += 4)
-        data[i] = STRING2INT(block);
-
-    sha256_transform(p_->ctx_.state, data);
-}
-
-/* Perform the SHA transformation.  Note that this code, like MD5, seems to
-      break some optimizing compilers due to the complexity of the expressions
-      and the size of the basic block.  It may be necessary to split it into
-      sections, e.g. based on the four subrounds
-
-      Note that this function destroys the data area */
-JHC_INLINE void jhc::SHA256::sha256_transform(uint32_t* state, uint32_t* data) {
+namespace jhc {
+namespace sha256_detail {
+inline const uint32_t* RoundConstants() {
     static const uint32_t K[64] = {
         0x428a2f98UL,
         0x71374491UL,
@@ -336,6 +278,320 @@ JHC_INLINE void jhc::SHA256::sha256_transform(uint32_t* state, uint32_t* data) {
         0xbef9a3f7UL,
         0xc67178f2UL,
     };
+    return K;
+}
+
+// The 64 rounds, with W[t] + K[t] already computed in wk.
+//
+inline void RoundsWk(uint32_t state[8], const uint32_t wk[64]) {
+    uint32_t A = state[0], B = state[1], C = state[2], D = state[3];
+    uint32_t E = state[4], F = state[5], G = state[6], H = state[7];
+
+    for (int i = 0; i < 64; i += 8, wk += 8) {
+        ROUND(A, B, C, D, E, F, G, H, wk[0], 0);
+        ROUND(H, A, B, C, D, E, F, G, wk[1], 0);
+        ROUND(G, H, A, B, C, D, E, F, wk[2], 0);
+        ROUND(F, G, H, A, B, C, D, E, wk[3], 0);
+        ROUND(E, F, G, H, A, B, C, D, wk[4], 0);
+        ROUND(D, E, F, G, H, A, B, C, wk[5], 0);
+        ROUND(C, D, E, F, G, H, A, B, wk[6], 0);
+        ROUND(B, C, D, E, F, G, H, A, wk[7], 0);
+    }
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+    state[5] += F;
+    state[6] += G;
+    state[7] += H;
+}
+
+#ifdef JHC_X86_INTRINSICS
+JHC_TARGET("ssse3")
+inline __m128i ScheduleSigma0(__m128i x) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25)),
+                                       _mm_or_si128(_mm_srli_epi32(x, 18), _mm_slli_epi32(x, 14))),
+                         _mm_srli_epi32(x, 3));
+}
+
+JHC_TARGET("ssse3")
+inline __m128i ScheduleSigma1(__m128i x) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_or_si128(_mm_srli_epi32(x, 17), _mm_slli_epi32(x, 15)),
+                                       _mm_or_si128(_mm_srli_epi32(x, 19), _mm_slli_epi32(x, 13))),
+                         _mm_srli_epi32(x, 10));
+}
+
+// W[t..t+3] from w0..w3 = W[t-16..t-1]: W[t] = sigma1(W[t-2]) + W[t-7] + sigma0(W[t-15]) + W[t-16].
+// W[t+2] and W[t+3] depend on W[t] and W[t+1], so lanes 2 and 3 get their sigma1 term last.
+//
+JHC_TARGET("ssse3")
+inline __m128i Schedule(__m128i w0, __m128i w1, __m128i w2, __m128i w3) {
+    __m128i x = _mm_add_epi32(_mm_add_epi32(w0, ScheduleSigma0(_mm_alignr_epi8(w1, w0, 4))), _mm_alignr_epi8(w3, w2, 4));
+    x = _mm_add_epi32(x, ScheduleSigma1(_mm_srli_si128(w3, 8)));
+    return _mm_add_epi32(x, ScheduleSigma1(_mm_slli_si128(x, 8)));
+}
+
+JHC_TARGET("ssse3")
+inline void TransformSsse3(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const uint32_t* K = RoundConstants();
+    alignas(16) uint32_t wk[64];
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i w[4];
+        for (int i = 0; i < 4; i++) {
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + i * 16)), bswap);
+            _mm_store_si128((__m128i*)(wk + i * 4), _mm_add_epi32(w[i], _mm_loadu_si128((const __m128i*)(K + i * 4))));
+        }
+        for (int t = 16; t < 64; t += 4) {
+            const __m128i next = Schedule(w[0], w[1], w[2], w[3]);
+            _mm_store_si128((__m128i*)(wk + t), _mm_add_epi32(next, _mm_loadu_si128((const __m128i*)(K + t))));
+            w[0] = w[1];
+            w[1] = w[2];
+            w[2] = w[3];
+            w[3] = next;
+        }
+        RoundsWk(state, wk);
+    }
+}
+
+JHC_TARGET("avx2")
+inline __m256i ScheduleSigma0(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(_mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25)),
+                                             _mm256_or_si256(_mm256_srli_epi32(x, 18), _mm256_slli_epi32(x, 14))),
+                            _mm256_srli_epi32(x, 3));
+}
+
+JHC_TARGET("avx2")
+inline __m256i ScheduleSigma1(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(_mm256_or_si256(_mm256_srli_epi32(x, 17), _mm256_slli_epi32(x, 15)),
+                                             _mm256_or_si256(_mm256_srli_epi32(x, 19), _mm256_slli_epi32(x, 13))),
+                            _mm256_srli_epi32(x, 10));
+}
+
+// Same as above for two blocks, one per 128-bit lane.
+//
+JHC_TARGET("avx2")
+inline __m256i Schedule(__m256i w0, __m256i w1, __m256i w2, __m256i w3) {
+    __m256i x = _mm256_add_epi32(_mm256_add_epi32(w0, ScheduleSigma0(_mm256_alignr_epi8(w1, w0, 4))), _mm256_alignr_epi8(w3, w2, 4));
+    x = _mm256_add_epi32(x, ScheduleSigma1(_mm256_srli_si256(w3, 8)));
+    return _mm256_add_epi32(x, ScheduleSigma1(_mm256_slli_si256(x, 8)));
+}
+
+JHC_TARGET("avx2,bmi2")
+inline void TransformAvx2(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const uint32_t* K = RoundConstants();
+    alignas(32) uint32_t wk[2][64];
+
+    for (; blocks >= 2; blocks -= 2, data += 128) {
+        __m256i w[4];
+        for (int i = 0; i < 4; i++) {
+            const __m128i lo = _mm_loadu_si128((const __m128i*)(data + i * 16));
+            const __m128i hi = _mm_loadu_si128((const __m128i*)(data + 64 + i * 16));
+            w[i] = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), bswap);
+            const __m256i x = _mm256_add_epi32(w[i], _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(K + i * 4))));
+            _mm_store_si128((__m128i*)(wk[0] + i * 4), _mm256_castsi256_si128(x));
+            _mm_store_si128((__m128i*)(wk[1] + i * 4), _mm256_extracti128_si256(x, 1));
+        }
+        for (int t = 16; t < 64; t += 4) {
+            const __m256i next = Schedule(w[0], w[1], w[2], w[3]);
+            const __m256i x = _mm256_add_epi32(next, _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(K + t))));
+            _mm_store_si128((__m128i*)(wk[0] + t), _mm256_castsi256_si128(x));
+            _mm_store_si128((__m128i*)(wk[1] + t), _mm256_extracti128_si256(x, 1));
+            w[0] = w[1];
+            w[1] = w[2];
+            w[2] = w[3];
+            w[3] = next;
+        }
+        RoundsWk(state, wk[0]);
+        RoundsWk(state, wk[1]);
+    }
+    if (blocks > 0)
+        TransformSsse3(state, data, blocks);
+}
+
+#define JHC_SHA256_ROTR8(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+JHC_TARGET("avx2")
+inline __m256i BigSigma0x8(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(JHC_SHA256_ROTR8(x, 2), JHC_SHA256_ROTR8(x, 13)), JHC_SHA256_ROTR8(x, 22));
+}
+
+JHC_TARGET("avx2")
+inline __m256i BigSigma1x8(__m256i x) {
+    return _mm256_xor_si256(_mm256_xor_si256(JHC_SHA256_ROTR8(x, 6), JHC_SHA256_ROTR8(x, 11)), JHC_SHA256_ROTR8(x, 25));
+}
+
+#define JHC_SHA256_ROUND8(a, b, c, d, e, f, g, h, t)                                                     \
+    {                                                                                                    \
+        const __m256i ch = _mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g)));             \
+        const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))); \
+        const __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, BigSigma1x8(e)),                        \
+                                            _mm256_add_epi32(ch, _mm256_add_epi32(w[(t)&15], _mm256_set1_epi32((int)K[t])))); \
+        d = _mm256_add_epi32(d, t1);                                                                     \
+        h = _mm256_add_epi32(t1, _mm256_add_epi32(BigSigma0x8(a), maj));                                \
+    }
+
+// One block of 8 independent messages, lane l of state[i] is word i of message l.
+//
+JHC_TARGET("avx2")
+inline void Transform8Avx2(uint32_t state[8][8], const unsigned char* const blocks[8]) {
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const uint32_t* K = RoundConstants();
+    __m256i w[16];
+    multi_buffer_detail::LoadBlocks8(blocks, w);
+    for (int i = 0; i < 16; i++)
+        w[i] = _mm256_shuffle_epi8(w[i], bswap);
+
+    __m256i v[8];
+    for (int i = 0; i < 8; i++)
+        v[i] = _mm256_load_si256((const __m256i*)state[i]);
+    __m256i A = v[0], B = v[1], C = v[2], D = v[3], E = v[4], F = v[5], G = v[6], H = v[7];
+
+    for (int t = 0; t < 64; t += 8) {
+        if (t >= 16) {
+            for (int i = t; i < t + 8; i++) {
+                const __m256i x = _mm256_add_epi32(w[(i - 16) & 15], ScheduleSigma0(w[(i - 15) & 15]));
+                w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(x, w[(i - 7) & 15]), ScheduleSigma1(w[(i - 2) & 15]));
+            }
+        }
+        JHC_SHA256_ROUND8(A, B, C, D, E, F, G, H, t);
+        JHC_SHA256_ROUND8(H, A, B, C, D, E, F, G, t + 1);
+        JHC_SHA256_ROUND8(G, H, A, B, C, D, E, F, t + 2);
+        JHC_SHA256_ROUND8(F, G, H, A, B, C, D, E, t + 3);
+        JHC_SHA256_ROUND8(E, F, G, H, A, B, C, D, t + 4);
+        JHC_SHA256_ROUND8(D, E, F, G, H, A, B, C, t + 5);
+        JHC_SHA256_ROUND8(C, D, E, F, G, H, A, B, t + 6);
+        JHC_SHA256_ROUND8(B, C, D, E, F, G, H, A, t + 7);
+    }
+
+    const __m256i out[8] = {A, B, C, D, E, F, G, H};
+    for (int i = 0; i < 8; i++)
+        _mm256_store_si256((__m256i*)state[i], _mm256_add_epi32(v[i], out[i]));
+}
+
+#undef JHC_SHA256_ROTR8
+#undef JHC_SHA256_ROUND8
+
+// Four rounds of the SHA extensions on the message words m (W[t..t+3]).
+//
+#define JHC_SHA256_NI_4ROUNDS(t, m)                                                \
+    msg = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)(K + (t))));           \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                          \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E))
+
+// Completes the message words after cur, from the words before it (prev).
+//
+#define JHC_SHA256_NI_MSG2(cur, prev, next) \
+    next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)), cur)
+
+#define JHC_SHA256_NI_STEP(t, cur, prev, next) \
+    JHC_SHA256_NI_4ROUNDS(t, cur);             \
+    JHC_SHA256_NI_MSG2(cur, prev, next);       \
+    prev = _mm_sha256msg1_epu32(prev, cur)
+
+JHC_TARGET("sha,sse4.1,ssse3")
+inline void TransformShaNi(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const uint32_t* K = RoundConstants();
+
+    // The instructions keep the state as ABEF and CDGH.
+    const __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xB1);
+    const __m128i hgfe = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(dcba, hgfe, 8);
+    __m128i state1 = _mm_blend_epi16(hgfe, dcba, 0xF0);
+    __m128i msg;
+
+    for (; blocks > 0; blocks--, data += 64) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), bswap);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16)), bswap);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 32)), bswap);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 48)), bswap);
+
+        JHC_SHA256_NI_4ROUNDS(0, m0);
+        JHC_SHA256_NI_4ROUNDS(4, m1);
+        m0 = _mm_sha256msg1_epu32(m0, m1);
+        JHC_SHA256_NI_4ROUNDS(8, m2);
+        m1 = _mm_sha256msg1_epu32(m1, m2);
+
+        JHC_SHA256_NI_STEP(12, m3, m2, m0);
+        JHC_SHA256_NI_STEP(16, m0, m3, m1);
+        JHC_SHA256_NI_STEP(20, m1, m0, m2);
+        JHC_SHA256_NI_STEP(24, m2, m1, m3);
+        JHC_SHA256_NI_STEP(28, m3, m2, m0);
+        JHC_SHA256_NI_STEP(32, m0, m3, m1);
+        JHC_SHA256_NI_STEP(36, m1, m0, m2);
+        JHC_SHA256_NI_STEP(40, m2, m1, m3);
+        JHC_SHA256_NI_STEP(44, m3, m2, m0);
+        JHC_SHA256_NI_STEP(48, m0, m3, m1);
+
+        JHC_SHA256_NI_4ROUNDS(52, m1);
+        JHC_SHA256_NI_MSG2(m1, m0, m2);
+        JHC_SHA256_NI_4ROUNDS(56, m2);
+        JHC_SHA256_NI_MSG2(m2, m1, m3);
+        JHC_SHA256_NI_4ROUNDS(60, m3);
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    const __m128i feba = _mm_shuffle_epi32(state0, 0x1B);
+    const __m128i dchg = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#undef JHC_SHA256_NI_4ROUNDS
+#undef JHC_SHA256_NI_MSG2
+#undef JHC_SHA256_NI_STEP
+#endif
+}  // namespace sha256_detail
+}  // namespace jhc
+
+JHC_INLINE void jhc::SHA256::sha256_blocks(const unsigned char* data, size_t blocks) {
+    /* Update block count */
+    const uint64_t count = (((uint64_t)ctx_.count_high << 32) | ctx_.count_low) + blocks;
+    ctx_.count_low = (uint32_t)count;
+    ctx_.count_high = (uint32_t)(count >> 32);
+
+    switch (kernel_) {
+#ifdef JHC_X86_INTRINSICS
+        case Kernel::Ssse3:
+            return sha256_detail::TransformSsse3(ctx_.state, data, blocks);
+        case Kernel::Avx2:
+            return sha256_detail::TransformAvx2(ctx_.state, data, blocks);
+        case Kernel::ShaNi:
+            return sha256_detail::TransformShaNi(ctx_.state, data, blocks);
+#endif
+        default:
+            break;
+    }
+
+    uint32_t words[SHA256_DATA_LENGTH];
+    for (; blocks > 0; blocks--) {
+        /* Endian independent conversion */
+        for (int i = 0; i < SHA256_DATA_LENGTH; i++, data += 4)
+            words[i] = STRING2INT(data);
+
+        sha256_transform(ctx_.state, words);
+    }
+}
+
+/* Perform the SHA transformation.  Note that this code, like MD5, seems to
+      break some optimizing compilers due to the complexity of the expressions
+      and the size of the basic block.  It may be necessary to split it into
+      sections, e.g. based on the four subrounds
+
+      Note that this function destroys the data area */
+JHC_INLINE void jhc::SHA256::sha256_transform(uint32_t* state, uint32_t* data) {
+    const uint32_t* K = sha256_detail::RoundConstants();
 
     uint32_t A, B, C, D, E, F, G, H; /* Local vars */
     unsigned char i;
@@ -394,4 +650,88 @@ JHC_INLINE void jhc::SHA256::sha256_transform(uint32_t* state, uint32_t* data) {
     state[5] += F;
     state[6] += G;
     state[7] += H;
+}
+
+JHC_INLINE bool jhc::SHA256::IsKernelSupported(Kernel kernel) {
+#ifdef JHC_X86_INTRINSICS
+    const CpuFeatures& cpu = CpuFeatures::Get();
+    switch (kernel) {
+        case Kernel::Ssse3:
+            return cpu.ssse3;
+        case Kernel::Avx2:
+            return cpu.ssse3 && cpu.avx2 && cpu.bmi2;
+        case Kernel::ShaNi:
+            return cpu.ssse3 && cpu.sse41 && cpu.sha;
+        default:
+            return true;
+    }
+#else
+    return kernel == Kernel::Scalar;
+#endif
+}
+
+JHC_INLINE jhc::SHA256::Kernel jhc::SHA256::ActiveKernel() {
+    for (Kernel kernel : {Kernel::ShaNi, Kernel::Avx2, Kernel::Ssse3}) {
+        if (IsKernelSupported(kernel))
+            return kernel;
+    }
+    return Kernel::Scalar;
+}
+
+JHC_INLINE void jhc::SHA256::HashBatch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests) {
+    // A single SHA-NI stream is about twice as fast as 8 AVX2 lanes.
+    static const Kernel kernel = ActiveKernel();
+    HashBatch(data, sizes, count, digests, kernel);
+}
+
+JHC_INLINE void jhc::SHA256::HashBatch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests, Kernel kernel) {
+#ifdef JHC_X86_INTRINSICS
+    if (kernel == Kernel::Avx2 || kernel == Kernel::ShaNi) {
+        struct Lanes {
+            enum { kStateWords = 8,
+                   kDigestSize = 32,
+                   kBigEndian = 1 };
+
+            static void Init(uint32_t state[8]) {
+                static const uint32_t H0[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+                memcpy(state, H0, sizeof(H0));
+            }
+
+            static void Compress8(uint32_t state[8][8], const unsigned char* const blocks[8]) {
+                sha256_detail::Transform8Avx2(state, blocks);
+            }
+
+            static void Compress(uint32_t state[8], const unsigned char* data, size_t blocks) {
+                sha256_detail::TransformAvx2(state, data, blocks);
+            }
+
+            static void Digest(const uint32_t state[8], unsigned char* digest) {
+                for (int i = 0; i < 8; i++, digest += 4) {
+                    digest[0] = (unsigned char)(state[i] >> 24);
+                    digest[1] = (unsigned char)(state[i] >> 16);
+                    digest[2] = (unsigned char)(state[i] >> 8);
+                    digest[3] = (unsigned char)state[i];
+                }
+            }
+        };
+        struct ShaNiLanes : Lanes {
+            static void Compress(uint32_t state[8], const unsigned char* data, size_t blocks) {
+                sha256_detail::TransformShaNi(state, data, blocks);
+            }
+        };
+        if (kernel == Kernel::ShaNi)
+            multi_buffer_detail::Batch<ShaNiLanes>::RunSerial(data, sizes, count, digests);
+        else
+            multi_buffer_detail::Batch<Lanes>::Run(data, sizes, count, digests);
+        return;
+    }
+#endif
+
+    SHA256 sha256(kernel);
+    for (size_t i = 0; i < count; i++) {
+        sha256.init();
+        sha256.update(data[i], sizes[i]);
+        sha256.final();
+        sha256.digest(digests + kDigestSize * i);
+    }
 }
\ No newline at end of file
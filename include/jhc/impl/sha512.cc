@@ -4,6 +4,8 @@
 #include "../sha512.hpp"
 #endif
 #include "jhc/file.hpp"
+#include "jhc/hex_encode.hpp"
+#include <vector>
 
 namespace jhc {
 JHC_INLINE SHA512::uint64 SHA512::getSha512K(int i) {
@@ -60,13 +62,6 @@ JHC_INLINE SHA512::uint64 SHA512::getSha512K(int i) {
 #define SHA512_F2(x) (SHA2_ROTR(x, 14) ^ SHA2_ROTR(x, 18) ^ SHA2_ROTR(x, 41))
 #define SHA512_F3(x) (SHA2_ROTR(x, 1) ^ SHA2_ROTR(x, 8) ^ SHA2_SHFR(x, 7))
 #define SHA512_F4(x) (SHA2_ROTR(x, 19) ^ SHA2_ROTR(x, 61) ^ SHA2_SHFR(x, 6))
-#define SHA2_UNPACK32(x, str)                      \
-    {                                              \
-        *((str) + 3) = (SHA512::uint8)((x));       \
-        *((str) + 2) = (SHA512::uint8)((x) >> 8);  \
-        *((str) + 1) = (SHA512::uint8)((x) >> 16); \
-        *((str) + 0) = (SHA512::uint8)((x) >> 24); \
-    }
 #define SHA2_UNPACK64(x, str)                      \
     {                                              \
         *((str) + 7) = (SHA512::uint8)((x));       \
@@ -84,6 +79,10 @@ JHC_INLINE SHA512::uint64 SHA512::getSha512K(int i) {
         *(x) = ((SHA512::uint64) * ((str) + 7)) | ((SHA512::uint64) * ((str) + 6) << 8) | ((SHA512::uint64) * ((str) + 5) << 16) | ((SHA512::uint64) * ((str) + 4) << 24) | ((SHA512::uint64) * ((str) + 3) << 32) | ((SHA512::uint64) * ((str) + 2) << 40) | ((SHA512::uint64) * ((str) + 1) << 48) | ((SHA512::uint64) * ((str) + 0) << 56); \
     }
 
+JHC_INLINE SHA512::SHA512() {
+    init();
+}
+
 JHC_INLINE void SHA512::init() {
     m_h[0] = 0x6a09e667f3bcc908ULL;
     m_h[1] = 0xbb67ae8584caa73bULL;
@@ -97,15 +96,16 @@ JHC_INLINE void SHA512::init() {
     m_tot_len = 0;
 }
 
-JHC_INLINE void SHA512::update(const unsigned char* message, unsigned int len) {
-    unsigned int block_nb;
-    unsigned int new_len, rem_len, tmp_len;
+JHC_INLINE void SHA512::update(const void* data, size_t len) {
+    const unsigned char* message = (const unsigned char*)data;
+    size_t block_nb;
+    size_t new_len, rem_len, tmp_len;
     const unsigned char* shifted_message;
     tmp_len = SHA384_512_BLOCK_SIZE - m_len;
     rem_len = len < tmp_len ? len : tmp_len;
     memcpy(&m_block[m_len], message, rem_len);
     if (m_len + len < SHA384_512_BLOCK_SIZE) {
-        m_len += len;
+        m_len += (unsigned int)len;
         return;
     }
     new_len = len - rem_len;
@@ -115,34 +115,43 @@ JHC_INLINE void SHA512::update(const unsigned char* message, unsigned int len) {
     transform(shifted_message, block_nb);
     rem_len = new_len % SHA384_512_BLOCK_SIZE;
     memcpy(m_block, &shifted_message[block_nb << 7], rem_len);
-    m_len = rem_len;
-    m_tot_len += (block_nb + 1) << 7;
+    m_len = (unsigned int)rem_len;
+    m_tot_len += (uint64)(block_nb + 1) << 7;
 }
 
 JHC_INLINE void SHA512::final(unsigned char* digest) {
     unsigned int block_nb;
     unsigned int pm_len;
-    unsigned int len_b;
     int i;
     block_nb = 1 + ((SHA384_512_BLOCK_SIZE - 17) < (m_len % SHA384_512_BLOCK_SIZE));
-    len_b = (m_tot_len + m_len) << 3;
+    // The length field is 128 bits wide, the byte count shifted left by 3.
+    const uint64 total = m_tot_len + m_len;
+    const uint64 len_lo = total << 3;
+    const uint64 len_hi = total >> 61;
     pm_len = block_nb << 7;
     memset(m_block + m_len, 0, pm_len - m_len);
     m_block[m_len] = 0x80;
-    SHA2_UNPACK32(len_b, m_block + pm_len - 4);
+    SHA2_UNPACK64(len_hi, m_block + pm_len - 16);
+    SHA2_UNPACK64(len_lo, m_block + pm_len - 8);
     transform(m_block, block_nb);
     for (i = 0; i < 8; i++) {
         SHA2_UNPACK64(m_h[i], &digest[i << 3]);
     }
 }
 
-JHC_INLINE void SHA512::transform(const unsigned char* message, unsigned int block_nb) {
+JHC_INLINE SHA512::Digest SHA512::finalize() {
+    Digest digest;
+    final(digest.data());
+    return digest;
+}
+
+JHC_INLINE void SHA512::transform(const unsigned char* message, size_t block_nb) {
     SHA512::uint64 w[80];
     SHA512::uint64 wv[8];
     SHA512::uint64 t1, t2;
     const unsigned char* sub_block;
-    int i, j;
-    for (i = 0; i < (int)block_nb; i++) {
+    int j;
+    for (size_t i = 0; i < block_nb; i++) {
         sub_block = message + (i << 7);
         for (j = 0; j < 16; j++) {
             SHA2_PACK64(&sub_block[j << 3], &w[j]);
@@ -179,41 +188,22 @@ JHC_INLINE std::string SHA512::GetFileSHA512(const fs::path& filePath) {
         return result;
     }
 
-    unsigned char digest[SHA512::DIGEST_SIZE];
-    memset(digest, 0, SHA512::DIGEST_SIZE);
     SHA512 ctx;
-    ctx.init();
 
     size_t dwReadBytes = 0;
-    unsigned char szData[1024] = {0};
+    std::vector<unsigned char> szData(1024 * 1024);
 
-    while ((dwReadBytes = file.readFrom(szData, 1024, -1)) > 0) {
-        ctx.update(szData, dwReadBytes);
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        ctx.update(szData.data(), dwReadBytes);
     }
     file.close();
 
-    ctx.final(digest);
-
-    char buf[2 * SHA512::DIGEST_SIZE + 1];
-    buf[2 * SHA512::DIGEST_SIZE] = 0;
-    for (int i = 0; i < SHA512::DIGEST_SIZE; i++)
-        sprintf(buf + i * 2, "%02x", digest[i]);
-
-    return std::string(buf);
+    return DigestToHex(ctx.finalize());
 }
 
 JHC_INLINE std::string SHA512::GetDataSHA512(const unsigned char* data, size_t dataSize) {
-    unsigned char digest[SHA512::DIGEST_SIZE];
-    memset(digest, 0, SHA512::DIGEST_SIZE);
     SHA512 ctx;
-    ctx.init();
-    ctx.update((const unsigned char*)data, dataSize);
-    ctx.final(digest);
-
-    char buf[2 * SHA512::DIGEST_SIZE + 1];
-    buf[2 * SHA512::DIGEST_SIZE] = 0;
-    for (int i = 0; i < SHA512::DIGEST_SIZE; i++)
-        sprintf(buf + i * 2, "%02x", digest[i]);
-    return std::string(buf);
+    ctx.update(data, dataSize);
+    return DigestToHex(ctx.finalize());
 }
-}  // namespace jhc
\ No newline at end of file
+}  // namespace jhc
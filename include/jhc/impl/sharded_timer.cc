@@ -0,0 +1,91 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../sharded_timer.hpp"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace jhc {
+namespace sharded_timer_detail {
+// Translates the id of a shard into the id of the ShardedTimer before calling the user handler.
+struct GlobalIdHandler {
+    Timer::handler_t handler;
+    size_t shard;
+    size_t shardNum;
+
+    void operator()(size_t localId) {
+        handler(localId * shardNum + shard);
+    }
+};
+}  // namespace sharded_timer_detail
+}  // namespace jhc
+
+JHC_INLINE jhc::ShardedTimer::ShardedTimer(size_t shards, Timer::Backend backend, const std::chrono::microseconds& tick) {
+    if (shards == 0)
+        shards = std::max<size_t>(1, std::thread::hardware_concurrency());
+    shards_.reserve(shards);
+    for (size_t i = 0; i < shards; i++)
+        shards_.emplace_back(new Timer(backend, tick));
+}
+
+JHC_INLINE jhc::ShardedTimer::~ShardedTimer() {
+    shards_.clear();
+}
+
+JHC_INLINE size_t jhc::ShardedTimer::shardCount() const {
+    return shards_.size();
+}
+
+JHC_INLINE size_t jhc::ShardedTimer::currentShard() const {
+    // Threads are spread over the shards in the order they first add a timer.
+    static std::atomic<size_t> nextThread(0);
+    static thread_local size_t thread = nextThread++;
+    return thread % shards_.size();
+}
+
+JHC_INLINE size_t jhc::ShardedTimer::add(const time_point& when,
+                                         handler_t&& handler,
+                                         const std::chrono::microseconds& period,
+                                         const std::chrono::microseconds& slack) {
+    return addTo(currentShard(), when, std::move(handler), period, slack);
+}
+
+JHC_INLINE size_t jhc::ShardedTimer::addToShard(size_t key,
+                                                const time_point& when,
+                                                handler_t&& handler,
+                                                const std::chrono::microseconds& period,
+                                                const std::chrono::microseconds& slack) {
+    return addTo(key % shards_.size(), when, std::move(handler), period, slack);
+}
+
+JHC_INLINE bool jhc::ShardedTimer::remove(size_t id) {
+    return shards_[id % shards_.size()]->remove(id / shards_.size());
+}
+
+JHC_INLINE void jhc::ShardedTimer::setExecutor(Timer::executor_t executor) {
+    for (auto& shard : shards_)
+        shard->setExecutor(executor);
+}
+
+JHC_INLINE void jhc::ShardedTimer::setExecutor(ThreadPool& pool) {
+    for (auto& shard : shards_)
+        shard->setExecutor(pool);
+}
+
+JHC_INLINE void jhc::ShardedTimer::setMissedPolicy(Timer::Missed missed) {
+    for (auto& shard : shards_)
+        shard->setMissedPolicy(missed);
+}
+
+JHC_INLINE size_t jhc::ShardedTimer::addTo(size_t shard,
+                                           const time_point& when,
+                                           handler_t&& handler,
+                                           const std::chrono::microseconds& period,
+                                           const std::chrono::microseconds& slack) {
+    jhc::sharded_timer_detail::GlobalIdHandler global{std::move(handler), shard, shards_.size()};
+    const size_t localId = shards_[shard]->add(when, std::move(global), period, slack);
+    return localId * shards_.size() + shard;
+}
@@ -0,0 +1,207 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../size_class_pool.hpp"
+#endif
+
+namespace jhc {
+namespace size_class_pool_detail {
+// The central lists pack a pointer and an ABA tag into 64 bits.
+// On 64-bit platforms user space addresses fit in 48 bits, which leaves 16 bits for the tag.
+const unsigned int kPointerBits = sizeof(void*) == 8 ? 48 : 32;
+const uint64_t kPointerMask = (uint64_t(1) << kPointerBits) - 1;
+const size_t kChunkSize = 64 * 1024;
+}  // namespace size_class_pool_detail
+}  // namespace jhc
+
+JHC_INLINE jhc::SizeClassPool* jhc::SizeClassPool::Instance() {
+    // Intentionally never deleted: thread caches may still return memory while the process exits.
+    static SizeClassPool* pool = new SizeClassPool();
+    return pool;
+}
+
+JHC_INLINE jhc::SizeClassPool::SizeClassPool() :
+    reserved_bytes_(0) {
+    for (size_t i = 0; i < kClassNum; i++)
+        central_[i].head.store(0);
+}
+
+JHC_INLINE size_t jhc::SizeClassPool::ClassIndex(size_t bytes) {
+    if (bytes <= 128)
+        return bytes == 0 ? 0 : (bytes - 1) / 16;
+
+    // 2^p < bytes <= 2^(p+1), split into 4 steps.
+    size_t p = 7;
+    while (((bytes - 1) >> (p + 1)) != 0)
+        p++;
+    return 8 + (p - 7) * 4 + (((bytes - 1) - (size_t(1) << p)) >> (p - 2));
+}
+
+JHC_INLINE size_t jhc::SizeClassPool::ClassSize(size_t cls) {
+    if (cls < 8)
+        return (cls + 1) * 16;
+
+    const size_t p = 7 + (cls - 8) / 4;
+    return (size_t(1) << p) + ((cls - 8) % 4 + 1) * (size_t(1) << (p - 2));
+}
+
+JHC_INLINE size_t jhc::SizeClassPool::BatchSize(size_t cls) {
+    size_t n = 8192 / ClassSize(cls);
+    if (n < 2)
+        n = 2;
+    if (n > 64)
+        n = 64;
+    return n;
+}
+
+JHC_INLINE size_t jhc::SizeClassPool::reservedBytes() const {
+    return reserved_bytes_.load();
+}
+
+JHC_INLINE jhc::SizeClassPool::ThreadCache::ThreadCache() {
+    for (size_t i = 0; i < kClassNum; i++) {
+        heads[i] = nullptr;
+        counts[i] = 0;
+    }
+}
+
+JHC_INLINE jhc::SizeClassPool::ThreadCache::~ThreadCache() {
+    SizeClassPool* pool = SizeClassPool::Instance();
+    for (size_t i = 0; i < kClassNum; i++)
+        pool->releaseToCentral(i, heads[i], counts[i], 0);
+}
+
+JHC_INLINE jhc::SizeClassPool::ThreadCache& jhc::SizeClassPool::LocalCache() {
+    static thread_local ThreadCache cache;
+    return cache;
+}
+
+JHC_INLINE void jhc::SizeClassPool::pushBatch(size_t cls, FreeObject* first) noexcept {
+    using namespace size_class_pool_detail;
+    std::atomic<uint64_t>& head = central_[cls].head;
+    uint64_t old = head.load(std::memory_order_relaxed);
+    uint64_t desired = 0;
+    do {
+        first->nextBatch.store(static_cast<uintptr_t>(old & kPointerMask), std::memory_order_relaxed);
+        desired = ((old >> kPointerBits) + 1) << kPointerBits | static_cast<uint64_t>(reinterpret_cast<uintptr_t>(first));
+    } while (!head.compare_exchange_weak(old, desired, std::memory_order_release, std::memory_order_relaxed));
+}
+
+JHC_INLINE jhc::SizeClassPool::FreeObject* jhc::SizeClassPool::popBatch(size_t cls) noexcept {
+    using namespace size_class_pool_detail;
+    std::atomic<uint64_t>& head = central_[cls].head;
+    uint64_t old = head.load(std::memory_order_acquire);
+    FreeObject* first = nullptr;
+    uint64_t desired = 0;
+    do {
+        first = reinterpret_cast<FreeObject*>(static_cast<uintptr_t>(old & kPointerMask));
+        if (!first)
+            return nullptr;
+        // first may have been popped and reused by another thread meanwhile, but its memory is never unmapped,
+        // and the tag makes the CAS fail in that case. The relaxed atomic load keeps that read well-defined.
+        const uintptr_t next = first->nextBatch.load(std::memory_order_relaxed);
+        desired = ((old >> kPointerBits) + 1) << kPointerBits | static_cast<uint64_t>(next);
+    } while (!head.compare_exchange_weak(old, desired, std::memory_order_acquire, std::memory_order_acquire));
+
+    return first;
+}
+
+JHC_INLINE jhc::SizeClassPool::FreeObject* jhc::SizeClassPool::carveBatch(size_t cls) {
+    using namespace size_class_pool_detail;
+    std::lock_guard<std::mutex> lg(chunk_mutex_);
+
+    // another thread may have refilled the central list while we were waiting.
+    FreeObject* batch = popBatch(cls);
+    if (batch)
+        return batch;
+
+    const size_t size = ClassSize(cls);
+    const size_t batchSize = BatchSize(cls);
+    const size_t batchBytes = size * batchSize;
+    const size_t batchNum = kChunkSize >= batchBytes ? kChunkSize / batchBytes : 1;
+
+    char* chunk = static_cast<char*>(::operator new(batchNum * batchBytes));
+    chunks_.push_back(chunk);
+    reserved_bytes_ += batchNum * batchBytes;
+
+    for (size_t b = 0; b < batchNum; b++) {
+        char* base = chunk + b * batchBytes;
+        for (size_t i = 0; i < batchSize; i++) {
+            FreeObject* obj = ::new (base + i * size) FreeObject();
+            obj->next = (i + 1 < batchSize) ? reinterpret_cast<FreeObject*>(base + (i + 1) * size) : nullptr;
+        }
+
+        if (b == 0)
+            batch = reinterpret_cast<FreeObject*>(base);
+        else
+            pushBatch(cls, reinterpret_cast<FreeObject*>(base));
+    }
+
+    return batch;
+}
+
+// Move objects from a thread cache list to the central list until only keep objects are left.
+JHC_INLINE void jhc::SizeClassPool::releaseToCentral(size_t cls, FreeObject*& head, size_t& count, size_t keep) noexcept {
+    const size_t batchSize = BatchSize(cls);
+    while (count > keep) {
+        size_t n = count - keep;
+        if (n > batchSize)
+            n = batchSize;
+
+        FreeObject* first = head;
+        FreeObject* last = head;
+        for (size_t i = 1; i < n; i++)
+            last = last->next;
+
+        head = last->next;
+        last->next = nullptr;
+        count -= n;
+        pushBatch(cls, first);
+    }
+}
+
+JHC_INLINE void* jhc::SizeClassPool::allocate(size_t bytes) {
+    if (bytes > kMaxSmallSize)
+        return ::operator new(bytes);
+
+    const size_t cls = ClassIndex(bytes);
+    ThreadCache& cache = LocalCache();
+
+    FreeObject* obj = cache.heads[cls];
+    if (!obj) {
+        obj = popBatch(cls);
+        if (!obj)
+            obj = carveBatch(cls);
+
+        size_t n = 0;
+        for (FreeObject* p = obj; p; p = p->next)
+            n++;
+        cache.counts[cls] = n;
+    }
+
+    cache.heads[cls] = obj->next;
+    cache.counts[cls]--;
+    return obj;
+}
+
+JHC_INLINE void jhc::SizeClassPool::deallocate(void* p, size_t bytes) noexcept {
+    if (!p)
+        return;
+
+    if (bytes > kMaxSmallSize) {
+        ::operator delete(p);
+        return;
+    }
+
+    const size_t cls = ClassIndex(bytes);
+    ThreadCache& cache = LocalCache();
+
+    FreeObject* obj = reinterpret_cast<FreeObject*>(p);
+    obj->next = cache.heads[cls];
+    cache.heads[cls] = obj;
+    cache.counts[cls]++;
+
+    const size_t batchSize = BatchSize(cls);
+    if (cache.counts[cls] > 2 * batchSize)
+        releaseToCentral(cls, cache.heads[cls], cache.counts[cls], batchSize);
+}
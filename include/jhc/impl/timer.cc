@@ -4,16 +4,30 @@
 #include "../timer.hpp"
 #endif
 
+#include "jhc/thread_pool.hpp"
+
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <algorithm>
 #include <vector>
 #include <stack>
 #include <set>
+#include <memory>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace jhc {
 namespace timer_detail {
+using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+// Marks an event that is not linked into any timing wheel list.
+const std::size_t kNoLink = static_cast<std::size_t>(-1);
+const int kNoSlot = -1;
+
 // The event structure that holds the information about a timer.
 struct Event {
     std::size_t id;
@@ -21,17 +35,60 @@ struct Event {
     std::chrono::microseconds period;
     Timer::handler_t handler;
     bool valid;
+
+    // The next timeout of this event.
+    std::chrono::time_point<std::chrono::steady_clock> next;
+    // How late the event may fire.
+    std::chrono::microseconds slack;
+    // When the event is scheduled to fire, in [next, next + slack].
+    std::chrono::time_point<std::chrono::steady_clock> due;
+    // Waiting in the schedule (or in the ready list of the timing wheel).
+    bool scheduled;
+    // Number of handler invocations that have not returned yet.
+    std::size_t inflight;
+    // The handler, once it has been handed to an executor, which may run it concurrently with the timer thread.
+    std::shared_ptr<Timer::handler_t> shared;
+
+    // Intrusive list links, only used by the TimingWheel backend.
+    int slot;
+    std::size_t prev;
+    std::size_t succ;
+
     Event() :
         id(0),
         start(std::chrono::microseconds::zero()),
         period(std::chrono::microseconds::zero()),
         handler(nullptr),
-        valid(false) {
+        valid(false),
+        next(std::chrono::microseconds::zero()),
+        slack(std::chrono::microseconds::zero()),
+        due(std::chrono::microseconds::zero()),
+        scheduled(false),
+        inflight(0),
+        slot(kNoSlot),
+        prev(kNoLink),
+        succ(kNoLink) {
     }
 
     template <typename Func>
-    Event(std::size_t id, std::chrono::time_point<std::chrono::steady_clock> start, std::chrono::microseconds period, Func&& handler) :
-        id(id), start(start), period(period), handler(std::forward<Func>(handler)), valid(true) {
+    Event(std::size_t id,
+          std::chrono::time_point<std::chrono::steady_clock> start,
+          std::chrono::microseconds period,
+          std::chrono::microseconds slack,
+          Func&& handler) :
+        id(id),
+        start(start),
+        period(period),
+        handler(std::forward<Func>(handler)),
+        valid(true),
+        next(start),
+        slack(slack),
+        due(start),
+        scheduled(false),
+        inflight(0),
+        slot(kNoSlot),
+        prev(kNoLink),
+        succ(kNoLink) {
     }
 
     Event(Event&& r) = default;
@@ -49,6 +106,266 @@ struct Time_event {
 inline bool operator<(const Time_event& l, const Time_event& r) {
     return l.next < r.next;
 }
+
+// Picks the time in [next, next + slack] that is a multiple of the largest power of two nanoseconds not
+// above slack. Timers whose windows overlap end up on the same instant and expire together.
+inline time_point Coalesce(const time_point& next, const std::chrono::microseconds& slack) {
+    if (slack.count() <= 0)
+        return next;
+    const int64_t latest = std::chrono::duration_cast<std::chrono::nanoseconds>((next + slack).time_since_epoch()).count();
+    if (latest <= 0)
+        return next;
+    const uint64_t slackNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(slack).count();
+    uint64_t granularity = 1;
+    while (granularity <= slackNs / 2)
+        granularity <<= 1;
+    const time_point due(std::chrono::duration_cast<time_point::duration>(
+        std::chrono::nanoseconds((int64_t)((uint64_t)latest & ~(granularity - 1)))));
+    return due < next ? next : due;
+}
+
+inline int LowestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward64(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+inline int HighestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, v);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+// Hierarchical timing wheel over the events of a Timer.
+//
+// Time is divided into ticks counted from origin. A timer expiring at tick t is kept at the
+// level of the highest bit in which t differs from the current tick, in the slot given by
+// t's digit at that level. When the current tick reaches the start of a slot at a higher
+// level, that slot is cascaded into the lower levels; level 0 slots hold timers of a single tick.
+// Each slot is an intrusive doubly linked list threaded through the events vector, so
+// insert and unlink are O(1). A bitmap per level finds the next non-empty slot without
+// walking empty ticks, so the timer thread only wakes up when there is something to do.
+//
+class TimingWheel {
+   public:
+    enum {
+        kLevelBits = 6,
+        kSlots = 1 << kLevelBits,
+        kLevels = 6,
+        // Timers beyond the span of the wheel, re-examined each time the top level wraps around.
+        kOverflowList = kLevels * kSlots,
+        // Expired timers wait in this list until the timer thread invokes them.
+        kReadyList = kOverflowList + 1,
+        kListNum = kReadyList + 1,
+    };
+
+    TimingWheel(std::vector<Event>& events, const time_point& origin, const std::chrono::microseconds& tick) :
+        events_(events),
+        origin_(origin),
+        tick_(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(tick).count())),
+        current_(0),
+        pending_(0) {
+        std::fill(heads_, heads_ + kListNum, kNoLink);
+        std::fill(tails_, tails_ + kListNum, kNoLink);
+        std::fill(occupied_, occupied_ + kLevels, 0);
+    }
+
+    // No timer is waiting in the wheel or in the ready list.
+    //
+    bool empty() const {
+        return pending_ == 0 && heads_[kReadyList] == kNoLink;
+    }
+
+    // Schedules events_[id] at events_[id].due.
+    //
+    void insert(std::size_t id) {
+        uint64_t t = tickOf(events_[id].due);
+        if (t < current_)
+            t = current_;
+
+        const uint64_t diff = t ^ current_;
+        if (diff >> kSpanBits) {
+            link(id, kOverflowList);
+            pending_++;
+            return;
+        }
+
+        const int level = diff ? HighestBit(diff) / kLevelBits : 0;
+        const int digit = (int)((t >> (level * kLevelBits)) & (kSlots - 1));
+        link(id, level * kSlots + digit);
+        occupied_[level] |= uint64_t(1) << digit;
+        pending_++;
+    }
+
+    // Removes events_[id] from whatever list it is in. Returns false if it was not linked.
+    //
+    bool unlink(std::size_t id) {
+        Event& e = events_[id];
+        if (e.slot == kNoSlot)
+            return false;
+
+        const int slot = e.slot;
+        if (e.prev != kNoLink)
+            events_[e.prev].succ = e.succ;
+        else
+            heads_[slot] = e.succ;
+        if (e.succ != kNoLink)
+            events_[e.succ].prev = e.prev;
+        else
+            tails_[slot] = e.prev;
+
+        e.slot = kNoSlot;
+        e.prev = kNoLink;
+        e.succ = kNoLink;
+
+        if (slot != kReadyList) {
+            pending_--;
+            if (slot != kOverflowList && heads_[slot] == kNoLink)
+                occupied_[slot / kSlots] &= ~(uint64_t(1) << (slot % kSlots));
+        }
+        return true;
+    }
+
+    // Moves every timer that expired at or before now to the ready list.
+    //
+    void advance(const time_point& now) {
+        const uint64_t nowTick = floorTickOf(now);
+
+        while (pending_ > 0 && current_ <= nowTick) {
+            const uint64_t next = nextTick();
+            if (next > nowTick)
+                break;
+            current_ = next;
+
+            if ((current_ & kSpanMask) == 0)
+                cascade(kOverflowList);
+
+            // Cascade higher levels that start at this tick, highest first.
+            for (int level = kLevels - 1; level >= 1; level--) {
+                if (current_ & ((uint64_t(1) << (level * kLevelBits)) - 1))
+                    continue;
+                cascade(level * kSlots + digitOf(current_, level));
+            }
+
+            const int slot = digitOf(current_, 0);
+            while (heads_[slot] != kNoLink) {
+                const std::size_t id = heads_[slot];
+                unlink(id);
+                link(id, kReadyList);
+            }
+            current_++;
+        }
+
+        if (current_ <= nowTick)
+            current_ = nowTick + 1;
+    }
+
+    // Pops the oldest expired timer, or returns kNoLink.
+    //
+    std::size_t popReady() {
+        const std::size_t id = heads_[kReadyList];
+        if (id != kNoLink)
+            unlink(id);
+        return id;
+    }
+
+    // The time at which advance() will find the next expired timer, or cascade towards it.
+    // Only valid when pending timers exist.
+    //
+    time_point nextWakeup() const {
+        return origin_ + std::chrono::nanoseconds(nextTick() * tick_);
+    }
+
+   private:
+    static const int kSpanBits = kLevels * kLevelBits;
+    static const uint64_t kSpanMask = (uint64_t(1) << kSpanBits) - 1;
+
+    static int digitOf(uint64_t tick, int level) {
+        return (int)((tick >> (level * kLevelBits)) & (kSlots - 1));
+    }
+
+    // Rounded up, so that a timer never fires before its time.
+    uint64_t tickOf(const time_point& when) const {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when - origin_).count();
+        if (ns <= 0)
+            return 0;
+        return ((uint64_t)ns + tick_ - 1) / tick_;
+    }
+
+    uint64_t floorTickOf(const time_point& when) const {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when - origin_).count();
+        if (ns <= 0)
+            return 0;
+        return (uint64_t)ns / tick_;
+    }
+
+    // The first tick at which a non-empty slot has to be processed.
+    uint64_t nextTick() const {
+        uint64_t best = UINT64_MAX;
+        for (int level = 0; level < kLevels; level++) {
+            const uint64_t bits = occupied_[level] & (~uint64_t(0) << digitOf(current_, level));
+            if (!bits)
+                continue;
+            const int upperShift = (level + 1) * kLevelBits;
+            const uint64_t block = (current_ >> upperShift) << upperShift;
+            const uint64_t tick = std::max(current_, block | ((uint64_t)LowestBit(bits) << (level * kLevelBits)));
+            best = std::min(best, tick);
+        }
+        if (heads_[kOverflowList] != kNoLink) {
+            const uint64_t wrap = (current_ & kSpanMask) ? ((current_ >> kSpanBits) + 1) << kSpanBits : current_;
+            best = std::min(best, wrap);
+        }
+        return best;
+    }
+
+    // Re-inserts every timer of a list. The list is detached first, as timers may go back into it.
+    void cascade(int slot) {
+        std::size_t id = heads_[slot];
+        heads_[slot] = kNoLink;
+        tails_[slot] = kNoLink;
+        if (slot != kOverflowList)
+            occupied_[slot / kSlots] &= ~(uint64_t(1) << (slot % kSlots));
+
+        while (id != kNoLink) {
+            const std::size_t succ = events_[id].succ;
+            events_[id].slot = kNoSlot;
+            events_[id].prev = kNoLink;
+            events_[id].succ = kNoLink;
+            pending_--;
+            insert(id);
+            id = succ;
+        }
+    }
+
+    void link(std::size_t id, int slot) {
+        Event& e = events_[id];
+        e.slot = slot;
+        e.succ = kNoLink;
+        e.prev = tails_[slot];
+        if (tails_[slot] != kNoLink)
+            events_[tails_[slot]].succ = id;
+        else
+            heads_[slot] = id;
+        tails_[slot] = id;
+    }
+
+    std::vector<Event>& events_;
+    const time_point origin_;
+    const uint64_t tick_;  // nanoseconds
+    uint64_t current_;     // the next tick to process
+    std::size_t pending_;  // timers in the wheel, excluding the ready list
+    std::size_t heads_[kListNum];
+    std::size_t tails_[kListNum];
+    uint64_t occupied_[kLevels];
+};
 }  // namespace timer_detail
 
 class Timer::Private {
@@ -61,18 +378,231 @@ class Timer::Private {
     // Use to terminate the timer thread.
     bool done_ = false;
 
+    Backend backend_ = Backend::OrderedSet;
+
     // The vector that holds all active events.
     std::vector<timer_detail::Event> events_;
-    // Sorted queue that has the next timeout at its top.
+    // Sorted queue that has the next timeout at its top. Used by the OrderedSet backend.
     std::multiset<timer_detail::Time_event> time_events_;
+    // Used by the TimingWheel backend.
+    std::unique_ptr<timer_detail::TimingWheel> wheel_;
 
     // A list of ids to be re-used. If possible, ids are used from this pool.
     std::stack<std::size_t> free_ids_;
+
+    // Handlers run on the pool or the executor when one of them is set, on the timer thread otherwise.
+    ThreadPool* pool_ = nullptr;
+    std::shared_ptr<Timer::executor_t> executor_;
+    Missed missed_ = Missed::CatchUp;
+
+    // Number of handler invocations that have not returned yet.
+    std::size_t inflight_ = 0;
+
+    // When the timer thread wakes up next. add() only notifies it for timers due before that.
+    timer_detail::time_point wake_at_ = timer_detail::time_point::min();
+
+    // Bumped by remove(), so that a batch notices that one of its timers has been removed by an earlier handler.
+    std::atomic<uint64_t> removals_{0};
+
+    // Expired events and their handlers, reused by every batch of the timer thread.
+    struct Job {
+        std::size_t id;
+        std::shared_ptr<Timer::handler_t> shared;
+        Timer::handler_t handler;
+    };
+    std::vector<std::size_t> expired_;
+    std::vector<Job> jobs_;
+
+    void schedule(std::size_t id) {
+        timer_detail::Event& e = events_[id];
+        e.scheduled = true;
+        e.due = timer_detail::Coalesce(e.next, e.slack);
+        if (wheel_)
+            wheel_->insert(id);
+        else
+            time_events_.insert(timer_detail::Time_event{e.due, id});
+    }
+
+    // Removes a scheduled event, returns false if it is not scheduled (e.g. it is firing).
+    bool unschedule(std::size_t id) {
+        if (!events_[id].scheduled)
+            return false;
+        events_[id].scheduled = false;
+
+        if (wheel_)
+            return wheel_->unlink(id);
+
+        auto range = time_events_.equal_range(timer_detail::Time_event{events_[id].due, id});
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->ref == id) {
+                time_events_.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Frees the id of an event that is neither scheduled nor running.
+    void release(std::size_t id) {
+        timer_detail::Event& e = events_[id];
+        e.valid = false;
+        e.handler = nullptr;
+        e.shared.reset();
+        free_ids_.push(id);
+    }
+
+    // Called when a handler invocation returns.
+    void finish(std::size_t id) {
+        timer_detail::Event& e = events_[id];
+        e.inflight--;
+        inflight_--;
+        // The event is either no longer valid because it was removed in the
+        // callback, or it is a one-shot timer.
+        if (e.inflight == 0 && !e.scheduled)
+            release(id);
+    }
+
+    // Takes an expired event out of the schedule: a periodic event is rescheduled before its handler runs,
+    // so the handler duration does not shift it. Returns false if the invocation is dropped (Missed::Skip).
+    bool expire(std::size_t id, const timer_detail::time_point& now) {
+        timer_detail::Event& e = events_[id];
+        e.scheduled = false;
+        const bool busy = e.inflight > 0;
+
+        if (e.valid && e.period.count() > 0) {
+            e.next += e.period;
+            if (missed_ == Missed::Skip && e.next <= now)
+                e.next += e.period * ((now - e.next) / e.period + 1);
+            schedule(id);
+        }
+
+        if (busy && missed_ == Missed::Skip)
+            return false;
+        e.inflight++;
+        inflight_++;
+        return true;
+    }
+
+    // Invokes the handler of a single expired event on the timer thread, without the batch bookkeeping,
+    // so that a lone timer (e.g. one added when already due) fires as soon as the thread sees it.
+    void fireOne(std::size_t id, std::unique_lock<std::mutex>& lock) {
+        if (!expire(id, std::chrono::steady_clock::now()))
+            return;
+
+        // The handler is moved out, so that add() growing events_ meanwhile can not invalidate it.
+        timer_detail::Event& e = events_[id];
+        std::shared_ptr<Timer::handler_t> shared = e.shared;
+        Timer::handler_t handler;
+        if (!shared)
+            handler = std::move(e.handler);
+        lock.unlock();
+        if (shared)
+            (*shared)(id);
+        else
+            handler(id);
+        lock.lock();
+
+        if (!shared)
+            events_[id].handler = std::move(handler);
+        finish(id);
+    }
+
+    // Invokes the handlers of all events in expired_, which have already been taken out of the schedule.
+    // The lock is released once for the whole batch.
+    void fireExpired(std::unique_lock<std::mutex>& lock) {
+        const bool dispatch = pool_ || executor_;
+        if (expired_.size() == 1 && !dispatch) {
+            const std::size_t id = expired_.front();
+            expired_.clear();
+            fireOne(id, lock);
+            return;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        jobs_.clear();
+        for (std::size_t id : expired_) {
+            if (!expire(id, now))
+                continue;
+
+            timer_detail::Event& e = events_[id];
+            Job job;
+            job.id = id;
+            if (dispatch && !e.shared)
+                e.shared = std::make_shared<Timer::handler_t>(std::move(e.handler));
+            if (e.shared)
+                job.shared = e.shared;
+            else
+                // Moved out, so that add() growing events_ meanwhile can not invalidate it.
+                job.handler = std::move(e.handler);
+            jobs_.push_back(std::move(job));
+        }
+        expired_.clear();
+        if (jobs_.empty())
+            return;
+
+        if (dispatch) {
+            ThreadPool* pool = pool_;
+            std::shared_ptr<Timer::executor_t> executor = executor_;
+            lock.unlock();
+            for (Job& job : jobs_) {
+                const std::size_t id = job.id;
+                std::shared_ptr<Timer::handler_t> handler = std::move(job.shared);
+                auto task = [this, id, handler]() {
+                    (*handler)(id);
+                    std::lock_guard<std::mutex> lg(m_);
+                    finish(id);
+                    if (done_ && inflight_ == 0)
+                        cond_.notify_all();
+                };
+                if (pool)
+                    pool->post(std::move(task));
+                else
+                    (*executor)(std::move(task));
+            }
+            jobs_.clear();
+            lock.lock();
+            return;
+        }
+
+        // Run on the timer thread.
+        uint64_t removals = removals_.load();
+        lock.unlock();
+        for (Job& job : jobs_) {
+            if (removals_.load() != removals) {
+                // A handler of this batch removed some timer, skip the job if it was this one.
+                lock.lock();
+                removals = removals_.load();
+                const bool valid = events_[job.id].valid;
+                lock.unlock();
+                if (!valid)
+                    continue;
+            }
+            if (job.shared)
+                (*job.shared)(job.id);
+            else
+                job.handler(job.id);
+        }
+        lock.lock();
+
+        for (Job& job : jobs_) {
+            if (!job.shared)
+                events_[job.id].handler = std::move(job.handler);
+            finish(job.id);
+        }
+        jobs_.clear();
+    }
 };
 
 JHC_INLINE Timer::Timer() :
+    Timer(Backend::OrderedSet) {
+}
+
+JHC_INLINE Timer::Timer(Backend backend, const std::chrono::microseconds& tick) :
     p_(new Private()) {
     std::unique_lock<std::mutex> lock(p_->m_);
+    p_->backend_ = backend;
+    if (backend == Backend::TimingWheel)
+        p_->wheel_.reset(new timer_detail::TimingWheel(p_->events_, std::chrono::steady_clock::now(), tick));
     p_->worker_ = std::thread([this] { run(); });
 }
 
@@ -82,6 +612,13 @@ JHC_INLINE Timer::~Timer() {
     lock.unlock();
     p_->cond_.notify_all();
     p_->worker_.join();
+
+    // Wait for the handlers that are still running on an executor.
+    lock.lock();
+    p_->cond_.wait(lock, [this] { return p_->inflight_ == 0; });
+    lock.unlock();
+
+    p_->wheel_.reset();
     p_->events_.clear();
     p_->time_events_.clear();
     while (!p_->free_ids_.empty()) {
@@ -92,33 +629,67 @@ JHC_INLINE Timer::~Timer() {
     p_ = nullptr;
 }
 
+JHC_INLINE Timer::Backend Timer::backend() const {
+    return p_->backend_;
+}
+
+JHC_INLINE void Timer::setExecutor(executor_t executor) {
+    std::lock_guard<std::mutex> lg(p_->m_);
+    p_->pool_ = nullptr;
+    if (executor)
+        p_->executor_ = std::make_shared<executor_t>(std::move(executor));
+    else
+        p_->executor_.reset();
+}
+
+JHC_INLINE void Timer::setExecutor(ThreadPool& pool) {
+    std::lock_guard<std::mutex> lg(p_->m_);
+    p_->executor_.reset();
+    p_->pool_ = &pool;
+}
+
+JHC_INLINE void Timer::setMissedPolicy(Missed missed) {
+    std::lock_guard<std::mutex> lg(p_->m_);
+    p_->missed_ = missed;
+}
+
 JHC_INLINE std::size_t Timer::add(
     const std::chrono::time_point<std::chrono::steady_clock>& when,
     handler_t&& handler,
-    const std::chrono::microseconds& period) {
+    const std::chrono::microseconds& period,
+    const std::chrono::microseconds& slack) {
     std::unique_lock<std::mutex> lock(p_->m_);
     std::size_t id = 0;
     // Add a new event.
     // Prefer an existing and free id. If none is available, add a new one.
     if (p_->free_ids_.empty()) {
         id = p_->events_.size();
-        timer_detail::Event e(id, when, period, std::move(handler));
+        timer_detail::Event e(id, when, period, slack, std::move(handler));
         p_->events_.push_back(std::move(e));
     }
     else {
         id = p_->free_ids_.top();
         p_->free_ids_.pop();
-        timer_detail::Event e(id, when, period, std::move(handler));
+        timer_detail::Event e(id, when, period, slack, std::move(handler));
         p_->events_[id] = std::move(e);
     }
-    p_->time_events_.insert(timer_detail::Time_event{when, id});
+    p_->schedule(id);
+    // Only wake up the timer thread if it sleeps past the new timeout.
+    const bool notify = p_->events_[id].due < p_->wake_at_;
     lock.unlock();
-    p_->cond_.notify_all();
+    if (notify)
+        p_->cond_.notify_all();
     return id;
 }
 
-JHC_INLINE std::size_t Timer::add(const uint64_t afterMicroseconds, handler_t&& handler, const uint64_t periodMicroseconds) {
-    return add(std::chrono::microseconds(afterMicroseconds), std::move(handler), std::chrono::microseconds(periodMicroseconds));
+JHC_INLINE std::size_t Timer::add(const uint64_t afterMicroseconds,
+                                  handler_t&& handler,
+                                  const uint64_t periodMicroseconds,
+                                  const uint64_t slackMicroseconds) {
+    return add(std::chrono::microseconds(afterMicroseconds),
+               std::move(handler),
+               std::chrono::microseconds(periodMicroseconds),
+               std::chrono::microseconds(slackMicroseconds));
 }
 
 JHC_INLINE bool Timer::remove(std::size_t id) {
@@ -127,52 +698,54 @@ JHC_INLINE bool Timer::remove(std::size_t id) {
         return false;
     }
     p_->events_[id].valid = false;
-    auto it = std::find_if(p_->time_events_.begin(), p_->time_events_.end(),
-                           [&](const timer_detail::Time_event& te) { return te.ref == id; });
-    if (it != p_->time_events_.end()) {
-        p_->free_ids_.push(it->ref);
-        p_->time_events_.erase(it);
+    p_->removals_++;
+    if (p_->unschedule(id) && p_->events_[id].inflight == 0) {
+        p_->release(id);
     }
-    lock.unlock();
-    p_->cond_.notify_all();
+    // The timer thread is not woken up, it finds nothing to do if this was its next timeout.
     return true;
 }
 
 JHC_INLINE void Timer::run() {
+    using timer_detail::time_point;
     std::unique_lock<std::mutex> lock(p_->m_);
 
     while (!p_->done_) {
-        if (p_->time_events_.empty()) {
-            // Wait for work
-            p_->cond_.wait(lock);
+        const time_point now = std::chrono::steady_clock::now();
+        time_point wakeAt = time_point::max();
+
+        // Collect everything that is due and fire it in one batch.
+        if (p_->wheel_) {
+            timer_detail::TimingWheel& wheel = *p_->wheel_;
+            if (!wheel.empty()) {
+                wheel.advance(now);
+                for (std::size_t id = wheel.popReady(); id != timer_detail::kNoLink; id = wheel.popReady())
+                    p_->expired_.push_back(id);
+                if (p_->expired_.empty())
+                    wakeAt = wheel.nextWakeup();
+            }
         }
         else {
-            timer_detail::Time_event te = *(p_->time_events_.begin());
-            if (std::chrono::steady_clock::now() >= te.next) {
-                // Remove time event
+            while (!p_->time_events_.empty() && p_->time_events_.begin()->next <= now) {
+                p_->expired_.push_back(p_->time_events_.begin()->ref);
                 p_->time_events_.erase(p_->time_events_.begin());
-
-                // Invoke the handler
-                lock.unlock();
-                p_->events_[te.ref].handler(te.ref);
-                lock.lock();
-
-                if (p_->events_[te.ref].valid && p_->events_[te.ref].period.count() > 0) {
-                    // The event is valid and a periodic timer.
-                    te.next += p_->events_[te.ref].period;
-                    p_->time_events_.insert(te);
-                }
-                else {
-                    // The event is either no longer valid because it was removed in the
-                    // callback, or it is a one-shot timer.
-                    p_->events_[te.ref].valid = false;
-                    p_->free_ids_.push(te.ref);
-                }
-            }
-            else {
-                p_->cond_.wait_until(lock, te.next);
             }
+            if (p_->expired_.empty() && !p_->time_events_.empty())
+                wakeAt = p_->time_events_.begin()->next;
         }
+
+        if (!p_->expired_.empty()) {
+            p_->fireExpired(lock);
+            continue;
+        }
+
+        // Wait for work
+        p_->wake_at_ = wakeAt;
+        if (wakeAt == time_point::max())
+            p_->cond_.wait(lock);
+        else
+            p_->cond_.wait_until(lock, wakeAt);
+        p_->wake_at_ = time_point::min();
     }
 }
-}  // namespace jhc
\ No newline at end of file
+}  // namespace jhc
@@ -0,0 +1,754 @@
+#include "jhc/config.hpp"
+
+#ifdef JHC_NOT_HEADER_ONLY
+#include "../xxhash.hpp"
+#endif
+#include "jhc/file.hpp"
+#include "jhc/arch.hpp"
+#include "jhc/cpu_features.hpp"
+#include <string.h>
+#include <vector>
+#ifdef JHC_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace jhc {
+namespace xxhash_detail {
+const uint32_t kPrime32_1 = 0x9E3779B1U;
+const uint32_t kPrime32_2 = 0x85EBCA77U;
+const uint32_t kPrime32_3 = 0xC2B2AE3DU;
+const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+const uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+const uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+const size_t kStripeLen = 64;
+const size_t kSecretSize = 192;
+const size_t kSecretConsumeRate = 8;                                          // secret bytes per stripe
+const size_t kStripesPerBlock = (kSecretSize - kStripeLen) / kSecretConsumeRate;  // then the accumulators are scrambled
+const size_t kBlockLen = kStripeLen * kStripesPerBlock;
+const size_t kBufferSize = sizeof(State::buffer);
+const size_t kSecretLastAccStart = 7;
+const size_t kSecretMergeAccsStart = 11;
+const size_t kMidSizeMax = 240;  // longer inputs go through the stripes
+const size_t kMidSizeStartOffset = 3;
+const size_t kMidSizeLastOffset = 17;
+const size_t kSecretSizeMin = 136;
+
+inline const unsigned char* DefaultSecret() {
+    static const unsigned char kSecret[kSecretSize] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+    return kSecret;
+}
+
+inline uint32_t Swap32(uint32_t x) {
+    return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) | ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+inline uint64_t Swap64(uint64_t x) {
+    return ((uint64_t)Swap32((uint32_t)x) << 32) | Swap32((uint32_t)(x >> 32));
+}
+
+inline uint32_t Read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#ifdef JHC_ARCH_BIG_ENDIAN
+    v = Swap32(v);
+#endif
+    return v;
+}
+
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#ifdef JHC_ARCH_BIG_ENDIAN
+    v = Swap64(v);
+#endif
+    return v;
+}
+
+inline void Write64(unsigned char* p, uint64_t v) {
+#ifdef JHC_ARCH_BIG_ENDIAN
+    v = Swap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+inline uint64_t Rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint32_t Rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+// The 128-bit product of a and b, the high half in *high.
+inline uint64_t Mul64To128(uint64_t a, uint64_t b, uint64_t* high) {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = (unsigned __int128)a * b;
+    *high = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, high);
+#else
+    const uint64_t loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    const uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+    const uint64_t loHi = (a & 0xFFFFFFFF) * (b >> 32);
+    const uint64_t hiHi = (a >> 32) * (b >> 32);
+    const uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    *high = (hiLo >> 32) + (cross >> 32) + hiHi;
+    return (cross << 32) | (loLo & 0xFFFFFFFF);
+#endif
+}
+
+inline uint64_t Mul128Fold64(uint64_t a, uint64_t b) {
+    uint64_t high;
+    const uint64_t low = Mul64To128(a, b, &high);
+    return low ^ high;
+}
+
+inline uint64_t XXH64Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= kPrime64_2;
+    h ^= h >> 29;
+    h *= kPrime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= kPrimeMx1;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t Rrmxmx(uint64_t h, uint64_t len) {
+    h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+    h *= kPrimeMx2;
+    h ^= (h >> 35) + len;
+    h *= kPrimeMx2;
+    return h ^ (h >> 28);
+}
+
+inline uint64_t Mix16B(const unsigned char* input, const unsigned char* secret, uint64_t seed) {
+    return Mul128Fold64(Read64(input) ^ (Read64(secret) + seed), Read64(input + 8) ^ (Read64(secret + 8) - seed));
+}
+
+// Inputs of at most kMidSizeMax bytes, 64-bit.
+//
+inline uint64_t Hash64Short(const unsigned char* input, size_t len, const unsigned char* secret, uint64_t seed) {
+    if (len == 0)
+        return XXH64Avalanche(seed ^ (Read64(secret + 56) ^ Read64(secret + 64)));
+
+    if (len <= 3) {
+        const uint32_t combined = ((uint32_t)input[0] << 16) | ((uint32_t)input[len >> 1] << 24) | (uint32_t)input[len - 1] |
+                                  ((uint32_t)len << 8);
+        const uint64_t bitflip = (Read32(secret) ^ Read32(secret + 4)) + seed;
+        return XXH64Avalanche((uint64_t)combined ^ bitflip);
+    }
+
+    if (len <= 8) {
+        seed ^= (uint64_t)Swap32((uint32_t)seed) << 32;
+        const uint64_t bitflip = (Read64(secret + 8) ^ Read64(secret + 16)) - seed;
+        const uint64_t input64 = Read32(input + len - 4) + ((uint64_t)Read32(input) << 32);
+        return Rrmxmx(input64 ^ bitflip, len);
+    }
+
+    if (len <= 16) {
+        const uint64_t bitflip1 = (Read64(secret + 24) ^ Read64(secret + 32)) + seed;
+        const uint64_t bitflip2 = (Read64(secret + 40) ^ Read64(secret + 48)) - seed;
+        const uint64_t lo = Read64(input) ^ bitflip1;
+        const uint64_t hi = Read64(input + len - 8) ^ bitflip2;
+        return Avalanche(len + Swap64(lo) + hi + Mul128Fold64(lo, hi));
+    }
+
+    uint64_t acc = len * kPrime64_1;
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += Mix16B(input + 48, secret + 96, seed);
+                    acc += Mix16B(input + len - 64, secret + 112, seed);
+                }
+                acc += Mix16B(input + 32, secret + 64, seed);
+                acc += Mix16B(input + len - 48, secret + 80, seed);
+            }
+            acc += Mix16B(input + 16, secret + 32, seed);
+            acc += Mix16B(input + len - 32, secret + 48, seed);
+        }
+        acc += Mix16B(input, secret, seed);
+        acc += Mix16B(input + len - 16, secret + 16, seed);
+        return Avalanche(acc);
+    }
+
+    const size_t rounds = len / 16;
+    for (size_t i = 0; i < 8; i++)
+        acc += Mix16B(input + 16 * i, secret + 16 * i, seed);
+    acc = Avalanche(acc);
+    for (size_t i = 8; i < rounds; i++)
+        acc += Mix16B(input + 16 * i, secret + 16 * (i - 8) + kMidSizeStartOffset, seed);
+    acc += Mix16B(input + len - 16, secret + kSecretSizeMin - kMidSizeLastOffset, seed);
+    return Avalanche(acc);
+}
+
+inline void Mix32B(uint64_t acc[2], const unsigned char* input1, const unsigned char* input2, const unsigned char* secret, uint64_t seed) {
+    acc[0] += Mix16B(input1, secret, seed);
+    acc[0] ^= Read64(input2) + Read64(input2 + 8);
+    acc[1] += Mix16B(input2, secret + 16, seed);
+    acc[1] ^= Read64(input1) + Read64(input1 + 8);
+}
+
+// Inputs of at most kMidSizeMax bytes, 128-bit.
+//
+inline XXH3Hash128::Value Hash128Short(const unsigned char* input, size_t len, const unsigned char* secret, uint64_t seed) {
+    XXH3Hash128::Value h;
+    if (len == 0) {
+        h.low = XXH64Avalanche(seed ^ (Read64(secret + 64) ^ Read64(secret + 72)));
+        h.high = XXH64Avalanche(seed ^ (Read64(secret + 80) ^ Read64(secret + 88)));
+        return h;
+    }
+
+    if (len <= 3) {
+        const uint32_t combinedLow = ((uint32_t)input[0] << 16) | ((uint32_t)input[len >> 1] << 24) | (uint32_t)input[len - 1] |
+                                     ((uint32_t)len << 8);
+        const uint32_t combinedHigh = Rotl32(Swap32(combinedLow), 13);
+        const uint64_t bitflipLow = (Read32(secret) ^ Read32(secret + 4)) + seed;
+        const uint64_t bitflipHigh = (Read32(secret + 8) ^ Read32(secret + 12)) - seed;
+        h.low = XXH64Avalanche((uint64_t)combinedLow ^ bitflipLow);
+        h.high = XXH64Avalanche((uint64_t)combinedHigh ^ bitflipHigh);
+        return h;
+    }
+
+    if (len <= 8) {
+        seed ^= (uint64_t)Swap32((uint32_t)seed) << 32;
+        const uint64_t input64 = Read32(input) + ((uint64_t)Read32(input + len - 4) << 32);
+        const uint64_t bitflip = (Read64(secret + 16) ^ Read64(secret + 24)) + seed;
+        uint64_t high;
+        uint64_t low = Mul64To128(input64 ^ bitflip, kPrime64_1 + (len << 2), &high);
+        high += low << 1;
+        low ^= high >> 3;
+        low ^= low >> 35;
+        low *= kPrimeMx2;
+        low ^= low >> 28;
+        h.low = low;
+        h.high = Avalanche(high);
+        return h;
+    }
+
+    if (len <= 16) {
+        const uint64_t bitflipLow = (Read64(secret + 32) ^ Read64(secret + 40)) - seed;
+        const uint64_t bitflipHigh = (Read64(secret + 48) ^ Read64(secret + 56)) + seed;
+        const uint64_t inputLow = Read64(input);
+        uint64_t inputHigh = Read64(input + len - 8);
+        uint64_t mHigh;
+        uint64_t mLow = Mul64To128(inputLow ^ inputHigh ^ bitflipLow, kPrime64_1, &mHigh);
+        mLow += (uint64_t)(len - 1) << 54;
+        inputHigh ^= bitflipHigh;
+        mHigh += inputHigh + (uint64_t)(uint32_t)inputHigh * (kPrime32_2 - 1);
+        mLow ^= Swap64(mHigh);
+        uint64_t hHigh;
+        const uint64_t hLow = Mul64To128(mLow, kPrime64_2, &hHigh);
+        hHigh += mHigh * kPrime64_2;
+        h.low = Avalanche(hLow);
+        h.high = Avalanche(hHigh);
+        return h;
+    }
+
+    uint64_t acc[2] = {len * kPrime64_1, 0};
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96)
+                    Mix32B(acc, input + 48, input + len - 64, secret + 96, seed);
+                Mix32B(acc, input + 32, input + len - 48, secret + 64, seed);
+            }
+            Mix32B(acc, input + 16, input + len - 32, secret + 32, seed);
+        }
+        Mix32B(acc, input, input + len - 16, secret, seed);
+    }
+    else {
+        const size_t rounds = len / 32;
+        for (size_t i = 0; i < 4; i++)
+            Mix32B(acc, input + 32 * i, input + 32 * i + 16, secret + 32 * i, seed);
+        acc[0] = Avalanche(acc[0]);
+        acc[1] = Avalanche(acc[1]);
+        for (size_t i = 4; i < rounds; i++)
+            Mix32B(acc, input + 32 * i, input + 32 * i + 16, secret + kMidSizeStartOffset + 32 * (i - 4), seed);
+        Mix32B(acc, input + len - 16, input + len - 32, secret + kSecretSizeMin - kMidSizeLastOffset - 16, 0 - seed);
+    }
+    h.low = Avalanche(acc[0] + acc[1]);
+    h.high = 0 - Avalanche(acc[0] * kPrime64_1 + acc[1] * kPrime64_4 + (len - seed) * kPrime64_2);
+    return h;
+}
+
+// Long inputs: 8 accumulators take 64-byte stripes, each against the secret shifted by 8 more
+// bytes, and are scrambled after every block of kStripesPerBlock stripes.
+//
+inline void InitAccumulators(uint64_t acc[8]) {
+    const uint64_t init[8] = {kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1};
+    memcpy(acc, init, sizeof(init));
+}
+
+inline void InitSecret(unsigned char secret[kSecretSize], uint64_t seed) {
+    const unsigned char* def = DefaultSecret();
+    for (size_t i = 0; i < kSecretSize; i += 16) {
+        Write64(secret + i, Read64(def + i) + seed);
+        Write64(secret + i + 8, Read64(def + i + 8) - seed);
+    }
+}
+
+inline void AccumulateScalar(uint64_t acc[8], const unsigned char* input, const unsigned char* secret, size_t stripes) {
+    for (size_t s = 0; s < stripes; s++, input += kStripeLen, secret += kSecretConsumeRate) {
+        for (size_t i = 0; i < 8; i++) {
+            const uint64_t data = Read64(input + 8 * i);
+            const uint64_t key = data ^ Read64(secret + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+        }
+    }
+}
+
+inline void ScrambleScalar(uint64_t acc[8], const unsigned char* secret) {
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= Read64(secret + 8 * i);
+        acc[i] = a * kPrime32_1;
+    }
+}
+
+#ifdef JHC_X86_INTRINSICS
+JHC_TARGET("sse2")
+inline void AccumulateSse2(uint64_t acc[8], const unsigned char* input, const unsigned char* secret, size_t stripes) {
+    __m128i a[4];
+    for (int i = 0; i < 4; i++)
+        a[i] = _mm_loadu_si128((const __m128i*)acc + i);
+
+    for (size_t s = 0; s < stripes; s++, input += kStripeLen, secret += kSecretConsumeRate) {
+        for (int i = 0; i < 4; i++) {
+            const __m128i data = _mm_loadu_si128((const __m128i*)input + i);
+            const __m128i key = _mm_xor_si128(data, _mm_loadu_si128((const __m128i*)secret + i));
+            const __m128i product = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i*)acc + i, a[i]);
+}
+
+JHC_TARGET("sse2")
+inline void ScrambleSse2(uint64_t acc[8], const unsigned char* secret) {
+    const __m128i prime = _mm_set1_epi32((int)kPrime32_1);
+    for (int i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128((const __m128i*)acc + i);
+        a = _mm_xor_si128(_mm_xor_si128(a, _mm_srli_epi64(a, 47)), _mm_loadu_si128((const __m128i*)secret + i));
+        const __m128i low = _mm_mul_epu32(a, prime);
+        const __m128i high = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        _mm_storeu_si128((__m128i*)acc + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
+
+JHC_TARGET("avx2")
+inline void AccumulateAvx2(uint64_t acc[8], const unsigned char* input, const unsigned char* secret, size_t stripes) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i*)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i*)acc + 1);
+
+    for (size_t s = 0; s < stripes; s++, input += kStripeLen, secret += kSecretConsumeRate) {
+        const __m256i data0 = _mm256_loadu_si256((const __m256i*)input);
+        const __m256i data1 = _mm256_loadu_si256((const __m256i*)input + 1);
+        const __m256i key0 = _mm256_xor_si256(data0, _mm256_loadu_si256((const __m256i*)secret));
+        const __m256i key1 = _mm256_xor_si256(data1, _mm256_loadu_si256((const __m256i*)secret + 1));
+        const __m256i product0 = _mm256_mul_epu32(key0, _mm256_srli_epi64(key0, 32));
+        const __m256i product1 = _mm256_mul_epu32(key1, _mm256_srli_epi64(key1, 32));
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(product0, _mm256_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(product1, _mm256_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+
+    _mm256_storeu_si256((__m256i*)acc, a0);
+    _mm256_storeu_si256((__m256i*)acc + 1, a1);
+}
+
+JHC_TARGET("avx2")
+inline void ScrambleAvx2(uint64_t acc[8], const unsigned char* secret) {
+    const __m256i prime = _mm256_set1_epi32((int)kPrime32_1);
+    for (int i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)acc + i);
+        a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), _mm256_loadu_si256((const __m256i*)secret + i));
+        const __m256i low = _mm256_mul_epu32(a, prime);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        _mm256_storeu_si256((__m256i*)acc + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+}
+#endif
+
+inline void Accumulate(uint64_t acc[8], const unsigned char* input, const unsigned char* secret, size_t stripes, XXH3Hash64::Kernel kernel) {
+    switch (kernel) {
+#ifdef JHC_X86_INTRINSICS
+        case XXH3Hash64::Kernel::Avx2:
+            return AccumulateAvx2(acc, input, secret, stripes);
+        case XXH3Hash64::Kernel::Sse2:
+            return AccumulateSse2(acc, input, secret, stripes);
+#endif
+        default:
+            return AccumulateScalar(acc, input, secret, stripes);
+    }
+}
+
+inline void Scramble(uint64_t acc[8], const unsigned char* secret, XXH3Hash64::Kernel kernel) {
+    switch (kernel) {
+#ifdef JHC_X86_INTRINSICS
+        case XXH3Hash64::Kernel::Avx2:
+            return ScrambleAvx2(acc, secret);
+        case XXH3Hash64::Kernel::Sse2:
+            return ScrambleSse2(acc, secret);
+#endif
+        default:
+            return ScrambleScalar(acc, secret);
+    }
+}
+
+// Accumulators of a whole input longer than kMidSizeMax.
+//
+inline void HashLong(uint64_t acc[8], const unsigned char* input, size_t len, const unsigned char* secret, XXH3Hash64::Kernel kernel) {
+    InitAccumulators(acc);
+    const size_t blocks = (len - 1) / kBlockLen;
+    for (size_t n = 0; n < blocks; n++) {
+        Accumulate(acc, input + n * kBlockLen, secret, kStripesPerBlock, kernel);
+        Scramble(acc, secret + kSecretSize - kStripeLen, kernel);
+    }
+
+    const size_t stripes = ((len - 1) - kBlockLen * blocks) / kStripeLen;
+    Accumulate(acc, input + blocks * kBlockLen, secret, stripes, kernel);
+    Accumulate(acc, input + len - kStripeLen, secret + kSecretSize - kStripeLen - kSecretLastAccStart, 1, kernel);
+}
+
+inline uint64_t MergeAccumulators(const uint64_t acc[8], const unsigned char* secret, uint64_t start) {
+    uint64_t result = start;
+    for (size_t i = 0; i < 4; i++)
+        result += Mul128Fold64(acc[2 * i] ^ Read64(secret + 16 * i), acc[2 * i + 1] ^ Read64(secret + 16 * i + 8));
+    return Avalanche(result);
+}
+
+inline uint64_t Hash64(const unsigned char* input, size_t len, uint64_t seed, XXH3Hash64::Kernel kernel) {
+    if (len <= kMidSizeMax)
+        return Hash64Short(input, len, DefaultSecret(), seed);
+
+    unsigned char custom[kSecretSize];
+    const unsigned char* secret = DefaultSecret();
+    if (seed != 0) {
+        InitSecret(custom, seed);
+        secret = custom;
+    }
+    uint64_t acc[8];
+    HashLong(acc, input, len, secret, kernel);
+    return MergeAccumulators(acc, secret + kSecretMergeAccsStart, len * kPrime64_1);
+}
+
+inline XXH3Hash128::Value Hash128(const unsigned char* input, size_t len, uint64_t seed, XXH3Hash64::Kernel kernel) {
+    if (len <= kMidSizeMax)
+        return Hash128Short(input, len, DefaultSecret(), seed);
+
+    unsigned char custom[kSecretSize];
+    const unsigned char* secret = DefaultSecret();
+    if (seed != 0) {
+        InitSecret(custom, seed);
+        secret = custom;
+    }
+    uint64_t acc[8];
+    HashLong(acc, input, len, secret, kernel);
+    XXH3Hash128::Value h;
+    h.low = MergeAccumulators(acc, secret + kSecretMergeAccsStart, len * kPrime64_1);
+    h.high = MergeAccumulators(acc, secret + kSecretSize - kStripeLen - kSecretMergeAccsStart, ~(len * kPrime64_2));
+    return h;
+}
+
+inline void Reset(State& state, uint64_t seed) {
+    InitAccumulators(state.acc);
+    if (seed != 0)
+        InitSecret(state.secret, seed);
+    else
+        memcpy(state.secret, DefaultSecret(), kSecretSize);
+    state.bufferedSize = 0;
+    state.stripesSoFar = 0;
+    state.totalLen = 0;
+    state.seed = seed;
+}
+
+// Consumes stripes at the position stripesSoFar of the current block, scrambling at block ends.
+// Returns the end of the consumed input.
+//
+inline const unsigned char* ConsumeStripes(uint64_t acc[8],
+                                           size_t& stripesSoFar,
+                                           const unsigned char* input,
+                                           size_t stripes,
+                                           const unsigned char* secret,
+                                           XXH3Hash64::Kernel kernel) {
+    const unsigned char* blockSecret = secret + stripesSoFar * kSecretConsumeRate;
+    if (stripes >= kStripesPerBlock - stripesSoFar) {
+        size_t stripesThisBlock = kStripesPerBlock - stripesSoFar;
+        do {
+            Accumulate(acc, input, blockSecret, stripesThisBlock, kernel);
+            Scramble(acc, secret + kSecretSize - kStripeLen, kernel);
+            input += stripesThisBlock * kStripeLen;
+            stripes -= stripesThisBlock;
+            stripesThisBlock = kStripesPerBlock;
+            blockSecret = secret;
+        } while (stripes >= kStripesPerBlock);
+        stripesSoFar = 0;
+    }
+    if (stripes > 0) {
+        Accumulate(acc, input, blockSecret, stripes, kernel);
+        input += stripes * kStripeLen;
+        stripesSoFar += stripes;
+    }
+    return input;
+}
+
+// Always keeps at least one byte buffered: the last stripe has to be known when the digest is taken.
+//
+inline void Update(State& state, const unsigned char* input, size_t len, XXH3Hash64::Kernel kernel) {
+    if (len == 0)
+        return;
+
+    state.totalLen += len;
+    if (state.bufferedSize + len <= kBufferSize) {
+        memcpy(state.buffer + state.bufferedSize, input, len);
+        state.bufferedSize += len;
+        return;
+    }
+
+    const unsigned char* const end = input + len;
+    if (state.bufferedSize > 0) {
+        const size_t load = kBufferSize - state.bufferedSize;
+        memcpy(state.buffer + state.bufferedSize, input, load);
+        input += load;
+        ConsumeStripes(state.acc, state.stripesSoFar, state.buffer, kBufferSize / kStripeLen, state.secret, kernel);
+        state.bufferedSize = 0;
+    }
+
+    if ((size_t)(end - input) > kBufferSize) {
+        const size_t stripes = (size_t)(end - 1 - input) / kStripeLen;
+        input = ConsumeStripes(state.acc, state.stripesSoFar, input, stripes, state.secret, kernel);
+        memcpy(state.buffer + kBufferSize - kStripeLen, input - kStripeLen, kStripeLen);
+    }
+
+    memcpy(state.buffer, input, (size_t)(end - input));
+    state.bufferedSize = (size_t)(end - input);
+}
+
+// Accumulators of the streamed input, for totalLen > kMidSizeMax. Leaves the state as is.
+//
+inline void DigestLong(const State& state, uint64_t acc[8], XXH3Hash64::Kernel kernel) {
+    memcpy(acc, state.acc, sizeof(state.acc));
+    unsigned char lastStripe[kStripeLen];
+    const unsigned char* last = lastStripe;
+    if (state.bufferedSize >= kStripeLen) {
+        size_t stripesSoFar = state.stripesSoFar;
+        const size_t stripes = (state.bufferedSize - 1) / kStripeLen;
+        ConsumeStripes(acc, stripesSoFar, state.buffer, stripes, state.secret, kernel);
+        last = state.buffer + state.bufferedSize - kStripeLen;
+    }
+    else {
+        const size_t catchup = kStripeLen - state.bufferedSize;
+        memcpy(lastStripe, state.buffer + kBufferSize - catchup, catchup);
+        memcpy(lastStripe + catchup, state.buffer, state.bufferedSize);
+    }
+    Accumulate(acc, last, state.secret + kSecretSize - kStripeLen - kSecretLastAccStart, 1, kernel);
+}
+
+template <size_t N>
+void PutBigEndian(uint64_t value, unsigned char* out) {
+    for (size_t i = 0; i < N; i++)
+        out[i] = (unsigned char)(value >> (8 * (N - 1 - i)));
+}
+}  // namespace xxhash_detail
+}  // namespace jhc
+
+JHC_INLINE jhc::XXH3Hash64::XXH3Hash64() {
+    xxhash_detail::Reset(state_, 0);
+}
+
+JHC_INLINE jhc::XXH3Hash64::XXH3Hash64(uint64_t seed) {
+    xxhash_detail::Reset(state_, seed);
+}
+
+JHC_INLINE void jhc::XXH3Hash64::init() {
+    xxhash_detail::Reset(state_, state_.seed);
+}
+
+JHC_INLINE void jhc::XXH3Hash64::update(const void* data, size_t size) {
+    static const Kernel kernel = ActiveKernel();
+    xxhash_detail::Update(state_, (const unsigned char*)data, size, kernel);
+}
+
+JHC_INLINE uint64_t jhc::XXH3Hash64::value() const {
+    if (state_.totalLen <= xxhash_detail::kMidSizeMax)
+        return xxhash_detail::Hash64Short(state_.buffer, (size_t)state_.totalLen, xxhash_detail::DefaultSecret(), state_.seed);
+
+    static const Kernel kernel = ActiveKernel();
+    uint64_t acc[8];
+    xxhash_detail::DigestLong(state_, acc, kernel);
+    return xxhash_detail::MergeAccumulators(acc, state_.secret + xxhash_detail::kSecretMergeAccsStart, state_.totalLen * xxhash_detail::kPrime64_1);
+}
+
+JHC_INLINE jhc::XXH3Hash64::Digest jhc::XXH3Hash64::finalize() const {
+    Digest digest;
+    xxhash_detail::PutBigEndian<8>(value(), digest.data());
+    return digest;
+}
+
+JHC_INLINE uint64_t jhc::XXH3Hash64::Hash(const void* data, size_t size, uint64_t seed) {
+    if (size <= xxhash_detail::kMidSizeMax)
+        return xxhash_detail::Hash64Short((const unsigned char*)data, size, xxhash_detail::DefaultSecret(), seed);
+
+    static const Kernel kernel = ActiveKernel();
+    return xxhash_detail::Hash64((const unsigned char*)data, size, seed, kernel);
+}
+
+JHC_INLINE uint64_t jhc::XXH3Hash64::Hash(const void* data, size_t size, uint64_t seed, Kernel kernel) {
+    return xxhash_detail::Hash64((const unsigned char*)data, size, seed, kernel);
+}
+
+JHC_INLINE std::string jhc::XXH3Hash64::GetFileXXH3Hash64(const jhc::fs::path& filePath) {
+    File file(filePath);
+    if (!file.open("rb"))
+        return "";
+
+    XXH3Hash64 hasher;
+
+    size_t dwReadBytes = 0;
+    std::vector<unsigned char> szData(1024 * 1024);
+
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        hasher.update(szData.data(), dwReadBytes);
+    }
+    file.close();
+
+    return DigestToHex(hasher.finalize());
+}
+
+JHC_INLINE std::string jhc::XXH3Hash64::GetDataXXH3Hash64(const unsigned char* data, size_t dataSize) {
+    Digest digest;
+    xxhash_detail::PutBigEndian<8>(Hash(data, dataSize), digest.data());
+    return DigestToHex(digest);
+}
+
+JHC_INLINE bool jhc::XXH3Hash64::IsKernelSupported(Kernel kernel) {
+#ifdef JHC_X86_INTRINSICS
+    if (kernel == Kernel::Sse2)
+        return CpuFeatures::Get().sse2;
+    if (kernel == Kernel::Avx2)
+        return CpuFeatures::Get().avx2;
+#else
+    if (kernel != Kernel::Scalar)
+        return false;
+#endif
+    return true;
+}
+
+JHC_INLINE jhc::XXH3Hash64::Kernel jhc::XXH3Hash64::ActiveKernel() {
+    if (IsKernelSupported(Kernel::Avx2))
+        return Kernel::Avx2;
+    if (IsKernelSupported(Kernel::Sse2))
+        return Kernel::Sse2;
+    return Kernel::Scalar;
+}
+
+JHC_INLINE jhc::XXH3Hash128::XXH3Hash128() {
+    xxhash_detail::Reset(state_, 0);
+}
+
+JHC_INLINE jhc::XXH3Hash128::XXH3Hash128(uint64_t seed) {
+    xxhash_detail::Reset(state_, seed);
+}
+
+JHC_INLINE void jhc::XXH3Hash128::init() {
+    xxhash_detail::Reset(state_, state_.seed);
+}
+
+JHC_INLINE void jhc::XXH3Hash128::update(const void* data, size_t size) {
+    static const Kernel kernel = XXH3Hash64::ActiveKernel();
+    xxhash_detail::Update(state_, (const unsigned char*)data, size, kernel);
+}
+
+JHC_INLINE jhc::XXH3Hash128::Value jhc::XXH3Hash128::value() const {
+    if (state_.totalLen <= xxhash_detail::kMidSizeMax)
+        return xxhash_detail::Hash128Short(state_.buffer, (size_t)state_.totalLen, xxhash_detail::DefaultSecret(), state_.seed);
+
+    static const Kernel kernel = XXH3Hash64::ActiveKernel();
+    uint64_t acc[8];
+    xxhash_detail::DigestLong(state_, acc, kernel);
+    Value h;
+    h.low = xxhash_detail::MergeAccumulators(acc, state_.secret + xxhash_detail::kSecretMergeAccsStart, state_.totalLen * xxhash_detail::kPrime64_1);
+    h.high = xxhash_detail::MergeAccumulators(acc,
+                                              state_.secret + xxhash_detail::kSecretSize - xxhash_detail::kStripeLen - xxhash_detail::kSecretMergeAccsStart,
+                                              ~(state_.totalLen * xxhash_detail::kPrime64_2));
+    return h;
+}
+
+JHC_INLINE jhc::XXH3Hash128::Digest jhc::XXH3Hash128::finalize() const {
+    const Value h = value();
+    Digest digest;
+    xxhash_detail::PutBigEndian<8>(h.high, digest.data());
+    xxhash_detail::PutBigEndian<8>(h.low, digest.data() + 8);
+    return digest;
+}
+
+JHC_INLINE jhc::XXH3Hash128::Value jhc::XXH3Hash128::Hash(const void* data, size_t size, uint64_t seed) {
+    if (size <= xxhash_detail::kMidSizeMax)
+        return xxhash_detail::Hash128Short((const unsigned char*)data, size, xxhash_detail::DefaultSecret(), seed);
+
+    static const Kernel kernel = XXH3Hash64::ActiveKernel();
+    return xxhash_detail::Hash128((const unsigned char*)data, size, seed, kernel);
+}
+
+JHC_INLINE jhc::XXH3Hash128::Value jhc::XXH3Hash128::Hash(const void* data, size_t size, uint64_t seed, Kernel kernel) {
+    return xxhash_detail::Hash128((const unsigned char*)data, size, seed, kernel);
+}
+
+JHC_INLINE std::string jhc::XXH3Hash128::GetFileXXH3Hash128(const jhc::fs::path& filePath) {
+    File file(filePath);
+    if (!file.open("rb"))
+        return "";
+
+    XXH3Hash128 hasher;
+
+    size_t dwReadBytes = 0;
+    std::vector<unsigned char> szData(1024 * 1024);
+
+    while ((dwReadBytes = file.readFrom(szData.data(), szData.size(), -1)) > 0) {
+        hasher.update(szData.data(), dwReadBytes);
+    }
+    file.close();
+
+    return DigestToHex(hasher.finalize());
+}
+
+JHC_INLINE std::string jhc::XXH3Hash128::GetDataXXH3Hash128(const unsigned char* data, size_t dataSize) {
+    const Value h = Hash(data, dataSize);
+    Digest digest;
+    xxhash_detail::PutBigEndian<8>(h.high, digest.data());
+    xxhash_detail::PutBigEndian<8>(h.low, digest.data() + 8);
+    return DigestToHex(digest);
+}
@@ -20,8 +20,13 @@
 #define JHC_JSON_HPP__
 
 #include "external/nlohmann-json/single_include/nlohmann/json.hpp"
+#include "jhc/monotonic_arena.hpp"
 
 namespace jhc {
     using json = nlohmann::json;
+
+    // A json whose objects, arrays and strings are allocated from MonotonicArena::Current().
+    // Create, modify and parse it inside a MonotonicArena::Scope, and destroy it before the arena is reset.
+    using arena_json = nlohmann::basic_json<std::map, std::vector, ArenaString, bool, std::int64_t, std::uint64_t, double, ArenaAllocator>;
 } // namespace jhc
 #endif // !JHC_JSON_HPP__
\ No newline at end of file
@@ -26,6 +26,7 @@
 #define _WINSOCKAPI_
 #endif  // !_WINSOCKAPI_
 #include "jhc/filesystem.hpp"
+#include "jhc/hasher.hpp"
 
 namespace jhc {
 class MD5 {
@@ -36,11 +37,28 @@ class MD5 {
         unsigned int in[16];
     };
 
+    enum { kDigestSize = 16 };
+    typedef std::array<uint8_t, kDigestSize> Digest;
+
+    MD5();
+
+    // Streaming interface, see hasher.hpp.
+    //
+    void init();
+    void update(const void* data, size_t size);
+    Digest finalize();
+
     // Support large memory.
     //
     static std::string GetDataMD5(const unsigned char* buffer, size_t buffer_size);
     static std::string GetFileMD5(const fs::path& file_path);
 
+    // Hashes count independent messages (data[i], sizes[i] bytes) and writes the raw digest of
+    // message i to digests + 16 * i. Runs 8 messages at a time in AVX2 lanes when available,
+    // which suits many small inputs such as keys and records.
+    //
+    static void HashBatch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests);
+
    public:
     /*
        * Start MD5 accumulation.  Set bit count to 0 and buffer to mysterious
@@ -78,7 +96,7 @@ class MD5 {
     void byteSwap(unsigned int* buf, unsigned words);
 
     bool bigEndian_ = false;
-    const char HEX_STRING[17] = "0123456789abcdef"; /* to convert to hex */
+    MD5Context ctx_;
 };
 }  // namespace jhc
 
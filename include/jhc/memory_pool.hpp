@@ -22,6 +22,7 @@
 #include "jhc/config.hpp"
 #include <climits>
 #include <cstddef>
+#include <cstring>
 #include <mutex>
 /*
  MemoryPool is mostly compliant with the C++ Standard Library allocators.
@@ -38,6 +39,8 @@
  * This is **NOT** thread safe. You should create a different instance for each thread (suggested)
  or find some way of scheduling queries to the allocator.
 
+ For variable sized allocations from many threads, see PoolAllocator in jhc/size_class_pool.hpp.
+
  Also see: https://blog.csdn.net/china_jeffery/article/details/80750042
  */
 
@@ -0,0 +1,172 @@
+﻿/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_MONOTONIC_ARENA_HPP__
+#define JHC_MONOTONIC_ARENA_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "jhc/macros.hpp"
+
+namespace jhc {
+// Bump pointer arena for request scoped data.
+// allocate() only moves a pointer forward, memory is never freed one by one.
+// reset() rewinds to the first block in O(1) and keeps all the blocks for the next round,
+// release() gives the blocks back to the system.
+// Not thread safe, use one arena per thread/request.
+//
+class MonotonicArena {
+   public:
+    JHC_DISALLOW_COPY_MOVE(MonotonicArena);
+
+    // Makes an arena the current one of the calling thread while in scope,
+    // default constructed ArenaAllocator (as used by arena_json) allocate from it.
+    class Scope {
+       public:
+        JHC_DISALLOW_COPY_MOVE(Scope);
+        explicit Scope(MonotonicArena& arena);
+        ~Scope();
+
+       private:
+        MonotonicArena* prev_;
+    };
+
+    // blockSize is the size of the first block, later blocks double up to kMaxBlockSize.
+    explicit MonotonicArena(size_t blockSize = 4096);
+    ~MonotonicArena();
+
+    // throw std::bad_alloc when the memory can not be allocated.
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    // Copy len chars to the arena and append '\0'.
+    char* copyString(const char* s, size_t len);
+    char* copyString(const std::string& s);
+
+    void reset() noexcept;
+
+    void release() noexcept;
+
+    // Bytes handed out since the last reset/release, including alignment padding and the unused tails of full blocks.
+    size_t usedBytes() const;
+
+    // Bytes of all the blocks owned by the arena.
+    size_t reservedBytes() const;
+
+    // The arena of the innermost Scope on the calling thread, nullptr if none.
+    static MonotonicArena* Current();
+
+    static const size_t kMaxBlockSize = 1024 * 1024;
+
+   private:
+    struct Block {
+        Block* next;
+        size_t size;  // usable bytes after the header.
+    };
+
+    static MonotonicArena*& CurrentRef();
+    static size_t BlockHeaderSize();
+
+    char* blockData(Block* b) const;
+    bool nextBlock(size_t bytes, size_t alignment);
+
+    Block* first_;
+    Block* current_;
+    char* cursor_;
+    char* end_;
+    size_t next_block_size_;
+    size_t used_before_current_;  // used bytes of the blocks before current_.
+    size_t reserved_;
+};
+
+// STL compatible allocator that allocates from a MonotonicArena. deallocate does nothing,
+// the memory is reclaimed by MonotonicArena::reset/release, so containers must not outlive those.
+// A default constructed ArenaAllocator uses MonotonicArena::Current(), this is what lets types like
+// arena_json that construct their allocators internally allocate from the arena.
+//
+template <typename T>
+class ArenaAllocator {
+   public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind { typedef ArenaAllocator<U> other; };
+
+    ArenaAllocator() noexcept :
+        arena_(MonotonicArena::Current()) {}
+
+    ArenaAllocator(MonotonicArena& arena) noexcept :
+        arena_(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept :
+        arena_(other.arena()) {}
+
+    // throw std::bad_alloc when not bound to an arena.
+    pointer allocate(size_type n, const void* hint = 0) {
+        (void)hint;
+        if (!arena_ || n > max_size())
+            throw std::bad_alloc();
+        return static_cast<pointer>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(pointer, size_type) noexcept {}
+
+    size_type max_size() const noexcept { return static_cast<size_type>(-1) / sizeof(T); }
+
+    MonotonicArena* arena() const noexcept { return arena_; }
+
+   private:
+    MonotonicArena* arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+    return a.arena() != b.arena();
+}
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/monotonic_arena.cc"
+#endif
+
+#endif  //! JHC_MONOTONIC_ARENA_HPP__
@@ -0,0 +1,100 @@
+﻿/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_RING_BUFFER_QUEUE_HPP__
+#define JHC_RING_BUFFER_QUEUE_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include <atomic>
+#include <new>
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include "jhc/macros.hpp"
+
+namespace jhc {
+// Bounded, lock-free, multi-producer/multi-consumer message queue.
+// All the slots are allocated once in the constructor, push copies the data into a free slot
+// and pop copies it out again, so neither takes a lock or calls malloc.
+// Unlike BufferQueue it is strictly FIFO: there is no push to front or pop from last.
+//
+class RingBufferQueue {
+   public:
+    JHC_DISALLOW_COPY_MOVE(RingBufferQueue);
+
+    // capacity will be rounded up to a power of 2.
+    // maxElementSize is the biggest message that can be pushed.
+    //
+    RingBufferQueue(size_t capacity, size_t maxElementSize, const std::string& name = "");
+    ~RingBufferQueue();
+
+    std::string getQueueName() const;
+
+    size_t capacity() const;
+
+    size_t maxElementSize() const;
+
+    // Push element to queue's last.
+    // The queue copies pData into its own slot, so caller can free pData after call.
+    // Return false if the queue is full, or nDataSize is 0 or bigger than maxElementSize().
+    //
+    bool pushElementToLast(const void* pData, size_t nDataSize);
+
+    // Pop queue's first element, and copy element's data to pBuffer.
+    // If pBuffer is smaller than the element, the data is truncated, like BufferQueue does.
+    // Return: actual size of copy into pBuffer, 0 if the queue is empty.
+    //
+    size_t popElementFromFront(void* pBuffer, size_t nBufferSize);
+
+    // Approximate when other threads are pushing or popping at the same time.
+    //
+    size_t getElementCount() const;
+
+   private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        size_t size;
+    };
+
+    Slot* slotAt(size_t pos) const;
+
+    static const size_t kCacheLineSize = 64;
+
+    std::string queue_name_;
+    size_t mask_;
+    size_t max_element_size_;
+    size_t slot_stride_;
+    void* memory_;    // what we allocated.
+    char* slots_;     // first slot, aligned to kCacheLineSize.
+
+    // Producers and consumers each work on their own cache line.
+    char pad0_[kCacheLineSize];
+    std::atomic<size_t> enqueue_pos_;
+    char pad1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos_;
+    char pad2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/ring_buffer_queue.cc"
+#endif
+
+#endif  //! JHC_RING_BUFFER_QUEUE_HPP__
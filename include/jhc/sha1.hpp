@@ -26,23 +26,50 @@
 #include <string>
 #include <jhc/arch.hpp>
 #include <jhc/file.hpp>
+#include "jhc/hasher.hpp"
 
 namespace jhc {
+// SHA-1. update() runs the fastest kernel the CPU supports: the SHA extensions when present,
+// otherwise scalar rounds over a message schedule computed with SSSE3 or AVX2.
+//
 class SHA1 {
    public:
     enum { REPORT_HEX = 0,
            REPORT_DIGIT = 1 };
 
+    enum class Kernel {
+        Scalar,
+        Ssse3,  // message schedule in SSE registers
+        Avx2,   // message schedule of two blocks at a time in AVX2 registers, BMI2 rotates
+        ShaNi,  // x86 SHA extensions
+    };
+
+    enum { kDigestSize = 20 };
+    typedef std::array<uint8_t, kDigestSize> Digest;
+
     SHA1();
+
+    // Uses the given kernel, which must be supported.
+    //
+    explicit SHA1(Kernel kernel);
+
     ~SHA1();
 
     void reset();
 
+    // Same as reset(), for the streaming interface (see hasher.hpp).
+    //
+    void init();
+
     // Use this function to hash in binary data and strings
-    void update(const unsigned char* data, unsigned int len);
+    void update(const void* data, size_t len);
 
     void final();
 
+    // final() and the raw message digest.
+    //
+    Digest finalize();
+
     // Get the final hash as a pre-formatted string
     void reportHash(char* szReport, unsigned char uReportType = REPORT_HEX);
 
@@ -53,16 +80,18 @@ class SHA1 {
 
     static std::string GetDataSHA1(const unsigned char* data, size_t dataSize);
 
-   private:
-    typedef union {
-        unsigned char c[64];
-        uint32_t l[16];
-    } SHA1_WORKSPACE_BLOCK;
+    static bool IsKernelSupported(Kernel kernel);
 
-    void transform(uint32_t state[5], const unsigned char buffer[64]);
+    // The kernel used by default on this CPU.
+    //
+    static Kernel ActiveKernel();
+
+   private:
+    void transform(uint32_t state[5], const unsigned char* data, size_t blocks);
 
+    Kernel kernel_;
     uint32_t m_state[5];
-    uint32_t m_count[2];
+    uint64_t m_count;  // in bits
     unsigned char m_buffer[64];
     unsigned char m_digest[20];
 };
@@ -28,17 +28,34 @@
 #define _WINSOCKAPI_
 #endif  // !_WINSOCKAPI_
 #include "jhc/filesystem.hpp"
+#include "jhc/hasher.hpp"
 
 namespace jhc {
+// SHA-256. update() runs the fastest kernel the CPU supports: the SHA extensions when present,
+// otherwise scalar rounds over a message schedule computed with SSSE3 or AVX2.
+//
 class SHA256 {
    public:
+    enum class Kernel {
+        Scalar,
+        Ssse3,  // message schedule in SSE registers
+        Avx2,   // message schedule of two blocks at a time in AVX2 registers, BMI2 rotates
+        ShaNi,  // x86 SHA extensions
+    };
+
+    enum { kDigestSize = 32 };
+    typedef std::array<uint8_t, kDigestSize> Digest;
+
     SHA256();
-    ~SHA256();
+
+    // Uses the given kernel, which must be supported.
+    //
+    explicit SHA256(Kernel kernel);
 
     /* Initialize the SHA values */
     void init();
 
-    void update(const unsigned char* buffer, uint32_t length);
+    void update(const void* buffer, size_t length);
 
     /* Final wrapup - pad to SHA1_DATA_SIZE-byte boundary with the bit pattern
       1 0* (64-bit count of bits processed, MSB-first) */
@@ -48,11 +65,33 @@ class SHA256 {
 
     std::string digest();
 
+    // final() and digest(), see hasher.hpp.
+    //
+    Digest finalize();
+
     static std::string GetFileSHA256(const fs::path& filePath);
     static std::string GetDataSHA256(const unsigned char* data, size_t dataSize);
 
+    // Hashes count independent messages (data[i], sizes[i] bytes) and writes the raw digest of
+    // message i to digests + 32 * i. Uses the SHA extensions without any per-message setup when
+    // available, otherwise runs 8 messages at a time in AVX2 lanes. Suits many small inputs such
+    // as keys and records.
+    //
+    static void HashBatch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests);
+
+    // Same with the given kernel, which must be supported: Avx2 runs the 8-lane path, ShaNi
+    // one message after the other with the SHA extensions.
+    //
+    static void HashBatch(const unsigned char* const* data, const size_t* sizes, size_t count, unsigned char* digests, Kernel kernel);
+
+    static bool IsKernelSupported(Kernel kernel);
+
+    // The kernel used by default on this CPU.
+    //
+    static Kernel ActiveKernel();
+
    private:
-    void sha256_block(const unsigned char* block);
+    void sha256_blocks(const unsigned char* data, size_t blocks);
 
     /* Perform the SHA transformation.  Note that this code, like MD5, seems to
       break some optimizing compilers due to the complexity of the expressions
@@ -62,8 +101,15 @@ class SHA256 {
       Note that this function destroys the data area */
     void sha256_transform(uint32_t* state, uint32_t* data);
 
-    class Private;
-    Private* p_ = nullptr;
+    struct Context {
+        uint32_t state[8];               /* State variables */
+        uint32_t count_low, count_high;  /* 64-bit block count */
+        unsigned char block[64];         /* SHA256 data buffer */
+        uint32_t index;                  /* index into buffer */
+    };
+
+    Context ctx_;
+    Kernel kernel_ = Kernel::Scalar;
 };
 }  // namespace jhc
 
@@ -22,17 +22,27 @@
 #include "jhc/config.hpp"
 #include <string>
 #include "jhc/filesystem.hpp"
+#include "jhc/hasher.hpp"
 
 namespace jhc {
 class SHA512 {
    public:
+    enum { kDigestSize = 64 };
+    typedef std::array<uint8_t, kDigestSize> Digest;
+
+    SHA512();
+
     void init();
 
-    void update(const unsigned char* message, unsigned int len);
+    void update(const void* message, size_t len);
 
     void final(unsigned char* digest);
 
-    void transform(const unsigned char* message, unsigned int block_nb);
+    // final() into a raw digest, see hasher.hpp.
+    //
+    Digest finalize();
+
+    void transform(const unsigned char* message, size_t block_nb);
 
     static std::string GetFileSHA512(const fs::path& filePath);
 
@@ -47,7 +57,7 @@ class SHA512 {
 
     static const unsigned int SHA384_512_BLOCK_SIZE = (1024 / 8);
     static const unsigned int DIGEST_SIZE = (512 / 8);
-    unsigned int m_tot_len;
+    uint64 m_tot_len;  // bytes in the transformed blocks
     unsigned int m_len;
     unsigned char m_block[2 * SHA384_512_BLOCK_SIZE];
     uint64 m_h[8];
@@ -0,0 +1,106 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+#ifndef JHC_SHARDED_TIMER_HPP__
+#define JHC_SHARDED_TIMER_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include <memory>
+#include <vector>
+#include "jhc/macros.hpp"
+#include "jhc/timer.hpp"
+
+namespace jhc {
+// A timer service made of several independent Timer shards, each with its own thread, lock and schedule.
+// add() picks the shard of the calling thread, so threads adding timers concurrently rarely share a lock.
+// addToShard() picks the shard from a caller supplied key instead, e.g. to keep all timers of a connection together.
+// Ids encode their shard (id % shardCount()), they are stable and are passed to the handler like Timer does.
+//
+class ShardedTimer {
+   public:
+    JHC_DISALLOW_COPY_MOVE(ShardedTimer);
+    using handler_t = Timer::handler_t;
+    using time_point = std::chrono::time_point<std::chrono::steady_clock>;
+
+    // shards = 0 uses one shard per hardware thread.
+    //
+    explicit ShardedTimer(size_t shards = 0,
+                          Timer::Backend backend = Timer::Backend::TimingWheel,
+                          const std::chrono::microseconds& tick = std::chrono::milliseconds(1));
+
+    ~ShardedTimer();
+
+    size_t shardCount() const;
+
+    // The shard used by add() on the calling thread.
+    //
+    size_t currentShard() const;
+
+    // Same as Timer::add, on the shard of the calling thread.
+    //
+    size_t add(const time_point& when,
+               handler_t&& handler,
+               const std::chrono::microseconds& period = std::chrono::microseconds::zero(),
+               const std::chrono::microseconds& slack = std::chrono::microseconds::zero());
+
+    template <class Rep, class Period>
+    inline size_t add(const std::chrono::duration<Rep, Period>& when,
+                      handler_t&& handler,
+                      const std::chrono::microseconds& period = std::chrono::microseconds::zero(),
+                      const std::chrono::microseconds& slack = std::chrono::microseconds::zero()) {
+        return add(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::microseconds>(when),
+                   std::move(handler),
+                   period,
+                   slack);
+    }
+
+    // Same as Timer::add, on shard key % shardCount().
+    //
+    size_t addToShard(size_t key,
+                      const time_point& when,
+                      handler_t&& handler,
+                      const std::chrono::microseconds& period = std::chrono::microseconds::zero(),
+                      const std::chrono::microseconds& slack = std::chrono::microseconds::zero());
+
+    bool remove(size_t id);
+
+    // Applied to every shard, see Timer.
+    //
+    void setExecutor(Timer::executor_t executor);
+
+    void setExecutor(ThreadPool& pool);
+
+    void setMissedPolicy(Timer::Missed missed);
+
+   private:
+    size_t addTo(size_t shard,
+                 const time_point& when,
+                 handler_t&& handler,
+                 const std::chrono::microseconds& period,
+                 const std::chrono::microseconds& slack);
+
+    std::vector<std::unique_ptr<Timer>> shards_;
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/sharded_timer.cc"
+#endif
+
+#endif  //! JHC_SHARDED_TIMER_HPP__
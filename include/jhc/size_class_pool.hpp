@@ -0,0 +1,160 @@
+﻿/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_SIZE_CLASS_POOL_HPP__
+#define JHC_SIZE_CLASS_POOL_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+#include "jhc/macros.hpp"
+
+namespace jhc {
+// Process-wide small object allocator with size classes and per-thread caches.
+//
+// Requests up to kMaxSmallSize bytes are rounded up to one of kClassNum size classes
+// (16-byte steps up to 128, then 4 steps per power of 2). Each thread keeps a free list per class,
+// so allocate/deallocate usually touch thread local data only. When a thread's list runs empty or grows too long,
+// objects move to or from a lock-free central free list in batches. Only carving a new 64KB chunk takes a lock.
+// Memory is never returned to the system. Larger requests go straight to ::operator new.
+//
+// Memory freed by a thread other than the one that allocated it simply joins the freeing thread's cache.
+// Returned memory is aligned to 16 bytes.
+//
+class SizeClassPool {
+   public:
+    JHC_DISALLOW_COPY_MOVE(SizeClassPool);
+
+    static const size_t kMaxSmallSize = 32 * 1024;
+    static const size_t kClassNum = 40;
+
+    // The pool is created on first use and lives until the process exits.
+    static SizeClassPool* Instance();
+
+    void* allocate(size_t bytes);
+
+    // bytes must be the same value that was passed to allocate.
+    void deallocate(void* p, size_t bytes) noexcept;
+
+    // The size class used for bytes, bytes must be <= kMaxSmallSize.
+    static size_t ClassIndex(size_t bytes);
+
+    // The real object size of a size class.
+    static size_t ClassSize(size_t cls);
+
+    // Bytes reserved from the system for small objects so far.
+    size_t reservedBytes() const;
+
+   private:
+    struct FreeObject {
+        FreeObject* next;                  // next object in a thread cache list or a batch.
+        std::atomic<uintptr_t> nextBatch;  // address of the next batch in the central list, only valid on a batch's first object.
+    };
+
+    struct CentralList {
+        std::atomic<uint64_t> head;  // FreeObject* and ABA tag packed together.
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    struct ThreadCache {
+        FreeObject* heads[kClassNum];
+        size_t counts[kClassNum];
+
+        ThreadCache();
+        ~ThreadCache();
+    };
+
+    SizeClassPool();
+
+    static ThreadCache& LocalCache();
+    static size_t BatchSize(size_t cls);
+
+    void pushBatch(size_t cls, FreeObject* first) noexcept;
+    FreeObject* popBatch(size_t cls) noexcept;
+    FreeObject* carveBatch(size_t cls);
+    void releaseToCentral(size_t cls, FreeObject*& head, size_t& count, size_t keep) noexcept;
+
+    CentralList central_[kClassNum];
+    std::mutex chunk_mutex_;
+    std::vector<void*> chunks_;  // keeps the chunks reachable, for leak checkers.
+    std::atomic<size_t> reserved_bytes_;
+};
+
+// STL compatible allocator on top of SizeClassPool, usable with std::vector, std::map and the like.
+// It has no state, all instances are equal.
+//
+template <typename T>
+class PoolAllocator {
+   public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type is_always_equal;
+
+    template <typename U>
+    struct rebind { typedef PoolAllocator<U> other; };
+
+    PoolAllocator() noexcept {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    pointer allocate(size_type n, const void* hint = 0) {
+        (void)hint;
+        if (n > max_size())
+            throw std::bad_alloc();
+        return static_cast<pointer>(SizeClassPool::Instance()->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n) noexcept {
+        SizeClassPool::Instance()->deallocate(p, n * sizeof(T));
+    }
+
+    size_type max_size() const noexcept { return static_cast<size_type>(-1) / sizeof(T); }
+
+    static_assert(alignof(T) <= 16, "PoolAllocator only provides 16-byte alignment.");
+};
+
+template <typename T, typename U>
+inline bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept {
+    return false;
+}
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/size_class_pool.cc"
+#endif
+
+#endif  //! JHC_SIZE_CLASS_POOL_HPP__
@@ -26,62 +26,235 @@
 //
 #include "jhc/config.hpp"
 #include <vector>
-#include <queue>
 #include <memory>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <exception>
 #include "jhc/macros.hpp"
 
 namespace jhc {
+// A move-only, type-erased `void()` callable.
+// Callables that fit into kInlineSize bytes and are nothrow move constructible (typical lambdas with
+// a few captures, std::bind results, std::packaged_task) are stored inline without any heap allocation,
+// larger ones fall back to a single heap allocation.
+//
+class MoveOnlyTask {
+   public:
+    static const size_t kInlineSize = 48;
+
+    MoveOnlyTask() noexcept :
+        ops_(nullptr) {}
+
+    template <class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, MoveOnlyTask>::value>::type>
+    MoveOnlyTask(F&& f) :
+        ops_(nullptr) {
+        using Fn = typename std::decay<F>::type;
+        construct<Fn>(std::forward<F>(f), StoreInline<Fn>());
+    }
+
+    MoveOnlyTask(MoveOnlyTask&& other) noexcept :
+        ops_(nullptr) {
+        moveFrom(other);
+    }
+
+    MoveOnlyTask& operator=(MoveOnlyTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    MoveOnlyTask(const MoveOnlyTask&) = delete;
+    MoveOnlyTask& operator=(const MoveOnlyTask&) = delete;
+
+    ~MoveOnlyTask() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    // Whether the callable is stored in the inline buffer.
+    bool isInline() const noexcept { return ops_ && ops_->isInline; }
+
+    void operator()() { ops_->invoke(&storage_); }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+   private:
+    struct Ops {
+        void (*invoke)(void* self);
+        void (*move)(void* from, void* to);
+        void (*destroy)(void* self);
+        bool isInline;
+    };
+
+    template <class Fn>
+    struct StoreInline : std::integral_constant<bool,
+                                                sizeof(Fn) <= kInlineSize &&
+                                                    alignof(Fn) <= alignof(std::max_align_t) &&
+                                                    std::is_nothrow_move_constructible<Fn>::value> {};
+
+    template <class Fn>
+    struct InlineOps {
+        static void Invoke(void* self) { (*static_cast<Fn*>(self))(); }
+        static void Move(void* from, void* to) {
+            ::new (to) Fn(std::move(*static_cast<Fn*>(from)));
+            static_cast<Fn*>(from)->~Fn();
+        }
+        static void Destroy(void* self) { static_cast<Fn*>(self)->~Fn(); }
+        static const Ops table;
+    };
+
+    template <class Fn>
+    struct HeapOps {
+        static void Invoke(void* self) { (**static_cast<Fn**>(self))(); }
+        static void Move(void* from, void* to) { ::new (to) Fn*(*static_cast<Fn**>(from)); }
+        static void Destroy(void* self) { delete *static_cast<Fn**>(self); }
+        static const Ops table;
+    };
+
+    template <class Fn, class F>
+    void construct(F&& f, std::true_type) {
+        ::new (static_cast<void*>(&storage_)) Fn(std::forward<F>(f));
+        ops_ = &InlineOps<Fn>::table;
+    }
+
+    template <class Fn, class F>
+    void construct(F&& f, std::false_type) {
+        ::new (static_cast<void*>(&storage_)) Fn*(new Fn(std::forward<F>(f)));
+        ops_ = &HeapOps<Fn>::table;
+    }
+
+    void moveFrom(MoveOnlyTask& other) noexcept {
+        if (other.ops_) {
+            other.ops_->move(&other.storage_, &storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type storage_;
+    const Ops* ops_;
+};
+
+template <class Fn>
+const MoveOnlyTask::Ops MoveOnlyTask::InlineOps<Fn>::table = {&Invoke, &Move, &Destroy, true};
+
+template <class Fn>
+const MoveOnlyTask::Ops MoveOnlyTask::HeapOps<Fn>::table = {&Invoke, &Move, &Destroy, false};
+
 class ThreadPool {
    public:
+    enum class Mode {
+        // All workers share one FIFO queue, the original behavior.
+        SharedQueue = 0,
+        // Every worker owns a deque. Tasks submitted from a worker go to its own deque and are
+        // taken back in LIFO order, tasks submitted from other threads are distributed round-robin,
+        // idle workers steal the oldest task from the other deques.
+        WorkStealing
+    };
+
     JHC_DISALLOW_COPY_MOVE(ThreadPool);
-    ThreadPool(size_t threads) :
-        stop(false) {
-        for (size_t i = 0; i < threads; ++i)
-            workers.emplace_back([this] {
-                for (;;) {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-                        if (this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            });
+    ThreadPool(size_t threads, Mode mode = Mode::SharedQueue) :
+        mode_(mode),
+        stop(false),
+        pending_(0),
+        idle_(0),
+        next_queue_(0) {
+        if (threads == 0)
+            threads = 1;
+
+        if (mode_ == Mode::WorkStealing) {
+            for (size_t i = 0; i < threads; ++i)
+                local_queues_.emplace_back(new WorkerQueue());
+        }
+
+        for (size_t i = 0; i < threads; ++i) {
+            if (mode_ == Mode::WorkStealing)
+                workers.emplace_back([this, i] { this->stealingWorkerLoop(i); });
+            else
+                workers.emplace_back([this] { this->sharedWorkerLoop(); });
+        }
     }
 
+    Mode mode() const { return mode_; }
+
+    size_t threadCount() const { return workers.size(); }
+
     // add new work item to the pool
     template <class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type> {
         using return_type = typename std::result_of<F(Args...)>::type;
 
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
 
-        std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+        std::future<return_type> res = task.get_future();
+        submit(Task(std::move(task)));
+        return res;
+    }
 
-            // don't allow enqueueing after stopping the pool
-            if (stop)
-                throw std::runtime_error("enqueue on stopped ThreadPool");
+    // add new fire-and-forget work item to the pool.
+    // No future is created, so typical lambdas are submitted without any heap allocation.
+    // f must not throw, an escaping exception terminates the process just like in std::thread.
+    template <class F>
+    void post(F&& f) {
+        submit(Task(std::forward<F>(f)));
+    }
 
-            tasks.emplace([task]() { (*task)(); });
+    template <class F, class... Args>
+    void post(F&& f, Args&&... args) {
+        submit(Task(std::bind(std::forward<F>(f), std::forward<Args>(args)...)));
+    }
+
+    // Splits [begin, end) into chunks of at least `grain` indices and calls fn(chunkBegin, chunkEnd) for each of them.
+    // Chunks are claimed dynamically, large ones first and shrinking towards `grain`, by the workers and by the
+    // calling thread itself. Returns when the whole range is done, the first exception thrown by fn is rethrown here.
+    // Only one task per worker is posted, no future is created per chunk.
+    template <class Index, class F>
+    void parallelFor(Index begin, Index end, Index grain, F&& fn) {
+        ForBody<Index, typename std::remove_reference<F>::type> body(fn);
+        runParallel(begin, end, grain, body);
+    }
+
+    // Same splitting as parallelFor. map(chunkBegin, chunkEnd) returns the partial result of a chunk,
+    // partial results are combined with reduce(T, T), which must be associative and commutative.
+    // Returns identity when the range is empty.
+    template <class Index, class T, class Map, class Reduce>
+    T parallelReduce(Index begin, Index end, Index grain, T identity, Map&& map, Reduce&& reduce) {
+        T result(std::move(identity));
+        ReduceBody<Index, T, typename std::remove_reference<Map>::type, typename std::remove_reference<Reduce>::type> body(map, reduce, result);
+        runParallel(begin, end, grain, body);
+        return result;
+    }
+
+    // Number of times the task queues allocated a bigger buffer so far. Apart from the heap fallback of
+    // MoveOnlyTask, it is the only allocation made by submitting a task.
+    size_t queueGrowCount() {
+        if (mode_ == Mode::SharedQueue) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            return tasks.growCount();
         }
-        condition.notify_one();
-        return res;
+
+        size_t count = 0;
+        for (const std::unique_ptr<WorkerQueue>& q : local_queues_) {
+            std::lock_guard<std::mutex> lock(q->mutex);
+            count += q->tasks.growCount();
+        }
+        return count;
     }
 
     // the destructor joins all threads
@@ -96,15 +269,319 @@ class ThreadPool {
     }
 
    private:
+    typedef MoveOnlyTask Task;
+
+    // Growable ring buffer of tasks.
+    // Slots are reused once the ring has grown to the working-set size, so steady-state
+    // push/pop does not allocate (unlike std::deque, which allocates and frees node blocks).
+    class TaskRing {
+       public:
+        TaskRing() :
+            slots_(16), head_(0), size_(0), grows_(0) {}
+
+        bool empty() const { return size_ == 0; }
+
+        size_t size() const { return size_; }
+
+        // Number of times the ring allocated a bigger buffer.
+        size_t growCount() const { return grows_; }
+
+        void push_back(Task&& task) {
+            if (size_ == slots_.size())
+                grow();
+            slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(task);
+            ++size_;
+        }
+
+        Task pop_front() {
+            Task task(std::move(slots_[head_]));
+            head_ = (head_ + 1) & (slots_.size() - 1);
+            --size_;
+            return task;
+        }
+
+        Task pop_back() {
+            --size_;
+            return Task(std::move(slots_[(head_ + size_) & (slots_.size() - 1)]));
+        }
+
+       private:
+        void grow() {
+            std::vector<Task> bigger(slots_.size() * 2);
+            for (size_t i = 0; i < size_; ++i)
+                bigger[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+            slots_.swap(bigger);
+            head_ = 0;
+            ++grows_;
+        }
+
+        std::vector<Task> slots_;  // size is always a power of 2
+        size_t head_;
+        size_t size_;
+        size_t grows_;
+    };
+
+    // Per-worker deque used in WorkStealing mode.
+    // The padding keeps two neighbouring queues' locks off the same cache line.
+    struct WorkerQueue {
+        std::mutex mutex;
+        TaskRing tasks;
+        char padding[64];
+    };
+
+    // Identifies the pool/worker that the current thread belongs to, if any.
+    struct WorkerContext {
+        const ThreadPool* pool = nullptr;
+        size_t index = 0;
+    };
+
+    static WorkerContext& CurrentWorker() {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    void submit(Task&& task) {
+        if (mode_ == Mode::SharedQueue) {
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+
+                // don't allow enqueueing after stopping the pool
+                if (stop)
+                    throw std::runtime_error("enqueue on stopped ThreadPool");
+
+                tasks.push_back(std::move(task));
+            }
+            condition.notify_one();
+            return;
+        }
+
+        if (stop)
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+
+        const WorkerContext& ctx = CurrentWorker();
+        const size_t index = (ctx.pool == this) ? ctx.index : next_queue_.fetch_add(1, std::memory_order_relaxed) % local_queues_.size();
+
+        // Counted before the task is visible: a worker taking it at once must not decrement pending_ below 0.
+        // pending_ must also be published before idle_ is read, see stealingWorkerLoop.
+        pending_.fetch_add(1);
+        try {
+            WorkerQueue& q = *local_queues_[index];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(std::move(task));
+        } catch (...) {
+            pending_.fetch_sub(1);
+            throw;
+        }
+
+        if (idle_.load() > 0) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            condition.notify_one();
+        }
+    }
+
+    void sharedWorkerLoop() {
+        for (;;) {
+            Task task;
+
+            {
+                std::unique_lock<std::mutex> lock(this->queue_mutex);
+                this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
+                if (this->stop && this->tasks.empty())
+                    return;
+                task = this->tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    // Owner takes the newest task from the back of its own deque.
+    bool popLocal(size_t index, Task& task) {
+        WorkerQueue& q = *local_queues_[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            return false;
+        task = q.tasks.pop_back();
+        return true;
+    }
+
+    // Thieves take the oldest task from the front of a victim's deque.
+    bool steal(size_t thief, Task& task) {
+        const size_t n = local_queues_.size();
+        for (size_t i = 1; i < n; ++i) {
+            WorkerQueue& q = *local_queues_[(thief + i) % n];
+            std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || q.tasks.empty())
+                continue;
+            task = q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void stealingWorkerLoop(size_t index) {
+        WorkerContext& ctx = CurrentWorker();
+        ctx.pool = this;
+        ctx.index = index;
+
+        for (;;) {
+            Task task;
+            if (popLocal(index, task) || steal(index, task)) {
+                pending_.fetch_sub(1);
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (pending_.load() > 0)  // try_lock in steal() may have skipped a busy victim
+                continue;
+            if (stop)
+                return;
+
+            idle_.fetch_add(1);
+            condition.wait(lock, [this] { return this->stop || this->pending_.load() > 0; });
+            idle_.fetch_sub(1);
+        }
+    }
+
+    // State shared by the participants of one parallelFor/parallelReduce call.
+    // Late helpers that start after the range is exhausted only touch this object, never the caller's stack.
+    template <class Index, class Body>
+    struct ParallelState {
+        ParallelState(Index b, Index e, Index g, size_t n, const Body& bd) :
+            next(b), end(e), grain(g), participants(n), active(0), body(bd) {}
+
+        // Guided self-scheduling: claim 1/(2*participants) of what is left, but never less than grain.
+        bool claim(Index& chunkBegin, Index& chunkEnd) {
+            Index cur = next.load();
+            for (;;) {
+                if (!(cur < end))
+                    return false;
+                const Index remaining = end - cur;
+                Index size = static_cast<Index>(remaining / static_cast<Index>(2 * participants));
+                if (size < grain)
+                    size = grain;
+                if (size > remaining)
+                    size = remaining;
+                if (next.compare_exchange_weak(cur, static_cast<Index>(cur + size))) {
+                    chunkBegin = cur;
+                    chunkEnd = static_cast<Index>(cur + size);
+                    return true;
+                }
+            }
+        }
+
+        void participate() {
+            active.fetch_add(1);
+            try {
+                body(*this);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+                next.store(end);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (active.fetch_sub(1) == 1)
+                done.notify_all();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return this->active.load() == 0; });
+        }
+
+        std::atomic<Index> next;
+        const Index end;
+        const Index grain;
+        const size_t participants;
+        std::atomic<size_t> active;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+        Body body;
+    };
+
+    template <class Index, class F>
+    struct ForBody {
+        explicit ForBody(F& f) :
+            fn(&f) {}
+
+        template <class State>
+        void operator()(State& state) {
+            Index b, e;
+            while (state.claim(b, e))
+                (*fn)(b, e);
+        }
+
+        F* fn;
+    };
+
+    template <class Index, class T, class Map, class Reduce>
+    struct ReduceBody {
+        ReduceBody(Map& m, Reduce& r, T& res) :
+            map(&m), reduce(&r), result(&res) {}
+
+        template <class State>
+        void operator()(State& state) {
+            Index b, e;
+            if (!state.claim(b, e))
+                return;
+            T partial = (*map)(b, e);
+            while (state.claim(b, e))
+                partial = (*reduce)(std::move(partial), (*map)(b, e));
+
+            std::lock_guard<std::mutex> lock(state.mutex);
+            *result = (*reduce)(std::move(*result), std::move(partial));
+        }
+
+        Map* map;
+        Reduce* reduce;
+        T* result;
+    };
+
+    template <class Index, class Body>
+    void runParallel(Index begin, Index end, Index grain, const Body& body) {
+        if (!(begin < end))
+            return;
+        if (grain < static_cast<Index>(1))
+            grain = static_cast<Index>(1);
+
+        const size_t participants = workers.size() + 1;
+        auto state = std::make_shared<ParallelState<Index, Body>>(begin, end, grain, participants, body);
+
+        const Index chunks = static_cast<Index>((end - begin - 1) / grain + 1);
+        size_t helpers = workers.size();
+        if (static_cast<size_t>(chunks) - 1 < helpers)
+            helpers = static_cast<size_t>(chunks) - 1;
+        for (size_t i = 0; i < helpers; ++i)
+            submit(Task([state]() { state->participate(); }));
+
+        state->participate();
+        state->wait();
+
+        if (state->error)
+            std::rethrow_exception(state->error);
+    }
+
+    const Mode mode_;
+
     // need to keep track of threads so we can join them
     std::vector<std::thread> workers;
     // the task queue
-    std::queue<std::function<void()>> tasks;
+    TaskRing tasks;
 
     // synchronization
     std::mutex queue_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<bool> stop;
+
+    // WorkStealing mode only.
+    std::vector<std::unique_ptr<WorkerQueue>> local_queues_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> idle_;
+    std::atomic<size_t> next_queue_;
 };
 }  // namespace jhc
 
@@ -26,26 +26,78 @@
 #include <chrono>
 
 namespace jhc {
+class ThreadPool;
+
 // On Windows, the Timer has 10ms precision loss.
 //
 class Timer {
    public:
     using handler_t = std::function<void(std::size_t)>;
+    using executor_t = std::function<void(std::function<void()>&&)>;
+
+    // How pending timeouts are stored.
+    //
+    enum class Backend {
+        // Timeouts are kept sorted by expiry time.
+        // add is O(log n), remove is O(log n), handlers fire at the exact expiry time.
+        OrderedSet,
+        // Hierarchical timing wheel (6 levels of 64 slots).
+        // add and remove are O(1), expiry is rounded up to the next tick.
+        TimingWheel
+    };
+
+    // What a periodic timer does when it falls behind, e.g. because its handler took longer than its period.
+    //
+    enum class Missed {
+        // Fire once for every missed period, back to back, until the timer is on schedule again.
+        CatchUp,
+        // Drop the missed periods and fire at the next period boundary after now.
+        // An executor invocation is also dropped while the previous one of the same timer is still running.
+        Skip
+    };
 
     Timer();
+
+    // tick is the resolution of the TimingWheel backend and is ignored by OrderedSet.
+    //
+    explicit Timer(Backend backend, const std::chrono::microseconds& tick = std::chrono::milliseconds(1));
+
     ~Timer();
 
+    Backend backend() const;
+
+    // Handlers run on executor instead of the timer thread, so a slow handler no longer delays other timeouts.
+    // Periodic timers are rescheduled when they are dispatched, not when their handler returns.
+    // With Missed::CatchUp, handlers of the same periodic timer may run concurrently on a multi-threaded executor.
+    // The executor must run every task it is given; the Timer destructor waits for them.
+    // Pass an empty executor to run handlers on the timer thread again.
+    //
+    void setExecutor(executor_t executor);
+
+    // Same as above, tasks are posted to pool without wrapping them in a std::function.
+    // pool must outlive the Timer.
+    //
+    void setExecutor(ThreadPool& pool);
+
+    // Default is Missed::CatchUp.
+    //
+    void setMissedPolicy(Missed missed);
+
     /**
 	 * Add a new timer.
 	 *
 	 * \param when The time at which the handler is invoked.
 	 * \param handler The callable that is invoked when the timer fires.
 	 * \param period The periodicity at which the timer fires. Only used for periodic timers.
+	 * \param slack How late the handler may be invoked, i.e. it fires in [when, when + slack].
+	 *        Timers with overlapping windows are aligned to the same instant and expire in one batch,
+	 *        which saves wakeups of the timer thread when many of them are pending.
 	 */
     std::size_t add(
         const std::chrono::time_point<std::chrono::steady_clock>& when,
         handler_t&& handler,
-        const std::chrono::microseconds& period = std::chrono::microseconds::zero());
+        const std::chrono::microseconds& period = std::chrono::microseconds::zero(),
+        const std::chrono::microseconds& slack = std::chrono::microseconds::zero());
 
     /**
 	 * Overloaded `add` function that uses a `std::chrono::duration` instead of a
@@ -54,17 +106,22 @@ class Timer {
     template <class Rep, class Period>
     inline std::size_t add(const std::chrono::duration<Rep, Period>& when,
                            handler_t&& handler,
-                           const std::chrono::microseconds& period = std::chrono::microseconds::zero()) {
+                           const std::chrono::microseconds& period = std::chrono::microseconds::zero(),
+                           const std::chrono::microseconds& slack = std::chrono::microseconds::zero()) {
         return add(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::microseconds>(when),
                    std::move(handler),
-                   period);
+                   period,
+                   slack);
     }
 
     /**
 	 * Overloaded `add` function that uses a uint64_t instead of a `time_point` for
 	 * the first timeout and the period.
 	 */
-    std::size_t add(const uint64_t afterMicroseconds, handler_t&& handler, const uint64_t periodMicroseconds = 0);
+    std::size_t add(const uint64_t afterMicroseconds,
+                    handler_t&& handler,
+                    const uint64_t periodMicroseconds = 0,
+                    const uint64_t slackMicroseconds = 0);
 
     /**
 	 * Removes the timer with the given id.
@@ -0,0 +1,143 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef JHC_XXHASH_HPP__
+#define JHC_XXHASH_HPP__
+#pragma once
+
+#include "jhc/config.hpp"
+#include <stdint.h>
+#include <string>
+#ifndef _WINSOCKAPI_
+#define _WINSOCKAPI_
+#endif  // !_WINSOCKAPI_
+#include "jhc/filesystem.hpp"
+#include "jhc/hasher.hpp"
+
+namespace jhc {
+namespace xxhash_detail {
+// Streaming state of XXH3Hash64 and XXH3Hash128.
+//
+struct State {
+    uint64_t acc[8];
+    unsigned char secret[192];  // derived from the seed
+    unsigned char buffer[256];  // input not consumed yet, ends with the last consumed stripe
+    size_t bufferedSize;
+    size_t stripesSoFar;  // stripes consumed in the current block
+    uint64_t totalLen;
+    uint64_t seed;
+};
+}  // namespace xxhash_detail
+
+// XXH3 64-bit from xxHash 0.8, a fast non-cryptographic hash for hash tables, deduplication and sharding.
+// This is not the classic XXH64 (xxhsum's default -H1), the values differ.
+// Values match the reference implementation (xxhsum -H3). Keys up to 16 bytes take a couple of
+// multiplications; long inputs are consumed in 64-byte stripes by SSE2 or AVX2 kernels.
+//
+class XXH3Hash64 {
+   public:
+    enum class Kernel {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    enum { kDigestSize = 8 };
+    typedef std::array<uint8_t, kDigestSize> Digest;  // value(), big-endian
+
+    XXH3Hash64();
+    explicit XXH3Hash64(uint64_t seed);
+
+    // Starts over with the same seed.
+    //
+    void init();
+
+    void update(const void* data, size_t size);
+
+    // The hash of the data so far. The state is left as is, update() can go on.
+    //
+    uint64_t value() const;
+
+    // value() as a Digest, see hasher.hpp.
+    //
+    Digest finalize() const;
+
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+    // Same as above with a given kernel, which must be supported.
+    //
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed, Kernel kernel);
+
+    static std::string GetFileXXH3Hash64(const fs::path& filePath);
+    static std::string GetDataXXH3Hash64(const unsigned char* data, size_t dataSize);
+
+    static bool IsKernelSupported(Kernel kernel);
+
+    // The kernel used by update() and Hash() on this CPU.
+    //
+    static Kernel ActiveKernel();
+
+   private:
+    xxhash_detail::State state_;
+};
+
+// XXH3 128-bit (xxhsum -H128), for when collisions among billions of items must stay negligible,
+// e.g. content addressing. Costs about the same as XXH3Hash64 on long inputs.
+//
+class XXH3Hash128 {
+   public:
+    typedef XXH3Hash64::Kernel Kernel;
+
+    struct Value {
+        uint64_t low;
+        uint64_t high;
+
+        bool operator==(const Value& other) const { return low == other.low && high == other.high; }
+        bool operator!=(const Value& other) const { return !(*this == other); }
+    };
+
+    enum { kDigestSize = 16 };
+    typedef std::array<uint8_t, kDigestSize> Digest;  // high then low, big-endian
+
+    XXH3Hash128();
+    explicit XXH3Hash128(uint64_t seed);
+
+    void init();
+
+    void update(const void* data, size_t size);
+
+    Value value() const;
+
+    Digest finalize() const;
+
+    static Value Hash(const void* data, size_t size, uint64_t seed = 0);
+    static Value Hash(const void* data, size_t size, uint64_t seed, Kernel kernel);
+
+    static std::string GetFileXXH3Hash128(const fs::path& filePath);
+    static std::string GetDataXXH3Hash128(const unsigned char* data, size_t dataSize);
+
+   private:
+    xxhash_detail::State state_;
+};
+}  // namespace jhc
+
+#ifndef JHC_NOT_HEADER_ONLY
+#include "impl/xxhash.cc"
+#endif
+#endif  // !JHC_XXHASH_HPP__
@@ -26,29 +26,41 @@
 
 #include "jhc/config.hpp"
 #include "jhc/arch.hpp"
+#include "jhc/append_log.hpp"
+#include "jhc/async_file.hpp"
 #include "jhc/base64.hpp"
 #include "jhc/buffer_queue.hpp"
+#include "jhc/ring_buffer_queue.hpp"
 #include "jhc/cmd_line_parse.hpp"
 #include "jhc/event.hpp"
 #include "jhc/enum_flags.hpp"
 #include "jhc/file.hpp"
+#include "jhc/file_copy.hpp"
+#include "jhc/file_digest.hpp"
+#include "jhc/file_writer.hpp"
 #include "jhc/filesystem.hpp"
+#include "jhc/hasher.hpp"
 #include "jhc/hex_encode.hpp"
 #include "jhc/ipaddress.hpp"
 #include "jhc/json.hpp"
 #include "jhc/macros.hpp"
 #include "jhc/md5.hpp"
+#include "jhc/cpu_features.hpp"
 #include "jhc/crc32.hpp"
+#include "jhc/xxhash.hpp"
 #include "jhc/sha1.hpp"
 #include "jhc/sha256.hpp"
 #include "jhc/sha512.hpp"
 #include "jhc/memory_pool.hpp"
+#include "jhc/monotonic_arena.hpp"
+#include "jhc/size_class_pool.hpp"
 #include "jhc/os_ver.hpp"
 #include "jhc/optional.hpp"
 #include "jhc/path_util.hpp"
 #include "jhc/process.hpp"
 #include "jhc/process_util.hpp"
 #include "jhc/scoped_object.hpp"
+#include "jhc/sharded_timer.hpp"
 #include "jhc/singleton_class.hpp"
 #include "jhc/singleton_process.hpp"
 #include "jhc/string_helper.hpp"
@@ -0,0 +1,88 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "catch.hpp"
+#include "jhc/buffer_queue.hpp"
+#include "jhc/ring_buffer_queue.hpp"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+template <class Push, class Pop>
+static void RunQueueBenchmark(const char* name, int producerNum, int consumerNum, size_t msgPerProducer, Push push, Pop pop) {
+    const size_t total = msgPerProducer * producerNum;
+    std::atomic<size_t> popped(0);
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int p = 0; p < producerNum; p++) {
+        threads.emplace_back([&]() {
+            char msg[64] = {0};
+            for (size_t i = 0; i < msgPerProducer; i++) {
+                while (!push(msg, sizeof(msg)))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (int c = 0; c < consumerNum; c++) {
+        threads.emplace_back([&]() {
+            char msg[64];
+            while (popped.load() < total) {
+                if (pop(msg, sizeof(msg)) > 0)
+                    popped++;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-20s %dP/%dC %12.0f msgs/s\n", name, producerNum, consumerNum, total / seconds);
+}
+
+// Benchmark: BufferQueue (with and without slabs) vs RingBufferQueue as a hand-off between threads.
+// Hidden by default, run with: jhc-test [benchmark]
+//
+TEST_CASE("BufferQueueBenchmark", "[.][benchmark]") {
+    const size_t msgPerProducer = 500000;
+
+    for (int threads : {1, 4}) {
+        jhc::BufferQueue bq;
+        RunQueueBenchmark(
+            "BufferQueue", threads, threads, msgPerProducer,
+            [&bq](void* p, size_t n) { return bq.pushElementToLast(p, n); },
+            [&bq](void* p, size_t n) { return bq.popElementFromFront(p, n); });
+
+        jhc::BufferQueue sq("slab", 1024 * 1024);
+        RunQueueBenchmark(
+            "BufferQueue(slab)", threads, threads, msgPerProducer,
+            [&sq](void* p, size_t n) { return sq.pushElementToLast(p, n); },
+            [&sq](void* p, size_t n) { return sq.popElementFromFront(p, n); });
+
+        jhc::RingBufferQueue rq(4096, 64);
+        RunQueueBenchmark(
+            "RingBufferQueue", threads, threads, msgPerProducer,
+            [&rq](void* p, size_t n) { return rq.pushElementToLast(p, n); },
+            [&rq](void* p, size_t n) { return rq.popElementFromFront(p, n); });
+    }
+}
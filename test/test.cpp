@@ -22,6 +22,9 @@
 #include <time.h>
 #include <iostream>
 #include <map>
+#include <unordered_set>
+#include <array>
+#include <thread>
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 //
@@ -104,6 +107,463 @@ TEST_CASE("FileTest2", "[read all content]") {
     REQUIRE(strAll.size() == bytes4mb);
 }
 
+TEST_CASE("FileTest3", "[memory mapped file]") {
+    std::string content;
+    for (size_t i = 0; i < 300000; i++)
+        content.push_back((char)(i * 31 % 251));
+
+    jhc::fs::path path3(u8"__file_test_文件测试3__.dat");
+    if (jhc::fs::exists(path3))
+        REQUIRE(jhc::fs::remove(path3));
+
+    {
+        jhc::File file3(path3);
+        REQUIRE(file3.open("wb+"));
+        REQUIRE(file3.writeFrom(content.data(), content.size()) == content.size());
+        // Unflushed writes are visible to the size and the view.
+        REQUIRE(file3.fileSize() == (int64_t)content.size());
+
+        jhc::FileMapping whole = file3.map();
+        REQUIRE(whole.isValid());
+        REQUIRE(!whole.isWritable());
+        REQUIRE(whole.size() == content.size());
+        REQUIRE(memcmp(whole.data(), content.data(), content.size()) == 0);
+        REQUIRE(whole.advise(jhc::FileMapping::Advice::Sequential));
+        REQUIRE(whole.advise(jhc::FileMapping::Advice::WillNeed, 5000, 10000));
+
+        // Unaligned offset, clipped at the end of the file.
+        jhc::FileMapping part = file3.map(jhc::File::MapMode::ReadOnly, 5001, 1000000);
+        REQUIRE(part.isValid());
+        REQUIRE(part.size() == content.size() - 5001);
+        REQUIRE(memcmp(part.data(), content.data() + 5001, part.size()) == 0);
+
+        REQUIRE(!file3.map(jhc::File::MapMode::ReadOnly, content.size() + 1).isValid());
+        REQUIRE(file3.map(jhc::File::MapMode::ReadOnly, content.size()).empty());
+
+        // The view outlives the file.
+        REQUIRE(file3.close());
+        REQUIRE(!file3.map().isValid());
+        REQUIRE(whole[299999] == (unsigned char)content[299999]);
+
+        jhc::FileMapping moved = std::move(whole);
+        REQUIRE(!whole.isValid());
+        REQUIRE(moved.size() == content.size());
+    }
+
+    {
+        jhc::FileMapping view = jhc::File::MapFile(path3, jhc::File::MapMode::ReadWrite);
+        REQUIRE(view.isValid());
+        REQUIRE(view.isWritable());
+        for (size_t i = 0; i < view.size(); i += 4096)
+            view[i] = 'x';
+        REQUIRE(view.flush());
+    }
+    for (size_t i = 0; i < content.size(); i += 4096)
+        content[i] = 'x';
+
+    {
+        // A writable view past the end grows the file.
+        jhc::File file3(path3);
+        REQUIRE(file3.open("rb+"));
+        jhc::FileMapping tail = file3.map(jhc::File::MapMode::ReadWrite, content.size(), 100);
+        REQUIRE(tail.isValid());
+        REQUIRE(file3.fileSize() == (int64_t)content.size() + 100);
+        memset(tail.data(), 'y', tail.size());
+        REQUIRE(tail.flush(true));
+    }
+    content.append(100, 'y');
+
+    jhc::File file3(path3);
+    REQUIRE(file3.open("rb"));
+    REQUIRE(file3.readAll() == content);
+}
+
+TEST_CASE("FileTest4", "[positional io]") {
+    const size_t size4 = 1024 * 1024 + 123;
+    std::string content;
+    for (size_t i = 0; i < size4; i++)
+        content.push_back((char)(i * 7 % 253));
+
+    jhc::fs::path path4(u8"__file_test_文件测试4__.dat");
+    if (jhc::fs::exists(path4))
+        REQUIRE(jhc::fs::remove(path4));
+
+    jhc::File file4(path4);
+    REQUIRE(file4.open("wb+"));
+    // Written back to front, no cursor involved.
+    REQUIRE(file4.writeAt(content.data() + 4096, size4 - 4096, 4096) == size4 - 4096);
+    REQUIRE(file4.writeAt(content.data(), 4096, 0) == 4096);
+    REQUIRE(file4.fileSize() == (int64_t)size4);
+
+    // Concurrent readers of disjoint ranges.
+    const int threads = 8;
+    const size_t part = size4 / threads;
+    std::vector<std::string> parts(threads);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < threads; t++) {
+        readers.emplace_back([&, t]() {
+            const size_t begin = t * part;
+            const size_t end = (t == threads - 1) ? size4 : begin + part;
+            parts[t].resize(end - begin);
+            for (size_t pos = begin; pos < end; pos += 1000) {
+                const size_t n = std::min<size_t>(1000, end - pos);
+                if (file4.readAt(&parts[t][pos - begin], n, pos) != n)
+                    break;
+            }
+        });
+    }
+    for (auto& reader : readers)
+        reader.join();
+    for (int t = 0; t < threads; t++)
+        REQUIRE(parts[t] == content.substr(t * part, parts[t].size()));
+
+    // Vectored, with an empty buffer in the middle.
+    const std::string a(3000, 'a'), c(5000, 'c');
+    const jhc::File::WriteBuffer out[3] = {{a.data(), a.size()}, {nullptr, 0}, {c.data(), c.size()}};
+    REQUIRE(file4.writeAt(out, 3, size4 - 1000) == 8000);
+    REQUIRE(file4.fileSize() == (int64_t)size4 + 7000);
+
+    std::string x(2000, '\0'), y(7000, '\0');
+    const jhc::File::ReadBuffer in[2] = {{&x[0], x.size()}, {&y[0], y.size()}};
+    REQUIRE(file4.readAt(in, 2, size4 - 2000) == 9000);
+    REQUIRE(x.substr(0, 1000) == content.substr(size4 - 2000, 1000));
+    REQUIRE(x.substr(1000) == std::string(1000, 'a'));
+    REQUIRE(y == std::string(2000, 'a') + c);
+
+    // Short read at the end of the file.
+    std::string tail(100, '\0');
+    REQUIRE(file4.readAt(&tail[0], 100, size4 + 6950) == 50);
+    REQUIRE(file4.readAt(&tail[0], 100, size4 + 7000) == 0);
+    REQUIRE(file4.readAt(&tail[0], 100, -1) == 0);
+
+    REQUIRE(file4.close());
+    REQUIRE(file4.readAt(&tail[0], 100, 0) == 0);
+    REQUIRE(file4.writeAt(tail.data(), 100, 0) == 0);
+    REQUIRE(jhc::fs::remove(path4));
+}
+
+// Test: asynchronous file I/O.
+//
+TEST_CASE("AsyncFileTest1", "[async file io]") {
+    const size_t chunk = 64 * 1024;
+    const size_t chunks = 40;
+    std::string content;
+    for (size_t i = 0; i < chunk * chunks; i++)
+        content.push_back((char)(i * 13 % 251));
+
+    jhc::fs::path path5(u8"__file_test_文件测试5__.dat");
+    const jhc::AsyncFileEngine::Backend backends[] = {jhc::AsyncFileEngine::Backend::Auto, jhc::AsyncFileEngine::Backend::Threads};
+    for (jhc::AsyncFileEngine::Backend backend : backends) {
+        if (jhc::fs::exists(path5))
+            REQUIRE(jhc::fs::remove(path5));
+
+        jhc::AsyncFileEngine engine(8, backend);
+        if (backend == jhc::AsyncFileEngine::Backend::Threads)
+            REQUIRE(engine.backend() == jhc::AsyncFileEngine::Backend::Threads);
+        REQUIRE(engine.queueDepth() == 8);
+
+        jhc::File file5(path5);
+        std::string buffer(100, '\0');
+        REQUIRE(!engine.read(file5, &buffer[0], buffer.size(), 0, nullptr));
+        REQUIRE(engine.read(file5, &buffer[0], buffer.size(), 0).get() == -EBADF);
+        REQUIRE(file5.open("wb+"));
+
+        // Writes in reverse order, more than the queue depth.
+        std::atomic<size_t> written(0);
+        for (size_t i = chunks; i > 0; i--) {
+            const size_t at = (i - 1) * chunk;
+            REQUIRE(engine.write(file5, content.data() + at, chunk, at, [&written](int64_t r) { written += (size_t)r; }));
+            if (i % 4 == 0)
+                engine.submit();
+        }
+        engine.wait();
+        REQUIRE(engine.pending() == 0);
+        REQUIRE(written == content.size());
+
+        std::future<int64_t> synced = engine.sync(file5);
+        engine.submit();
+        REQUIRE(synced.get() == 0);
+
+        // Futures, a read across the end of the file.
+        std::string head(chunk, '\0'), tail(2 * chunk, '\0');
+        std::future<int64_t> r1 = engine.read(file5, &head[0], head.size(), 0);
+        std::future<int64_t> r2 = engine.read(file5, &tail[0], tail.size(), content.size() - chunk);
+        engine.submit();
+        REQUIRE(r1.get() == (int64_t)chunk);
+        REQUIRE(r2.get() == (int64_t)chunk);
+        REQUIRE(head == content.substr(0, chunk));
+        REQUIRE(tail.substr(0, chunk) == content.substr(content.size() - chunk));
+
+        // Every completion queues the next chunk, 4 reads in flight.
+        std::string copy(content.size(), '\0');
+        std::atomic<size_t> next(0);
+        std::atomic<size_t> read(0);
+        std::function<void(int64_t)> onRead;
+        auto readNext = [&]() {
+            const size_t i = next++;
+            if (i < chunks)
+                engine.read(file5, &copy[i * chunk], chunk, i * chunk, onRead);
+        };
+        onRead = [&](int64_t r) {
+            read += (size_t)r;
+            readNext();
+            engine.submit();
+        };
+        for (int i = 0; i < 4; i++)
+            readNext();
+        engine.wait();
+        REQUIRE(read == content.size());
+        REQUIRE(copy == content);
+
+        // Re-queue from a callback: the freed slot is taken, then the full queue fails instead of blocking.
+        {
+            jhc::AsyncFileEngine single(1, backend);
+            std::string first(chunk, '\0'), second(chunk, '\0');
+            std::atomic<int64_t> secondRead(0);
+            bool requeued = false;
+            bool overflow = true;
+            int64_t overflowResult = 0;
+            REQUIRE(single.read(file5, &first[0], chunk, 0, [&](int64_t) {
+                requeued = single.read(file5, &second[0], chunk, chunk, [&](int64_t r) { secondRead = r; });
+                overflow = single.read(file5, &second[0], chunk, 0, nullptr);
+                overflowResult = single.read(file5, &second[0], chunk, 0).get();
+                single.submit();
+            }));
+            single.wait();
+            REQUIRE(requeued);
+            REQUIRE(!overflow);
+            REQUIRE(overflowResult == -EAGAIN);
+            REQUIRE(secondRead == (int64_t)chunk);
+            REQUIRE(second == content.substr(chunk, chunk));
+        }
+
+        REQUIRE(file5.close());
+        REQUIRE(jhc::fs::remove(path5));
+    }
+}
+
+// Test: streaming file writer.
+//
+TEST_CASE("FileWriterTest1", "[file writer]") {
+    std::string content;
+    for (size_t i = 0; i < 3 * 1024 * 1024 + 777; i++)
+        content.push_back((char)(i * 17 % 241));
+
+    jhc::fs::path path6(u8"__file_test_文件测试6__.dat");
+    for (bool direct : {false, true}) {
+        if (jhc::fs::exists(path6))
+            REQUIRE(jhc::fs::remove(path6));
+
+        jhc::FileWriter writer(100 * 1024, 3);
+        REQUIRE(!writer.write("x", 1));
+        REQUIRE(writer.open(path6, false, direct));
+        REQUIRE(writer.isOpen());
+
+        // Odd sizes, larger and smaller than the buffers, a flush in the middle of a block.
+        size_t pos = 0;
+        for (size_t n = 1; pos < content.size(); n = n * 3 + 1) {
+            const size_t size = std::min(n % 300000, content.size() - pos);
+            REQUIRE(writer.write(content.data() + pos, size));
+            pos += size;
+            if (pos > 1000000 && pos - size <= 1000000) {
+                REQUIRE(writer.flush());
+                REQUIRE(jhc::fs::file_size(path6) == pos);
+            }
+        }
+        REQUIRE(writer.size() == (int64_t)content.size());
+        REQUIRE(writer.sync());
+        REQUIRE(writer.close());
+        REQUIRE(!writer.isOpen());
+        REQUIRE(jhc::fs::file_size(path6) == content.size());
+
+        // Appending to an unaligned size.
+        const std::string more(5000, 'm');
+        REQUIRE(writer.open(path6, true, direct));
+        REQUIRE(writer.size() == (int64_t)content.size());
+        REQUIRE(writer.write(more.data(), more.size()));
+        REQUIRE(writer.close());
+
+        jhc::File file6(path6);
+        REQUIRE(file6.open("rb"));
+        REQUIRE(file6.readAll() == content + more);
+        REQUIRE(file6.close());
+    }
+    REQUIRE(jhc::fs::remove(path6));
+}
+
+// Test: durable append log.
+//
+TEST_CASE("AppendLogTest1", "[append log]") {
+    jhc::fs::path path7(u8"__file_test_文件测试7__.log");
+    if (jhc::fs::exists(path7))
+        REQUIRE(jhc::fs::remove(path7));
+
+    const int threads = 8;
+    const int perThread = 50;
+    auto record = [](int t, int i) { return std::string((size_t)(t * 37 + i * 11) % 300, (char)('a' + t)) + std::to_string(i); };
+
+    jhc::AppendLog log;
+    REQUIRE(log.append("x", 1) == -1);
+    REQUIRE(log.open(path7));
+    REQUIRE(log.recordCount() == 0);
+
+    std::vector<std::vector<int64_t>> offsets(threads);
+    std::vector<std::thread> appenders;
+    for (int t = 0; t < threads; t++) {
+        appenders.emplace_back([&, t]() {
+            for (int i = 0; i < perThread; i++) {
+                const std::string r = record(t, i);
+                offsets[t].push_back(log.append(r.data(), r.size()));
+            }
+        });
+    }
+    for (auto& appender : appenders)
+        appender.join();
+
+    REQUIRE(log.recordCount() == threads * perThread);
+    REQUIRE(log.commitCount() > 0);
+    REQUIRE(log.commitCount() <= threads * perThread);
+    REQUIRE(log.size() == (int64_t)jhc::fs::file_size(path7));
+
+    std::map<int64_t, std::string> replayed;
+    REQUIRE(log.replay([&replayed](const void* data, size_t size, int64_t offset) {
+        replayed[offset].assign((const char*)data, size);
+        return true;
+    }));
+    REQUIRE(replayed.size() == threads * perThread);
+    for (int t = 0; t < threads; t++) {
+        for (int i = 0; i < perThread; i++)
+            REQUIRE(replayed[offsets[t][i]] == record(t, i));
+    }
+    REQUIRE(log.close());
+
+    // A torn frame at the end is cut.
+    const int64_t size7 = (int64_t)jhc::fs::file_size(path7);
+    {
+        jhc::File file7(path7);
+        REQUIRE(file7.open("ab"));
+        const unsigned char torn[12] = {100, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+        REQUIRE(file7.writeFrom(torn, sizeof(torn)) == sizeof(torn));
+        REQUIRE(file7.close());
+    }
+    REQUIRE(log.open(path7));
+    REQUIRE(log.recordCount() == threads * perThread);
+    REQUIRE(log.size() == size7);
+    REQUIRE((int64_t)jhc::fs::file_size(path7) == size7);
+
+    const std::string last = "last record";
+    REQUIRE(log.append(last.data(), last.size()) == size7);
+    REQUIRE(log.recordCount() == threads * perThread + 1);
+    REQUIRE(log.close());
+
+    // So is a frame with a bad CRC.
+    {
+        jhc::File file7(path7);
+        REQUIRE(file7.open("rb+"));
+        REQUIRE(file7.writeAt("L", 1, size7 + jhc::AppendLog::kHeaderSize) == 1);
+        REQUIRE(file7.close());
+    }
+    REQUIRE(log.open(path7));
+    REQUIRE(log.recordCount() == threads * perThread);
+    REQUIRE(log.size() == size7);
+
+    size_t visited = 0;
+    REQUIRE(log.replay([&visited](const void*, size_t, int64_t) { return ++visited < 10; }));
+    REQUIRE(visited == 10);
+
+    // close() waits for a replay running on another thread.
+    std::atomic<bool> replaying(false);
+    std::atomic<uint64_t> replayedRecords(0);
+    std::thread replayer([&]() {
+        log.replay([&](const void*, size_t, int64_t) {
+            replaying = true;
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+            replayedRecords++;
+            return true;
+        });
+    });
+    while (!replaying)
+        std::this_thread::yield();
+    REQUIRE(log.close());
+    REQUIRE(replayedRecords == threads * perThread);
+    replayer.join();
+    REQUIRE(jhc::fs::remove(path7));
+}
+
+// Test: file copy.
+//
+TEST_CASE("FileCopyTest1", "[file copy]") {
+    auto writeFile = [](const jhc::fs::path& path, const std::string& content) {
+        jhc::File file(path);
+        return file.open("wb") && file.writeFrom(content.data(), content.size()) == content.size() && file.close();
+    };
+    auto readFile = [](const jhc::fs::path& path) {
+        jhc::File file(path);
+        return file.open("rb") ? file.readAll() : std::string("<missing>");
+    };
+
+    std::string content;
+    for (size_t i = 0; i < 3 * 1024 * 1024 + 5; i++)
+        content.push_back((char)(i * 29 % 239));
+
+    const jhc::fs::path root(u8"__file_test_文件测试8__");
+    std::error_code ec;
+    jhc::fs::remove_all(root, ec);
+    REQUIRE(jhc::fs::create_directories(root / "src" / "a" / "b"));
+    REQUIRE(jhc::fs::create_directories(root / "src" / "empty"));
+    REQUIRE(writeFile(root / "src" / "big.dat", content));
+    REQUIRE(writeFile(root / "src" / "zero.dat", ""));
+    for (int i = 0; i < 20; i++)
+        REQUIRE(writeFile(root / "src" / "a" / "b" / (std::to_string(i) + ".txt"), std::string((size_t)i * 1000, (char)('a' + i))));
+
+    jhc::FileCopy::Method method = jhc::FileCopy::Method::Chunked;
+    REQUIRE(jhc::FileCopy::Copy(root / "src" / "big.dat", root / "copy.dat", &method));
+    REQUIRE(readFile(root / "copy.dat") == content);
+    REQUIRE(!jhc::FileCopy::Copy(root / "copy.dat", root / "copy.dat"));
+    REQUIRE(!jhc::FileCopy::Copy(root / "missing.dat", root / "copy2.dat"));
+
+    REQUIRE(jhc::FileCopy::CopyWith(root / "src" / "big.dat", root / "chunked.dat", jhc::FileCopy::Method::Chunked));
+    REQUIRE(readFile(root / "chunked.dat") == content);
+    const jhc::FileCopy::Method methods[] = {jhc::FileCopy::Method::System, jhc::FileCopy::Method::Clone,
+                                             jhc::FileCopy::Method::CopyFileRange, jhc::FileCopy::Method::Sendfile};
+    for (jhc::FileCopy::Method m : methods) {
+        // Not every method is supported everywhere, but a copy that succeeds must be right.
+        if (jhc::FileCopy::CopyWith(root / "src" / "big.dat", root / "method.dat", m))
+            REQUIRE(readFile(root / "method.dat") == content);
+    }
+
+    REQUIRE(jhc::FileCopy::CopyDirectory(root / "src", root / "dst", 4));
+    REQUIRE(jhc::fs::is_directory(root / "dst" / "empty"));
+    REQUIRE(readFile(root / "dst" / "big.dat") == content);
+    REQUIRE(jhc::fs::file_size(root / "dst" / "zero.dat") == 0);
+    for (int i = 0; i < 20; i++) {
+        const jhc::fs::path name = jhc::fs::path("a") / "b" / (std::to_string(i) + ".txt");
+        REQUIRE(readFile(root / "dst" / name) == readFile(root / "src" / name));
+    }
+    REQUIRE(!jhc::FileCopy::CopyDirectory(root / "missing", root / "dst2"));
+
+#ifdef JHC_LINUX
+    // procfs reports a size of 0 and copy_file_range/sendfile copy nothing, the data must still be copied.
+    std::string proc;
+    FILE* f = fopen("/proc/version", "rb");
+    REQUIRE(f);
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        proc.append(buf, n);
+    fclose(f);
+    REQUIRE(!proc.empty());
+    REQUIRE(jhc::FileCopy::Copy("/proc/version", root / "proc.txt", &method));
+    REQUIRE(method == jhc::FileCopy::Method::Chunked);
+    REQUIRE(readFile(root / "proc.txt") == proc);
+    REQUIRE(!jhc::FileCopy::CopyWith("/proc/version", root / "proc2.txt", jhc::FileCopy::Method::CopyFileRange));
+    REQUIRE(!jhc::FileCopy::CopyWith("/proc/version", root / "proc3.txt", jhc::FileCopy::Method::Sendfile));
+#endif
+
+    jhc::fs::remove_all(root, ec);
+    REQUIRE(!ec);
+}
+
 // Test: string hash.
 //
 TEST_CASE("HashTest1", "[stirng hash]") {
@@ -138,6 +598,304 @@ TEST_CASE("HashTest2", "[file hash]") {
 #endif
 }
 
+// Test: crc32/crc32c kernels and combine.
+//
+TEST_CASE("HashTest3", "[crc32]") {
+    REQUIRE(jhc::CRC32::Update(0, "123456789", 9) == 0xCBF43926);
+    REQUIRE(jhc::CRC32C::Update(0, "123456789", 9) == 0xE3069283);
+    REQUIRE(jhc::CRC32C::GetDataCRC32C((const unsigned char*)"123456789", 9) == "e3069283");
+
+    std::vector<unsigned char> data(3 * 4096 * 2 + 123);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 2654435761u >> 13);
+
+    for (size_t offset : {0, 1, 7}) {
+        for (size_t size : {0, 1, 15, 63, 64, 100, 4096, 3 * 4096 + 5, 3 * 4096 * 2}) {
+            const unsigned char* p = data.data() + offset;
+            const uint32_t crc = jhc::CRC32::Update(0, p, size, jhc::CRC32::Kernel::Bytewise);
+            const uint32_t crcc = jhc::CRC32C::Update(0, p, size, jhc::CRC32C::Kernel::Bytewise);
+
+            for (auto kernel : {jhc::CRC32::Kernel::Slicing8, jhc::CRC32::Kernel::Slicing16, jhc::CRC32::Kernel::Pclmul}) {
+                if (jhc::CRC32::IsKernelSupported(kernel))
+                    REQUIRE(jhc::CRC32::Update(0, p, size, kernel) == crc);
+            }
+            for (auto kernel : {jhc::CRC32C::Kernel::Slicing8, jhc::CRC32C::Kernel::Slicing16, jhc::CRC32C::Kernel::Sse42}) {
+                if (jhc::CRC32C::IsKernelSupported(kernel))
+                    REQUIRE(jhc::CRC32C::Update(0, p, size, kernel) == crcc);
+            }
+
+            jhc::CRC32 c;
+            c.init();
+            c.update(p, size / 3);
+            c.update(p + size / 3, size - size / 3);
+            c.finish();
+            REQUIRE(c.value() == crc);
+
+            const size_t cut = size / 3;
+            REQUIRE(jhc::CRC32::Combine(jhc::CRC32::Update(0, p, cut), jhc::CRC32::Update(0, p + cut, size - cut), size - cut) == crc);
+            REQUIRE(jhc::CRC32C::Combine(jhc::CRC32C::Update(0, p, cut), jhc::CRC32C::Update(0, p + cut, size - cut), size - cut) == crcc);
+        }
+    }
+}
+
+// Test: multi-algorithm file digest.
+//
+TEST_CASE("HashTest4", "[file digest]") {
+    std::string content;
+    for (size_t i = 0; i < 5 * 1024 * 1024 + 333; i++)
+        content.push_back((char)(i * 131 >> 7));
+    jhc::File file("file_digest_test.dat");
+    REQUIRE(file.open("wb"));
+    REQUIRE(file.writeFrom(content.data(), content.size(), 0) == content.size());
+    REQUIRE(file.close());
+
+    const unsigned char* data = (const unsigned char*)content.data();
+    const unsigned int all = jhc::FileDigest::ALG_CRC32 | jhc::FileDigest::ALG_CRC32C | jhc::FileDigest::ALG_MD5 |
+                             jhc::FileDigest::ALG_SHA1 | jhc::FileDigest::ALG_SHA256 | jhc::FileDigest::ALG_SHA512;
+
+    jhc::ThreadPool pool(3);
+    for (size_t threads : {0, 1, 4}) {
+        for (size_t chunkSize : {64 * 1024, 4 * 1024 * 1024}) {
+            jhc::FileDigest::Result result;
+            // threads 0 runs on pool, with direct reads.
+            if (threads == 0)
+                REQUIRE(jhc::FileDigest::Compute(file.path(), all, result, pool, chunkSize, true));
+            else
+                REQUIRE(jhc::FileDigest::Compute(file.path(), all, result, threads, chunkSize));
+            REQUIRE(result.size == content.size());
+            REQUIRE(result.crc32 == jhc::CRC32::GetDataCRC32(data, content.size()));
+            REQUIRE(result.crc32c == jhc::CRC32C::GetDataCRC32C(data, content.size()));
+            REQUIRE(result.md5 == jhc::MD5::GetDataMD5(data, content.size()));
+            REQUIRE(result.sha1 == jhc::SHA1::GetDataSHA1(data, content.size()));
+            REQUIRE(result.sha256 == jhc::SHA256::GetDataSHA256(data, content.size()));
+            REQUIRE(result.sha512 == jhc::SHA512::GetDataSHA512(data, content.size()));
+        }
+    }
+
+    jhc::FileDigest::Result crcOnly;
+    REQUIRE(jhc::FileDigest::Compute(file.path(), jhc::FileDigest::ALG_CRC32, crcOnly, 3, 1024 * 1024));
+    REQUIRE(crcOnly.crc32 == jhc::CRC32::GetDataCRC32(data, content.size()));
+    REQUIRE(crcOnly.md5.empty());
+
+    jhc::FileDigest::Result missing;
+    REQUIRE_FALSE(jhc::FileDigest::Compute("file_digest_missing.dat", all, missing));
+    REQUIRE(jhc::fs::remove(file.path()));
+}
+
+// Test: SHA-1 / SHA-256 kernels.
+//
+TEST_CASE("HashTest5", "[sha]") {
+    REQUIRE(jhc::SHA1::IsKernelSupported(jhc::SHA1::ActiveKernel()));
+    REQUIRE(jhc::SHA256::IsKernelSupported(jhc::SHA256::ActiveKernel()));
+
+    std::vector<unsigned char> data(10000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 2654435761u >> 13);
+
+    for (size_t size : {0, 3, 55, 56, 64, 65, 128, 191, 1000, 9999}) {
+        const unsigned char* p = data.data() + 1;
+        const size_t cut = size / 3;
+
+        jhc::SHA1 sha1(jhc::SHA1::Kernel::Scalar);
+        sha1.update(p, (unsigned int)size);
+        sha1.final();
+        char expect1[256] = {0};
+        sha1.reportHash(expect1);
+
+        jhc::SHA256 sha256(jhc::SHA256::Kernel::Scalar);
+        sha256.init();
+        sha256.update(p, (uint32_t)size);
+        sha256.final();
+        const std::string expect256 = sha256.digest();
+
+        for (auto kernel : {jhc::SHA1::Kernel::Ssse3, jhc::SHA1::Kernel::Avx2, jhc::SHA1::Kernel::ShaNi}) {
+            if (!jhc::SHA1::IsKernelSupported(kernel))
+                continue;
+            jhc::SHA1 h(kernel);
+            h.update(p, (unsigned int)cut);
+            h.update(p + cut, (unsigned int)(size - cut));
+            h.final();
+            char hash[256] = {0};
+            h.reportHash(hash);
+            REQUIRE(std::string(hash) == expect1);
+        }
+
+        for (auto kernel : {jhc::SHA256::Kernel::Ssse3, jhc::SHA256::Kernel::Avx2, jhc::SHA256::Kernel::ShaNi}) {
+            if (!jhc::SHA256::IsKernelSupported(kernel))
+                continue;
+            jhc::SHA256 h(kernel);
+            h.init();
+            h.update(p, (uint32_t)cut);
+            h.update(p + cut, (uint32_t)(size - cut));
+            h.final();
+            REQUIRE(h.digest() == expect256);
+        }
+    }
+
+    REQUIRE(jhc::SHA1::GetDataSHA1((const unsigned char*)"abc", 3) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    REQUIRE(jhc::SHA256::GetDataSHA256((const unsigned char*)"abc", 3) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+// Test: batch hashing of many messages.
+//
+TEST_CASE("HashTest6", "[batch]") {
+    std::vector<unsigned char> data(200000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 2654435761u >> 13);
+
+    for (size_t count : {0, 1, 3, 8, 100}) {
+        std::vector<const unsigned char*> messages;
+        std::vector<size_t> sizes;
+        for (size_t i = 0; i < count; i++) {
+            messages.push_back(data.data() + i);
+            sizes.push_back(i % 10 == 9 ? 70000 + i : (i * 37) % 200);
+        }
+
+        std::vector<unsigned char> md5(count * 16 + 1);
+        std::vector<unsigned char> sha256(count * 32 + 1);
+        jhc::MD5::HashBatch(messages.data(), sizes.data(), count, md5.data());
+        jhc::SHA256::HashBatch(messages.data(), sizes.data(), count, sha256.data());
+
+        for (size_t i = 0; i < count; i++) {
+            REQUIRE(jhc::HexEncode::Encode((const char*)&md5[i * 16], 16) == jhc::MD5::GetDataMD5(messages[i], sizes[i]));
+            REQUIRE(jhc::HexEncode::Encode((const char*)&sha256[i * 32], 32) == jhc::SHA256::GetDataSHA256(messages[i], sizes[i]));
+        }
+
+        // Each kernel, the 8-lane AVX2 path included, which the default one skips on SHA-NI CPUs.
+        typedef jhc::SHA256::Kernel Kernel;
+        for (Kernel kernel : {Kernel::Scalar, Kernel::Ssse3, Kernel::Avx2, Kernel::ShaNi}) {
+            if (!jhc::SHA256::IsKernelSupported(kernel))
+                continue;
+            std::vector<unsigned char> digests(count * 32 + 1);
+            jhc::SHA256::HashBatch(messages.data(), sizes.data(), count, digests.data(), kernel);
+            REQUIRE(memcmp(digests.data(), sha256.data(), count * 32) == 0);
+        }
+    }
+}
+
+// Test: streaming hashers with raw digests.
+//
+template <class Hasher>
+static void CheckHasher(const std::vector<unsigned char>& data, std::string (*getData)(const unsigned char*, size_t)) {
+    REQUIRE(jhc::DigestToHex(jhc::HashOf<Hasher>(data.data(), data.size())) == getData(data.data(), data.size()));
+
+    // Midstate reuse: hash the prefix once, then finish copies with different suffixes.
+    const size_t prefix = 1000;
+    Hasher hasher;
+    hasher.update(data.data(), prefix);
+    for (size_t end : {prefix, prefix + 1, prefix + 63, data.size()}) {
+        Hasher copy = hasher;
+        copy.update(data.data() + prefix, end - prefix);
+        const typename Hasher::Digest digest = copy.finalize();
+        REQUIRE(digest.size() == (size_t)Hasher::kDigestSize);
+        REQUIRE(jhc::DigestToHex(digest) == getData(data.data(), end));
+    }
+
+    // Reuse after init().
+    hasher.init();
+    hasher.update(data.data(), 3);
+    REQUIRE(jhc::DigestToHex(hasher.finalize()) == getData(data.data(), 3));
+}
+
+TEST_CASE("HashTest7", "[hasher]") {
+    std::vector<unsigned char> data(100000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 2654435761u >> 13);
+
+    CheckHasher<jhc::MD5>(data, jhc::MD5::GetDataMD5);
+    CheckHasher<jhc::SHA1>(data, jhc::SHA1::GetDataSHA1);
+    CheckHasher<jhc::SHA256>(data, jhc::SHA256::GetDataSHA256);
+    CheckHasher<jhc::SHA512>(data, jhc::SHA512::GetDataSHA512);
+    CheckHasher<jhc::CRC32>(data, jhc::CRC32::GetDataCRC32);
+    CheckHasher<jhc::CRC32C>(data, jhc::CRC32C::GetDataCRC32C);
+
+    REQUIRE(jhc::DigestToHex(jhc::HashOf<jhc::SHA512>("abc", 3)) ==
+            "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+    REQUIRE(jhc::DigestToHex(jhc::HashOf<jhc::CRC32>("123456789", 9)) == "cbf43926");
+    REQUIRE(jhc::DigestToHex(jhc::HashOf<jhc::CRC32C>("123456789", 9)) == "e3069283");
+
+    // Digests as keys.
+    std::unordered_set<jhc::SHA256::Digest, jhc::DigestHash> keys;
+    for (size_t i = 0; i < 1000; i++)
+        keys.insert(jhc::HashOf<jhc::SHA256>(data.data(), i));
+    REQUIRE(keys.size() == 1000);
+    REQUIRE(keys.count(jhc::HashOf<jhc::SHA256>(data.data(), 500)) == 1);
+    REQUIRE(keys.count(jhc::HashOf<jhc::SHA256>(data.data(), 1000)) == 0);
+}
+
+// Test: xxHash (XXH3).
+//
+TEST_CASE("HashTest8", "[xxhash]") {
+    std::vector<unsigned char> data(100000);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)(i * 2654435761u >> 13);
+
+    // Reference values of xxHash 0.8: XXH3_64bits_withSeed and XXH3_128bits_withSeed (xxhsum -H3 / -H128).
+    struct Vector {
+        size_t size;
+        uint64_t seed;
+        const char* xxh3_64;
+        const char* xxh3_128;
+    };
+    const Vector vectors[] = {
+        {0, 0, "2d06800538d394c2", "99aa06d3014798d86001c324468d497f"},
+        {3, 0, "a1c4a8259b827291", "95c705060a313bf8a1c4a8259b827291"},
+        {8, 0, "79d02238b80e37b1", "2761698c33953c430234362aaf47b71a"},
+        {16, 0, "222e9aead6bddd51", "29be75b0bbbb5284aafffcec5df2cb27"},
+        {100, 0, "ad1e77ff670a2548", "09386db44501f7e4acedade9575c6f25"},
+        {100, 12345, "ee358cb120a4593a", "8efe91971ceea2eb6484304f76edfe67"},
+        {240, 0, "b714c5fd22744964", "4f49ccc8526aa7ad407883ea5ef95b9a"},
+        {1000, 0, "a067b58e6ea5d2f2", "ebf292819ecb8a2ca067b58e6ea5d2f2"},
+        {100000, 0, "1d43ec753d462301", "18580bb0190de1db1d43ec753d462301"},
+        {100000, 12345, "7f3a1c7a2e3aab6e", "13c53fa33cd8018c7f3a1c7a2e3aab6e"},
+    };
+
+    typedef jhc::XXH3Hash64::Kernel Kernel;
+    for (const Vector& v : vectors) {
+        if (v.seed == 0) {
+            REQUIRE(jhc::XXH3Hash64::GetDataXXH3Hash64(data.data(), v.size) == v.xxh3_64);
+            REQUIRE(jhc::XXH3Hash128::GetDataXXH3Hash128(data.data(), v.size) == v.xxh3_128);
+        }
+
+        for (Kernel kernel : {Kernel::Scalar, Kernel::Sse2, Kernel::Avx2}) {
+            if (!jhc::XXH3Hash64::IsKernelSupported(kernel))
+                continue;
+            char hex[17] = {0};
+            snprintf(hex, sizeof(hex), "%016" PRIx64, jhc::XXH3Hash64::Hash(data.data(), v.size, v.seed, kernel));
+            REQUIRE(std::string(hex) == v.xxh3_64);
+
+            const jhc::XXH3Hash128::Value h = jhc::XXH3Hash128::Hash(data.data(), v.size, v.seed, kernel);
+            char hex128[33] = {0};
+            snprintf(hex128, sizeof(hex128), "%016" PRIx64 "%016" PRIx64, h.high, h.low);
+            REQUIRE(std::string(hex128) == v.xxh3_128);
+        }
+
+        // Streaming in uneven pieces across the 256-byte buffer and the 1024-byte blocks.
+        for (size_t piece : {1, 63, 64, 257, 4000}) {
+            jhc::XXH3Hash64 hasher64(v.seed);
+            jhc::XXH3Hash128 hasher128(v.seed);
+            for (size_t offset = 0; offset < v.size; offset += piece) {
+                const size_t n = std::min(piece, v.size - offset);
+                hasher64.update(data.data() + offset, n);
+                hasher128.update(data.data() + offset, n);
+            }
+            REQUIRE(jhc::DigestToHex(hasher64.finalize()) == v.xxh3_64);
+            REQUIRE(jhc::DigestToHex(hasher128.finalize()) == v.xxh3_128);
+        }
+    }
+
+    // The state is kept by value(), hashing can go on.
+    jhc::XXH3Hash64 hasher;
+    hasher.update(data.data(), 500);
+    REQUIRE(hasher.value() == jhc::XXH3Hash64::Hash(data.data(), 500));
+    hasher.update(data.data() + 500, 500);
+    REQUIRE(hasher.value() == jhc::XXH3Hash64::Hash(data.data(), 1000));
+    hasher.init();
+    REQUIRE(hasher.value() == jhc::XXH3Hash64::Hash(nullptr, 0));
+
+    REQUIRE(jhc::XXH3Hash64::Hash("abc", 3, 1) != jhc::XXH3Hash64::Hash("abc", 3, 2));
+}
+
 // Test: string base64 encode/decode.
 //
 TEST_CASE("Base64Test") {
@@ -908,13 +1666,17 @@ TEST_CASE("TimerTest6", "Test timeouts from the past.") {
     jhc::Timer t;
 
     SECTION("Test negative timeouts") {
-        int i = 0;
-        int j = 0;
+        std::atomic<int> i(0);
+        std::atomic<int> j(0);
         std::chrono::time_point<std::chrono::steady_clock> ts1 = std::chrono::steady_clock::now() - std::chrono::milliseconds(10);
         std::chrono::time_point<std::chrono::steady_clock> ts2 = std::chrono::steady_clock::now() - std::chrono::milliseconds(20);
         t.add(ts1, [&](std::size_t) { i = 42; });
         t.add(ts2, [&](std::size_t) { j = 43; });
-        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        // Both fire right away, but waking up the timer thread may take longer than a fixed sleep on a busy host.
+        // Wait until they did, so that the handlers never outlive i and j.
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while ((i != 42 || j != 43) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
         REQUIRE(i == 42);
         REQUIRE(j == 43);
     }
@@ -978,6 +1740,699 @@ TEST_CASE("TimerTest9", "Test remove timer id") {
     }
 }
 
+TEST_CASE("TimerTest10", "Test timing wheel backend") {
+    SECTION("One-shot, periodic and removed timers") {
+        jhc::Timer t(jhc::Timer::Backend::TimingWheel, std::chrono::milliseconds(1));
+        REQUIRE(t.backend() == jhc::Timer::Backend::TimingWheel);
+
+        std::atomic<int> once(0);
+        std::atomic<int> periodic(0);
+        std::atomic<int> removed(0);
+        t.add(std::chrono::milliseconds(10), [&](std::size_t) { once++; });
+        auto pid = t.add(std::chrono::milliseconds(10), [&](std::size_t) { periodic++; }, std::chrono::milliseconds(20));
+        auto rid = t.add(std::chrono::milliseconds(30), [&](std::size_t) { removed++; });
+        REQUIRE(t.remove(rid));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(85));
+        t.remove(pid);
+        REQUIRE(once == 1);
+        REQUIRE(periodic >= 3);
+        REQUIRE(periodic <= 5);
+        REQUIRE(removed == 0);
+    }
+
+    SECTION("Timers cascade from higher levels and fire in order") {
+        // 10us ticks: 60ms is 6000 ticks, two levels above the first one.
+        jhc::Timer t(jhc::Timer::Backend::TimingWheel, std::chrono::microseconds(10));
+        std::mutex m;
+        std::vector<int> order;
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::chrono::steady_clock::duration> late(3);
+        for (int i = 2; i >= 0; i--) {
+            const auto when = start + std::chrono::milliseconds(20 + 20 * i);
+            t.add(when, [&, i, when](std::size_t) {
+                std::lock_guard<std::mutex> lg(m);
+                late[i] = std::chrono::steady_clock::now() - when;
+                order.push_back(i);
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::lock_guard<std::mutex> lg(m);
+        REQUIRE(order == std::vector<int>({0, 1, 2}));
+        for (const auto& d : late)
+            REQUIRE(d >= std::chrono::steady_clock::duration::zero());
+    }
+
+    SECTION("Many timers are added and removed") {
+        jhc::Timer t(jhc::Timer::Backend::TimingWheel);
+        std::atomic<int> fired(0);
+        std::vector<std::size_t> ids;
+        for (int i = 0; i < 100000; i++)
+            ids.push_back(t.add(std::chrono::milliseconds(5000 + i % 1000), [&](std::size_t) { fired++; }));
+        size_t removed = 0;
+        for (size_t i = 0; i < ids.size(); i += 2)
+            removed += t.remove(ids[i]) ? 1 : 0;
+        REQUIRE(removed == ids.size() / 2);
+        auto id = t.add(std::chrono::milliseconds(10), [&](std::size_t) { fired++; });
+        REQUIRE(id == ids[ids.size() - 2]);
+        t.remove(id);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        REQUIRE(fired == 0);
+        for (size_t i = 1; i < ids.size(); i += 2)
+            t.remove(ids[i]);
+    }
+}
+
+TEST_CASE("TimerTest11", "Test handlers dispatched to an executor") {
+    SECTION("A slow handler does not delay other timers") {
+        jhc::ThreadPool pool(2);
+        jhc::Timer t;
+        t.setExecutor(pool);
+
+        std::atomic<bool> slowDone(false);
+        std::atomic<int64_t> lateUs(-1);
+        t.add(std::chrono::milliseconds(5), [&](std::size_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            slowDone = true;
+        });
+        const auto when = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+        t.add(when, [&](std::size_t) {
+            lateUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - when).count();
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        REQUIRE(lateUs >= 0);
+        REQUIRE(lateUs < 40000);
+        REQUIRE(slowDone == false);
+    }
+
+    SECTION("Generic executor and remove from a dispatched handler") {
+        std::atomic<int> tasks(0);
+        std::atomic<int> count(0);
+        jhc::Timer t(jhc::Timer::Backend::TimingWheel);
+        t.setExecutor([&](std::function<void()>&& task) {
+            tasks++;
+            std::thread(std::move(task)).detach();
+        });
+        t.add(
+            std::chrono::milliseconds(5), [&](std::size_t id) {
+                if (++count == 2)
+                    t.remove(id);
+            },
+            std::chrono::milliseconds(5));
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        REQUIRE(count == 2);
+        REQUIRE(tasks == 2);
+    }
+
+    SECTION("Missed periods are caught up or skipped") {
+        for (auto missed : {jhc::Timer::Missed::CatchUp, jhc::Timer::Missed::Skip}) {
+            jhc::Timer t;
+            t.setMissedPolicy(missed);
+            std::atomic<int> count(0);
+            auto id = t.add(
+                std::chrono::milliseconds(10), [&](std::size_t) {
+                    if (++count == 1)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(55));
+                },
+                std::chrono::milliseconds(10));
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            t.remove(id);
+            // 9 periods have elapsed, the handler blocked the timer thread for 5 of them.
+            if (missed == jhc::Timer::Missed::CatchUp)
+                REQUIRE(count >= 8);
+            else
+                REQUIRE(count <= 6);
+        }
+    }
+}
+
+TEST_CASE("TimerTest12", "Test timer slack") {
+    SECTION("Timers fire within their slack window") {
+        for (auto backend : {jhc::Timer::Backend::OrderedSet, jhc::Timer::Backend::TimingWheel}) {
+            jhc::Timer t(backend);
+            const size_t num = 1000;
+            std::atomic<size_t> early(0);
+            std::atomic<size_t> fired(0);
+            std::atomic<int64_t> maxLateUs(0);
+            const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+            for (size_t i = 0; i < num; i++) {
+                const auto when = start + std::chrono::microseconds(i * 5);
+                t.add(
+                    when, [&, when](std::size_t) {
+                        const auto late = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - when).count();
+                        if (late < 0)
+                            early++;
+                        if (late > maxLateUs)
+                            maxLateUs = late;
+                        fired++;
+                    },
+                    std::chrono::microseconds::zero(), std::chrono::milliseconds(10));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(80));
+            REQUIRE(fired == num);
+            REQUIRE(early == 0);
+            REQUIRE(maxLateUs < 40000);
+        }
+    }
+
+    SECTION("A timer removed by a handler of the same batch does not fire") {
+        for (auto backend : {jhc::Timer::Backend::OrderedSet, jhc::Timer::Backend::TimingWheel}) {
+            jhc::Timer t(backend);
+            const auto when = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+            std::atomic<int> second(0);
+            std::atomic<std::size_t> secondId(0);
+            t.add(
+                when, [&](std::size_t) { t.remove(secondId); }, std::chrono::microseconds::zero(), std::chrono::milliseconds(5));
+            secondId = t.add(
+                when, [&](std::size_t) { second++; }, std::chrono::microseconds::zero(), std::chrono::milliseconds(5));
+            std::this_thread::sleep_for(std::chrono::milliseconds(40));
+            REQUIRE(second == 0);
+        }
+    }
+}
+
+// Test: sharded timer.
+//
+TEST_CASE("ShardedTimerTest1", "Test sharded timer ids and shards") {
+    jhc::ShardedTimer t(4);
+    REQUIRE(t.shardCount() == 4);
+
+    SECTION("Ids are unique across shards and passed to the handler") {
+        std::mutex m;
+        std::set<std::size_t> ids;
+        std::set<std::size_t> fired;
+        for (size_t key = 0; key < 16; key++) {
+            auto id = t.addToShard(key, std::chrono::steady_clock::now() + std::chrono::milliseconds(10), [&](std::size_t id) {
+                std::lock_guard<std::mutex> lg(m);
+                fired.insert(id);
+            });
+            REQUIRE(id % t.shardCount() == key % t.shardCount());
+            ids.insert(id);
+        }
+        REQUIRE(ids.size() == 16);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::lock_guard<std::mutex> lg(m);
+        REQUIRE(fired == ids);
+    }
+
+    SECTION("Timers added and removed from many threads") {
+        std::atomic<int> fired(0);
+        std::atomic<int> wrongId(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&]() {
+                std::vector<std::size_t> ids;
+                for (int j = 0; j < 1000; j++) {
+                    ids.push_back(t.add(std::chrono::milliseconds(j % 2 ? 10 : 1000), [&](std::size_t) { fired++; }));
+                }
+                for (size_t j = 0; j < ids.size(); j += 2) {
+                    if (!t.remove(ids[j]))
+                        wrongId++;
+                }
+            });
+        }
+        for (auto& th : threads)
+            th.join();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(wrongId == 0);
+        REQUIRE(fired == 2000);
+    }
+}
+
+// Test: thread pool.
+//
+TEST_CASE("ThreadPoolTest1", "[shared queue]") {
+    jhc::ThreadPool pool(4);
+    REQUIRE(pool.mode() == jhc::ThreadPool::Mode::SharedQueue);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 1000; i++) {
+        results.emplace_back(pool.enqueue([](int v) { return v * 2; }, i));
+    }
+
+    int sum = 0;
+    for (auto& r : results) {
+        sum += r.get();
+    }
+    REQUIRE(sum == 999 * 1000);
+}
+
+TEST_CASE("ThreadPoolTest2", "[work stealing]") {
+    std::atomic<int> count(0);
+    {
+        jhc::ThreadPool pool(4, jhc::ThreadPool::Mode::WorkStealing);
+        REQUIRE(pool.mode() == jhc::ThreadPool::Mode::WorkStealing);
+        REQUIRE(pool.threadCount() == 4);
+
+        // fan-out from inside the workers, the sub-tasks go to the worker's own deque.
+        std::vector<std::future<void>> results;
+        for (int i = 0; i < 100; i++) {
+            results.emplace_back(pool.enqueue([&pool, &count]() {
+                for (int j = 0; j < 100; j++) {
+                    pool.enqueue([&count]() { count++; });
+                }
+            }));
+        }
+
+        for (auto& r : results) {
+            r.get();
+        }
+    }
+    // the destructor drains every queue before joining.
+    REQUIRE(count == 100 * 100);
+}
+
+TEST_CASE("ThreadPoolTest3", "[post]") {
+    // small callables are stored inline, big ones fall back to the heap.
+    int value = 0;
+    jhc::MoveOnlyTask small([&value]() { value++; });
+    REQUIRE(small.isInline());
+    std::unique_ptr<int> owned(new int(41));
+    jhc::MoveOnlyTask moved([&value, p = std::move(owned)]() { value += *p; });
+    REQUIRE(moved.isInline());
+    std::array<char, 256> big{};
+    jhc::MoveOnlyTask large([&value, big]() { value += (int)big.size(); });
+    REQUIRE(large.isInline() == false);
+
+    jhc::MoveOnlyTask other(std::move(moved));
+    REQUIRE(!moved);
+    small();
+    other();
+    large();
+    REQUIRE(value == 1 + 41 + 256);
+
+    std::atomic<int> count(0);
+    {
+        jhc::ThreadPool pool(4, jhc::ThreadPool::Mode::WorkStealing);
+        for (int i = 0; i < 10000; i++) {
+            pool.post([&count]() { count++; });
+            pool.post([&count](int v) { count += v; }, 2);
+        }
+    }
+    REQUIRE(count == 10000 * 3);
+
+    // the queue grows while the only worker is busy, then reuses its slots.
+    {
+        jhc::ThreadPool pool(1);
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        pool.post([released]() { released.wait(); });
+        for (int i = 0; i < 100; i++)
+            pool.post([&count]() { count++; });
+        const size_t grows = pool.queueGrowCount();
+        REQUIRE(grows > 0);
+        release.set_value();
+
+        for (int i = 0; i < 10; i++)
+            pool.post([&count]() { count++; });
+        REQUIRE(pool.queueGrowCount() == grows);
+    }
+    REQUIRE(count == 10000 * 3 + 110);
+}
+
+TEST_CASE("ThreadPoolTest4", "[parallel for/reduce]") {
+    jhc::ThreadPool pool(4, jhc::ThreadPool::Mode::WorkStealing);
+
+    std::vector<int> data(100000);
+    pool.parallelFor(size_t(0), data.size(), size_t(64), [&data](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++)
+            data[i] = (int)i;
+    });
+    for (size_t i = 0; i < data.size(); i++) {
+        REQUIRE(data[i] == (int)i);
+    }
+
+    const int64_t sum = pool.parallelReduce(
+        size_t(0), data.size(), size_t(64), int64_t(0),
+        [&data](size_t b, size_t e) {
+            int64_t partial = 0;
+            for (size_t i = b; i < e; i++)
+                partial += data[i];
+            return partial;
+        },
+        [](int64_t a, int64_t b) { return a + b; });
+    REQUIRE(sum == int64_t(99999) * 100000 / 2);
+
+    // empty range
+    REQUIRE(pool.parallelReduce(5, 5, 1, 7, [](int, int) { return 1; }, [](int a, int b) { return a + b; }) == 7);
+
+    // nested calls from inside the workers must not dead lock.
+    std::atomic<int> count(0);
+    pool.parallelFor(0, 16, 1, [&pool, &count](int b, int e) {
+        for (int i = b; i < e; i++) {
+            pool.parallelFor(0, 1000, 10, [&count](int b2, int e2) { count += e2 - b2; });
+        }
+    });
+    REQUIRE(count == 16 * 1000);
+
+    REQUIRE_THROWS_AS(pool.parallelFor(0, 1000, 1, [](int b, int e) { if (b <= 500 && 500 < e) throw std::runtime_error("500"); }), std::runtime_error);
+}
+
+// Test: buffer queue.
+//
+TEST_CASE("BufferQueueTest1", "[push/pop]") {
+    for (size_t slabSize : {size_t(0), size_t(64 * 1024)}) {
+        jhc::BufferQueue queue("queue", slabSize);
+        REQUIRE(queue.isSlabEnabled() == (slabSize > 0));
+
+        REQUIRE(queue.pushElementToLast((void*)"bb", 2));
+        REQUIRE(queue.pushElementToFront((void*)"a", 1));
+        REQUIRE(queue.pushElementToLast((void*)"ccc", 3));
+        REQUIRE(queue.getElementCount() == 3);
+        REQUIRE(queue.getTotalDataSize() == 6);
+
+        char buf[16] = {0};
+        REQUIRE(queue.popElementFromFront(buf, sizeof(buf)) == 1);
+        REQUIRE(memcmp(buf, "a", 1) == 0);
+        REQUIRE(queue.popElementFromLast(buf, sizeof(buf)) == 3);
+        REQUIRE(memcmp(buf, "ccc", 3) == 0);
+
+        REQUIRE(queue.pushElementToLast((void*)"dddd", 4));
+        REQUIRE(queue.popDataCrossElement(buf, 3, nullptr) == 3);
+        REQUIRE(memcmp(buf, "bbd", 3) == 0);
+        REQUIRE(queue.getTotalDataSize() == 3);
+        REQUIRE(queue.clear() == 1);
+        REQUIRE(queue.getElementCount() == 0);
+    }
+}
+
+TEST_CASE("BufferQueueTest2", "[slab]") {
+    jhc::BufferQueue queue("slab", 64 * 1024);
+    const std::string msg(200, 'x');
+    const std::string big(8192, 'y');
+
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 100; i++) {
+            REQUIRE(queue.pushElementToLast((void*)msg.c_str(), msg.size()));
+        }
+        REQUIRE(queue.pushElementToLast((void*)big.c_str(), big.size()));
+
+        std::string out(big.size(), '\0');
+        for (int i = 0; i < 100; i++) {
+            REQUIRE(queue.popElementFromFront(&out[0], out.size()) == msg.size());
+            REQUIRE(out.compare(0, msg.size(), msg) == 0);
+        }
+        REQUIRE(queue.popElementFromFront(&out[0], out.size()) == big.size());
+        REQUIRE(out == big);
+    }
+
+    // only the first round carves new blocks, later rounds recycle them.
+    const jhc::BufferQueue::SlabStatistics stat = queue.getSlabStatistics();
+    REQUIRE(stat.misses == 100 + 10);
+    REQUIRE(stat.hits == 9 * 100);
+    REQUIRE(stat.slabCount == 1);
+    REQUIRE(stat.slabBytes == 64 * 1024);
+}
+
+TEST_CASE("BufferQueueTest3", "[segments/consume]") {
+    jhc::BufferQueue queue;
+    REQUIRE(queue.pushElementToLast((void*)"hello ", 6));
+    REQUIRE(queue.pushElementToLast((void*)"zero-copy ", 10));
+    REQUIRE(queue.pushElementToLast((void*)"world", 5));
+
+    jhc::BUFFER_SEGMENT segs[8];
+    REQUIRE(queue.getSegments(segs, 8) == 3);
+    std::string all;
+    for (int i = 0; i < 3; i++)
+        all.append((const char*)segs[i].data, segs[i].size);
+    REQUIRE(all == "hello zero-copy world");
+
+    // limited by bytes
+    REQUIRE(queue.getSegments(segs, 8, 8) == 2);
+    REQUIRE(segs[1].size == 2);
+
+    REQUIRE(queue.consume(8) == 8);
+    REQUIRE(queue.getElementCount() == 2);
+    REQUIRE(queue.getTotalDataSize() == 13);
+    REQUIRE(queue.getSegments(segs, 1) == 1);
+    REQUIRE(std::string((const char*)segs[0].data, segs[0].size) == "ro-copy ");
+
+#ifndef JHC_WIN
+    struct iovec iov[8];
+    REQUIRE(queue.getSegments(iov, 8) == 2);
+    REQUIRE(iov[0].iov_len + iov[1].iov_len == 13);
+#endif
+
+    REQUIRE(queue.consume(100) == 13);
+    REQUIRE(queue.getElementCount() == 0);
+    REQUIRE(queue.getSegments(segs, 8) == 0);
+}
+
+TEST_CASE("BufferQueueTest4", "[wait/batch/close]") {
+    jhc::BufferQueue queue;
+    char buf[64] = {0};
+    size_t sizes[8] = {0};
+
+    REQUIRE(queue.waitForData(std::chrono::milliseconds(10)) == false);
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf), std::chrono::milliseconds(10)) == 0);
+
+    std::thread producer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        queue.pushElementToLast((void*)"ping", 4);
+    });
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf), std::chrono::milliseconds(5000)) == 4);
+    REQUIRE(memcmp(buf, "ping", 4) == 0);
+    producer.join();
+
+    for (int i = 0; i < 5; i++) {
+        REQUIRE(queue.pushElementToLast((void*)"0123456789", 10));
+    }
+    // buffer only fits 3 whole elements.
+    REQUIRE(queue.popElementsFromFront(buf, 35, sizes, 8) == 3);
+    REQUIRE((sizes[0] == 10 && sizes[1] == 10 && sizes[2] == 10));
+    REQUIRE(queue.popElementsFromFront(buf, sizeof(buf), sizes, 1, std::chrono::milliseconds(10)) == 1);
+    REQUIRE(queue.getElementCount() == 1);
+
+    std::thread closer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        queue.close();
+    });
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf)) == 10);
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(queue.popElementsFromFront(buf, sizeof(buf), sizes, 8, std::chrono::milliseconds(5000)) == 0);
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(4000));
+    closer.join();
+
+    REQUIRE(queue.isClosed());
+    REQUIRE(queue.pushElementToLast((void*)"late", 4) == false);
+}
+
+// Test: lock-free ring buffer queue.
+//
+TEST_CASE("RingBufferQueueTest1", "[single thread]") {
+    jhc::RingBufferQueue queue(3, 16, "ring");
+    REQUIRE(queue.getQueueName() == "ring");
+    REQUIRE(queue.capacity() == 4);
+    REQUIRE(queue.maxElementSize() == 16);
+
+    char buf[16] = {0};
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf)) == 0);
+    REQUIRE(queue.pushElementToLast("0123456789abcdefg", 17) == false);
+    REQUIRE(queue.pushElementToLast("", 0) == false);
+
+    REQUIRE(queue.pushElementToLast("a", 1));
+    REQUIRE(queue.pushElementToLast("bb", 2));
+    REQUIRE(queue.pushElementToLast("ccc", 3));
+    REQUIRE(queue.pushElementToLast("dddd", 4));
+    REQUIRE(queue.pushElementToLast("e", 1) == false);
+    REQUIRE(queue.getElementCount() == 4);
+
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf)) == 1);
+    REQUIRE(memcmp(buf, "a", 1) == 0);
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf)) == 2);
+    REQUIRE(memcmp(buf, "bb", 2) == 0);
+    REQUIRE(queue.popElementFromFront(buf, 2) == 2);  // truncated
+    REQUIRE(memcmp(buf, "cc", 2) == 0);
+    REQUIRE(queue.popElementFromFront(buf, sizeof(buf)) == 4);
+    REQUIRE(memcmp(buf, "dddd", 4) == 0);
+    REQUIRE(queue.getElementCount() == 0);
+}
+
+TEST_CASE("RingBufferQueueTest2", "[multi producer/consumer]") {
+    jhc::RingBufferQueue queue(1024, sizeof(int));
+    const int producerNum = 4;
+    const int perProducer = 100000;
+    std::atomic<int64_t> sum(0);
+    std::atomic<int> popped(0);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producerNum; p++) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                int v = p * perProducer + i;
+                while (!queue.pushElementToLast(&v, sizeof(v)))
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (int c = 0; c < 4; c++) {
+        threads.emplace_back([&]() {
+            int v = 0;
+            while (popped.load() < producerNum * perProducer) {
+                if (queue.popElementFromFront(&v, sizeof(v)) == sizeof(v)) {
+                    sum += v;
+                    popped++;
+                }
+                else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    const int64_t n = producerNum * perProducer;
+    REQUIRE(popped == n);
+    REQUIRE(sum == n * (n - 1) / 2);
+}
+
+// Test: size class pool.
+//
+TEST_CASE("SizeClassPoolTest1", "[size class]") {
+    const size_t maxSmallSize = jhc::SizeClassPool::kMaxSmallSize;
+    const size_t classNum = jhc::SizeClassPool::kClassNum;
+    for (size_t bytes = 1; bytes <= maxSmallSize; bytes++) {
+        const size_t cls = jhc::SizeClassPool::ClassIndex(bytes);
+        REQUIRE(cls < classNum);
+        REQUIRE(jhc::SizeClassPool::ClassSize(cls) >= bytes);
+        if (cls > 0) {
+            REQUIRE(jhc::SizeClassPool::ClassSize(cls - 1) < bytes);
+        }
+    }
+    REQUIRE(jhc::SizeClassPool::ClassSize(classNum - 1) == maxSmallSize);
+}
+
+TEST_CASE("SizeClassPoolTest2", "[stl allocator]") {
+    std::vector<int, jhc::PoolAllocator<int>> vec;
+    for (int i = 0; i < 100000; i++)
+        vec.push_back(i);
+    REQUIRE(vec.size() == 100000);
+    REQUIRE(vec[99999] == 99999);
+
+    std::map<int, std::string, std::less<int>, jhc::PoolAllocator<std::pair<const int, std::string>>> m;
+    for (int i = 0; i < 10000; i++)
+        m[i] = std::to_string(i);
+    for (int i = 0; i < 10000; i += 2)
+        m.erase(i);
+    REQUIRE(m.size() == 5000);
+    REQUIRE(m[9999] == "9999");
+
+    // memory freed by another thread.
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 1000; i++)
+        ptrs.push_back(jhc::SizeClassPool::Instance()->allocate(100));
+    std::thread t([&ptrs]() {
+        for (void* p : ptrs)
+            jhc::SizeClassPool::Instance()->deallocate(p, 100);
+    });
+    t.join();
+}
+
+TEST_CASE("SizeClassPoolTest3", "[multi thread]") {
+    std::vector<std::thread> threads;
+    std::atomic<int> errors(0);
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t, &errors]() {
+            std::vector<std::pair<unsigned char*, size_t>> live;
+            for (int i = 0; i < 20000; i++) {
+                const size_t size = 1 + (size_t)((i * 7919 + t * 104729) % 2048);
+                unsigned char* p = (unsigned char*)jhc::SizeClassPool::Instance()->allocate(size);
+                memset(p, (unsigned char)t, size);
+                live.emplace_back(p, size);
+                if (live.size() > 64) {
+                    auto victim = live[(size_t)i % live.size()];
+                    live[(size_t)i % live.size()] = live.back();
+                    live.pop_back();
+                    for (size_t k = 0; k < victim.second; k++) {
+                        if (victim.first[k] != (unsigned char)t)
+                            errors++;
+                    }
+                    jhc::SizeClassPool::Instance()->deallocate(victim.first, victim.second);
+                }
+            }
+            for (auto& l : live)
+                jhc::SizeClassPool::Instance()->deallocate(l.first, l.second);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(errors == 0);
+}
+
+// Test: monotonic arena.
+//
+TEST_CASE("MonotonicArenaTest1", "[allocate/reset]") {
+    jhc::MonotonicArena arena(256);
+    REQUIRE(arena.usedBytes() == 0);
+    REQUIRE(arena.reservedBytes() == 0);
+
+    void* p1 = arena.allocate(10);
+    void* p2 = arena.allocate(8, 8);
+    REQUIRE(p1 != p2);
+    REQUIRE(((uintptr_t)p2 % 8) == 0);
+
+    // bigger than any block, gets its own block.
+    char* big = (char*)arena.allocate(10000);
+    memset(big, 1, 10000);
+
+    const std::string s = jhc::StringHelper::ToUpper("arena");
+    REQUIRE(strcmp(arena.copyString(s), "ARENA") == 0);
+
+    const size_t reserved = arena.reservedBytes();
+    REQUIRE(reserved > 10000);
+
+    // reset keeps the blocks, the next round does not reserve more memory.
+    for (int round = 0; round < 10; round++) {
+        arena.reset();
+        REQUIRE(arena.usedBytes() == 0);
+        arena.allocate(10);
+        arena.allocate(10000);
+    }
+    REQUIRE(arena.reservedBytes() == reserved);
+
+    // oversized requests fail without touching the arena.
+    REQUIRE_THROWS_AS(arena.allocate(SIZE_MAX), std::bad_alloc);
+    REQUIRE_THROWS_AS(arena.allocate(SIZE_MAX - 8, 64), std::bad_alloc);
+    REQUIRE_THROWS_AS(arena.allocate(SIZE_MAX / 2 + 1), std::bad_alloc);
+    REQUIRE(arena.reservedBytes() == reserved);
+    REQUIRE(arena.allocate(10) != nullptr);
+
+    arena.release();
+    REQUIRE(arena.reservedBytes() == 0);
+}
+
+TEST_CASE("MonotonicArenaTest2", "[stl/json]") {
+    jhc::MonotonicArena arena;
+
+    jhc::ArenaVector<int> vec{jhc::ArenaAllocator<int>(arena)};
+    for (int i = 0; i < 1000; i++)
+        vec.push_back(i);
+    REQUIRE(vec[999] == 999);
+
+    jhc::ArenaString str("request scoped string that does not fit in SSO", jhc::ArenaAllocator<char>(arena));
+    REQUIRE(str.size() == 46);
+    REQUIRE(arena.usedBytes() > 1000 * sizeof(int));
+
+    REQUIRE(jhc::MonotonicArena::Current() == nullptr);
+    {
+        jhc::MonotonicArena::Scope scope(arena);
+        REQUIRE(jhc::MonotonicArena::Current() == &arena);
+
+        const size_t used = arena.usedBytes();
+        jhc::arena_json j = jhc::arena_json::parse(R"({"id": 1, "tags": ["a", "b"], "name": "a name longer than the small string buffer"})");
+        j["ok"] = true;
+        REQUIRE(j["tags"].size() == 2);
+        REQUIRE(j["id"].get<int>() == 1);
+        REQUIRE(j.dump() == R"({"id":1,"name":"a name longer than the small string buffer","ok":true,"tags":["a","b"]})");
+        REQUIRE(arena.usedBytes() > used);
+    }
+    REQUIRE(jhc::MonotonicArena::Current() == nullptr);
+
+    REQUIRE_THROWS_AS(jhc::ArenaAllocator<int>().allocate(1), std::bad_alloc);
+}
+
 int main(int argc, char* argv[]) {
     return Catch::Session().run(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*******************************************************************************
+*    C++ Common Library
+*    ---------------------------------------------------------------------------
+*    Copyright (C) 2022 JiangXueqiao <winsoft666@outlook.com>.
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "catch.hpp"
+#include "jhc/thread_pool.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <new>
+
+// Heap allocations of the submitted tasks, counted without replacing the global operator new:
+// by CountingAllocator, by the class operator new of Counted and by CountFunctionStorage.
+static std::atomic<size_t> taskAllocCount(0);
+
+template <class T>
+struct CountingAllocator {
+    typedef T value_type;
+
+    CountingAllocator() = default;
+
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        taskAllocCount++;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) { std::allocator<T>().deallocate(p, n); }
+
+    template <class U>
+    bool operator==(const CountingAllocator<U>&) const { return true; }
+
+    template <class U>
+    bool operator!=(const CountingAllocator<U>&) const { return false; }
+};
+
+// Wraps a task so that the heap allocation MoveOnlyTask makes for a task larger than its inline buffer is counted.
+template <class F>
+struct Counted {
+    F fn;
+
+    void operator()() { fn(); }
+
+    static void* operator new(size_t size) {
+        taskAllocCount++;
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* p) noexcept {
+        ::operator delete(p);
+    }
+};
+
+// A task of Size bytes of payload that marks itself done.
+template <size_t Size>
+struct DoneTask {
+    std::atomic<size_t>* done;
+    char payload[Size];
+
+    void operator()() { (*done)++; }
+};
+
+// Counts the allocation of a std::function that stores its target outside of itself.
+template <class T>
+static void CountFunctionStorage(std::function<void()>& fn) {
+    const uintptr_t target = reinterpret_cast<uintptr_t>(fn.template target<T>());
+    const uintptr_t self = reinterpret_cast<uintptr_t>(&fn);
+    if (target < self || target >= self + sizeof(fn))
+        taskAllocCount++;
+}
+
+// Allocations per task include the growth of the pool's task queues.
+template <class Submit>
+static void RunSubmitBenchmark(const char* name, jhc::ThreadPool& pool, std::atomic<size_t>& done, size_t taskNum, Submit submit) {
+    done = 0;
+    const size_t allocBefore = taskAllocCount.load() + pool.queueGrowCount();
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < taskNum; i++)
+        submit();
+    while (done.load() < taskNum)
+        std::this_thread::yield();
+
+    const auto end = std::chrono::steady_clock::now();
+    const size_t allocs = taskAllocCount.load() + pool.queueGrowCount() - allocBefore;
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%-32s %8.3f allocs/task %12.0f tasks/s\n", name, (double)allocs / taskNum, taskNum / seconds);
+}
+
+// Benchmark: throughput and heap allocations per task of the ThreadPool submission paths.
+// Hidden by default, run with: jhc-test [benchmark]
+//
+TEST_CASE("ThreadPoolBenchmark", "[.][benchmark]") {
+    typedef std::packaged_task<void()> PackagedTask;
+    const size_t taskNum = 1000000;
+    std::atomic<size_t> done(0);
+    jhc::ThreadPool pool(4, jhc::ThreadPool::Mode::WorkStealing);
+
+    // what enqueue() did before: shared packaged_task (control block, then future shared state) + std::function wrapper.
+    struct LegacyCall {
+        std::shared_ptr<PackagedTask> task;
+        void operator()() { (*task)(); }
+    };
+    RunSubmitBenchmark("legacy enqueue", pool, done, taskNum, [&]() {
+        CountingAllocator<int> alloc;
+        auto task = std::allocate_shared<PackagedTask>(alloc, std::allocator_arg, alloc, DoneTask<8>{&done, {0}});
+        std::future<void> res = task->get_future();
+        std::function<void()> fn(LegacyCall{task});
+        CountFunctionStorage<LegacyCall>(fn);
+        pool.post(Counted<std::function<void()>>{std::move(fn)});
+    });
+
+    // what enqueue() does: a packaged_task (future shared state) moved into the pool.
+    RunSubmitBenchmark("enqueue", pool, done, taskNum, [&]() {
+        PackagedTask task(std::allocator_arg, CountingAllocator<int>(), DoneTask<8>{&done, {0}});
+        std::future<void> res = task.get_future();
+        pool.post(Counted<PackagedTask>{std::move(task)});
+    });
+
+    RunSubmitBenchmark("post", pool, done, taskNum, [&]() {
+        pool.post(Counted<DoneTask<16>>{{&done, {0}}});
+    });
+
+    RunSubmitBenchmark("post (larger than inline buffer)", pool, done, taskNum, [&]() {
+        pool.post(Counted<DoneTask<jhc::MoveOnlyTask::kInlineSize>>{{&done, {0}}});
+    });
+}